@@ -75,6 +75,9 @@ device_screen_reset(struct device_screen_state* s)
     }
     assert(s->frameBuffer);
     memset((void*) s->frameBuffer, 0, s->width * s->height * sizeof(short));
+
+    /* The virtual terminal only renders damaged cells, so redraw everything it had rendered. */
+    vterm_render_buffer_full(s->vterm);
 }
 
 void
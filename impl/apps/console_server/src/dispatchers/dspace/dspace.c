@@ -18,9 +18,14 @@
 */
 
 seL4_CPtr
-data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode , int rpc_size ,
-                  int* rpc_errno)
+data_open_internal_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
+                           int rpc_size , uint32_t* rpc_dspaceSize , int* rpc_errno)
 {
+    /* Device dataspaces have no size. */
+    if (rpc_dspaceSize) {
+        (*rpc_dspaceSize) = 0;
+    }
+
     if (!rpc_name) {
         SET_ERRNO_PTR(rpc_errno, EFILENOTFOUND);
         return 0;
@@ -65,6 +70,12 @@ data_close_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd)
     return EFILENOTFOUND;
 }
 
+refos_err_t
+data_unlink_handler(void *rpc_userptr , char* rpc_name)
+{
+    return EUNIMPLEMENTED;
+}
+
 int
 data_read_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
                   rpc_buffer_t rpc_buf , uint32_t rpc_count)
@@ -230,6 +241,71 @@ data_provide_data_from_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dsp
     return EUNIMPLEMENTED;
 }
 
+int
+data_read_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
+                              uint32_t rpc_count)
+{
+    struct srv_client *c = (struct srv_client *) rpc_userptr;
+    srv_msg_t *m = (srv_msg_t *) c->rpcClient.userptr;
+    assert(c && (c->magic == CONSERV_DISPATCH_ANON_CLIENT_MAGIC || c->magic == CONSERV_CLIENT_MAGIC));
+
+    if (!srv_check_dispatch_caps(m, 0x00000001, 1)) {
+        return -EINVALIDPARAM;
+    }
+
+    /* Console dataspaces can't be read from, same as data_read. */
+    if (rpc_dspace_fd == CONSERV_DSPACE_BADGE_STDIO ||
+        rpc_dspace_fd == CONSERV_DSPACE_BADGE_SCREEN) {
+        return -EACCESSDENIED;
+    }
+
+    return -EFILENOTFOUND;
+}
+
+int
+data_write_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
+                               uint32_t rpc_count)
+{
+    struct srv_client *c = (struct srv_client *) rpc_userptr;
+    srv_msg_t *m = (srv_msg_t *) c->rpcClient.userptr;
+    assert(c && (c->magic == CONSERV_DISPATCH_ANON_CLIENT_MAGIC || c->magic == CONSERV_CLIENT_MAGIC));
+
+    if (c->magic == CONSERV_DISPATCH_ANON_CLIENT_MAGIC) {
+        /* Anonymous clients have no parameter buffer; tell them to use the IPC path instead. */
+        return -EUNIMPLEMENTED;
+    }
+    if (!srv_check_dispatch_caps(m, 0x00000001, 1)) {
+        return -EINVALIDPARAM;
+    }
+    if (rpc_count == 0) {
+        /* Zero-length probe, sent before the client sets up its parameter buffer. */
+        return 0;
+    }
+
+    /* Wrap the client's mapped parameter buffer up and pass it on to the normal write path. */
+    rpc_buffer_t buf;
+    buf.data = client_map_param_buffer(c);
+    buf.count = rpc_count;
+    if (!buf.data) {
+        return -ENOPARAMBUFFER;
+    }
+    if (rpc_count > c->paramBufferSize) {
+        return -EINVALIDPARAM;
+    }
+
+    /* Handle write to stdio / serial dataspaces. */
+    if (rpc_dspace_fd == CONSERV_DSPACE_BADGE_STDIO) {
+        return serial_write_handler(rpc_userptr, rpc_dspace_fd, rpc_offset, buf, rpc_count);
+    }
+
+    /* Handle write to screen dataspaces. */
+    if (rpc_dspace_fd == CONSERV_DSPACE_BADGE_SCREEN) {
+        return screen_write_handler(rpc_userptr, rpc_dspace_fd, rpc_offset, buf, rpc_count);
+    }
+
+    return -EFILENOTFOUND;
+}
+
 int
 check_dispatch_data(srv_msg_t *m, void **userptr)
 {
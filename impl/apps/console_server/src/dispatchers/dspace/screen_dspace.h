@@ -10,7 +10,7 @@
 /*! @file
     @brief Screen / keyboard STDIO dataspace interface functions. */
 
-/*! @brief Similar to data_open_handler, for screen / keyboard dataspaces. */
+/*! @brief Similar to data_open_internal_handler, for screen / keyboard dataspaces. */
 seL4_CPtr screen_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
                               int rpc_size , int* rpc_errno);
 
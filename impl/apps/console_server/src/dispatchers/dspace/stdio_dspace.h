@@ -12,7 +12,7 @@
 /*! @file
     @brief Serial STDIO dataspace interface functions. */
 
-/*! @brief Similar to data_open_handler, for serial dataspaces. */
+/*! @brief Similar to data_open_internal_handler, for serial dataspaces. */
 seL4_CPtr serial_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
                               int rpc_size , int* rpc_errno);
 
@@ -21,8 +21,8 @@ vterm_buffer_puts_internal(vterm_state_t *s, int r, int c, uint32_t *buf, int le
     if (c < 0 || c >= s->width) {
         return;
     }
-    if (c + len >= s->width) {
-        len = (s->width - 1) - c;
+    if (c + len > s->width) {
+        len = s->width - c;
     }
     int n = 0;
     for (int i = c; i < c + len; i++) {
@@ -96,6 +96,80 @@ vterm_internal_colour_to_vterm_colour_index(VTermColor col)
     return vterm_internal_rgb_to_vterm_colour_index(col.red, col.green, col.blue);
 }
 
+/*! @brief Copy the given rectangle of the virtual screen out to the screen buffer.
+    @param s The emulator state. (No ownership)
+    @param rect The rectangle of cells to render.
+*/
+static void
+vterm_render_rect(vterm_state_t *s, VTermRect rect)
+{
+    assert(s && s->magic == VTERM_MAGIC && s->buffer);
+    for (int i = rect.start_row; i < rect.end_row; i++) {
+        for (int j = rect.start_col; j < rect.end_col; ) {
+            VTermPos pos = {
+                .row = i,
+                .col = j
+            };
+            VTermScreenCell cell;
+            vterm_screen_get_cell(s->vts, pos, &cell);
+            s->fgColour = vterm_internal_colour_to_vterm_colour_index(cell.fg);
+            s->bgColour = vterm_internal_colour_to_vterm_colour_index(cell.bg);
+            vterm_buffer_puts_internal(s, i, j, cell.chars, cell.width);
+            j += cell.width > 0 ? cell.width : 1;
+        }
+    }
+}
+
+/*! @brief libvterm screen damage callback. Renders only the damaged rectangle. */
+static int
+vterm_internal_damage(VTermRect rect, void *user)
+{
+    vterm_state_t *s = (vterm_state_t *) user;
+    assert(s && s->magic == VTERM_MAGIC);
+    vterm_render_rect(s, rect);
+    return 1;
+}
+
+/*! @brief libvterm screen moverect callback.
+
+    Moves the already rendered cells around in the screen buffer directly, instead of having them
+    re-rendered from the virtual screen as damage. This makes scrolling a couple of memmoves.
+*/
+static int
+vterm_internal_moverect(VTermRect dest, VTermRect src, void *user)
+{
+    vterm_state_t *s = (vterm_state_t *) user;
+    assert(s && s->magic == VTERM_MAGIC && s->buffer);
+    uint16_t *buffer = (uint16_t *) s->buffer;
+    int nrows = dest.end_row - dest.start_row;
+    int ncols = dest.end_col - dest.start_col;
+    if (nrows <= 0 || ncols <= 0) {
+        return 1;
+    }
+
+    if (ncols == s->width) {
+        /* Full width rows are contiguous in the buffer. */
+        memmove(buffer + dest.start_row * s->width, buffer + src.start_row * s->width,
+                nrows * s->width * sizeof(uint16_t));
+        return 1;
+    }
+
+    /* Copy row by row, in the direction that doesn't overwrite rows yet to be moved. */
+    bool downward = dest.start_row > src.start_row;
+    for (int k = 0; k < nrows; k++) {
+        int i = downward ? (nrows - 1 - k) : k;
+        memmove(buffer + (dest.start_row + i) * s->width + dest.start_col,
+                buffer + (src.start_row + i) * s->width + src.start_col,
+                ncols * sizeof(uint16_t));
+    }
+    return 1;
+}
+
+static const VTermScreenCallbacks vtermScreenCallbacks = {
+    .damage = vterm_internal_damage,
+    .moverect = vterm_internal_moverect,
+};
+
 /* ----------------------------- Virtual Terminal Functions ------------------------------------- */
 
 int
@@ -124,9 +198,12 @@ vterm_init(vterm_state_t *s, int width, int height, volatile uint16_t *buffer)
     s->vtstate = vterm_obtain_state(s->vt);
     assert(s->vts && s->vtstate);
     
-    /* Set parameters. */
+    /* Set parameters. Damage is merged until the next render, and scrolls are kept pending so they
+       may be done by moving the rendered rows around rather than re-rendering them. */
     vterm_parser_set_utf8(s->vt, true);
     vterm_state_set_bold_highbright(s->vtstate, true);
+    vterm_screen_set_callbacks(s->vts, &vtermScreenCallbacks, s);
+    vterm_screen_set_damage_merge(s->vts, VTERM_DAMAGE_SCROLL);
     vterm_screen_reset(s->vts, 1);
 
     return ESUCCESS;
@@ -143,14 +220,19 @@ void
 vterm_write(vterm_state_t *s, char *buffer, int len)
 {
     assert(s && s->magic == VTERM_MAGIC);
+    /* Push the buffer in runs up to and including each \n, converting \n to \n\r. */
+    int start = 0;
     for (int i = 0; i < len; i++) {
-        vterm_push_bytes(s->vt, &buffer[i], 1);
         if (buffer[i] == '\n') {
             char cr = '\r';
-            /* Convert \n to \n\r. */
+            vterm_push_bytes(s->vt, &buffer[start], i + 1 - start);
             vterm_push_bytes(s->vt, &cr, 1);
+            start = i + 1;
         }
     }
+    if (start < len) {
+        vterm_push_bytes(s->vt, &buffer[start], len - start);
+    }
     if (s->autoRenderUpdate) {
         vterm_render_buffer(s);
     }
@@ -171,22 +253,23 @@ void
 vterm_render_buffer(vterm_state_t *s)
 {
     assert(s && s->magic == VTERM_MAGIC && s->buffer);
-    
+    /* Flushing pending damage calls back into vterm_internal_moverect and vterm_internal_damage. */
+    vterm_screen_flush_damage(s->vts);
+}
+
+void
+vterm_render_buffer_full(vterm_state_t *s)
+{
+    assert(s && s->magic == VTERM_MAGIC && s->buffer);
+    vterm_screen_flush_damage(s->vts);
+
     int bufferHeight, bufferWidth;
     vterm_get_size(s->vt, &bufferHeight, &bufferWidth);
-    
-    for (int i = 0; i < bufferHeight; i++) {
-        for (int j = 0; j < bufferWidth; ) {
-            VTermPos pos = {
-                .row = i,
-                .col = j  
-            };
-            VTermScreenCell cell;
-            vterm_screen_get_cell(s->vts, pos, &cell);
-            s->fgColour = vterm_internal_colour_to_vterm_colour_index(cell.fg);
-            s->bgColour = vterm_internal_colour_to_vterm_colour_index(cell.bg);
-            vterm_buffer_puts_internal(s, i, j, cell.chars, cell.width);
-            j += cell.width;
-        }
-    }
+    VTermRect rect = {
+        .start_row = 0,
+        .end_row = bufferHeight,
+        .start_col = 0,
+        .end_col = bufferWidth
+    };
+    vterm_render_rect(s, rect);
 }
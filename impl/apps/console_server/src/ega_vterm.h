@@ -102,9 +102,20 @@ void vterm_printf(vterm_state_t *s, const char* fmt, ...);
            This needs to be done every time the screen has changed. If the autoRenderUpdate flag
            has been set, this will be called automatically on every vterm_write() or vterm_printf().
            The default value for autoRenderUpdate is true.
+
+    Only the cells damaged since the last render are written out, and pending scrolls are done by
+    moving the rendered rows within the screen buffer. This assumes nothing else has written to the
+    screen buffer in the meantime; see vterm_render_buffer_full().
+
     @param s The emulator state. (No ownership)
 */
 void vterm_render_buffer(vterm_state_t *s);
 
+/*! @brief Render out the entire terminal screen to the given screen buffer in vterm_init(),
+           regardless of damage. Use this if the screen buffer contents have been lost or modified.
+    @param s The emulator state. (No ownership)
+*/
+void vterm_render_buffer_full(vterm_state_t *s);
+
 #endif /* _CONSOLE_SERVER_EGA_VIRTUAL_TERMINAL_H_ */
 
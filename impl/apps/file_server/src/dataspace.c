@@ -13,6 +13,7 @@
 #include "badge.h"
 #include "state.h"
 #include "dataspace.h"
+#include "ramfs.h"
 
  /*! @file
      @brief File server CPIO dataspace object allocation and management.
@@ -27,8 +28,8 @@
 /*! @brief Dataspace object OAT creation function.
 
     This is called by coat helper library to create a new structure. The first argument is the
-    client's DeathID, second argument is the fileData pointer, 3rd argument is the fileData size,
-    and 4th argument the permissions mask.
+    client's DeathID, second argument is the indexed file (struct fs_file) pointer, and 3rd
+    argument the permissions mask.
 
     Allocates and fills in a new dataspace structure with the given arguments, and mints a new cap
     representing this new dataspace.
@@ -54,17 +55,17 @@ dspace_oat_create(coat_t *oat, int id, uint32_t arg[COAT_ARGS])
     ndspace->dID = id;
     ndspace->deathID = arg[0];
     ndspace->dataspaceCap = csalloc();
-    ndspace->fileData = (char*) arg[1];
-    ndspace->fileDataSize = arg[2];
-    ndspace->permissions = arg[3];
-    ndspace->fileCreated = false;
+    ndspace->file = (struct fs_file *) arg[1];
+    ndspace->permissions = arg[2];
 
     /* Check that the dataspace cap cslot has been successfully allocated, and that
        the given pointer is valid. */
-    if (!ndspace->dataspaceCap || !ndspace->fileData) {
+    if (!ndspace->dataspaceCap || !ndspace->file) {
         free(ndspace);
         return NULL;
     }
+    assert(ndspace->file->magic == FS_FILE_MAGIC);
+    ndspace->file->ref++;
 
     /* Create the badged cap represending this dataspace. */
     int error = seL4_CNode_Mint(
@@ -94,6 +95,14 @@ dspace_oat_delete(coat_t *oat, cvector_item_t *obj)
     seL4_CNode_Revoke(REFOS_CSPACE, dspace->dataspaceCap, REFOS_CDEPTH);
     csfree_delete(dspace->dataspaceCap);
 
+    /* Drop our reference to the file, deleting it if it has been unlinked. */
+    struct fs_file *file = dspace->file;
+    assert(file && file->magic == FS_FILE_MAGIC && file->ref > 0);
+    file->ref--;
+    if (file->ramfs && file->unlinked && !file->ref) {
+        ramfs_file_delete(&fileServ.ramfs, file);
+    }
+
     /* Finally, free the entire structure. */
     free(dspace);
 }
@@ -127,16 +136,15 @@ dspace_table_release(struct fs_dataspace_table *dt)
 /* --------------------- CPIO Dataspace Allocation Functions ------------------------------------ */
 
 struct fs_dataspace*
-dspace_alloc(struct fs_dataspace_table *dt, uint32_t deathID, char *fileData, size_t fileDataSize,
+dspace_alloc(struct fs_dataspace_table *dt, uint32_t deathID, struct fs_file *file,
              seL4_Word permissions)
 {
     struct fs_dataspace* ndspace = NULL;
 
     uint32_t arg[COAT_ARGS];
     arg[0] = deathID;
-    arg[1] = (uint32_t) fileData;
-    arg[2] = (uint32_t) fileDataSize;
-    arg[3] = (uint32_t) permissions;
+    arg[1] = (uint32_t) file;
+    arg[2] = (uint32_t) permissions;
 
     /* Allocate an ID, and the dspace structure associated with it. */
     int ID = coat_alloc(&dt->allocTable, arg, (cvector_item_t *) &ndspace);
@@ -217,6 +225,8 @@ dspace_externalID_associate(chash_t *ht, int objID, int dsID, int dsOffset,
     di->dataspaceID = dsID;
     di->dataspaceOffset = dsOffset;
     di->objectCap = cap;
+    di->readAheadNextAddr = 0;
+    di->readAheadNPages = 0;
     chash_set(ht, objID, (chash_item_t) di);
     return ESUCCESS;
 }
@@ -225,6 +235,7 @@ int
 dspace_window_associate(struct fs_dataspace_table *dt, int winID, int dsID, int dsOffset,
                               seL4_CPtr windowCap)
 {
+    dspace_window_unassociate(dt, winID);
     return dspace_externalID_associate(&dt->windowAssocTable, winID, dsID, dsOffset, windowCap);
 }
 
@@ -237,6 +248,10 @@ dspace_window_find(struct fs_dataspace_table *dt, int winID)
 void
 dspace_window_unassociate(struct fs_dataspace_table *dt, int winID)
 {
+    /* Take back any cached frames from the window while we still hold its cap. */
+    if (chash_get(&dt->windowAssocTable, winID)) {
+        page_cache_unmap_window(&fileServ.pageCache, winID);
+    }
     dspace_externalID_unassociate(&dt->windowAssocTable, winID);
 }
 
@@ -20,6 +20,7 @@
 #include <data_struct/chash.h>
 #include <refos/refos.h>
 #include <refos-rpc/rpc.h>
+#include "file_index.h"
 
 /*! @file
     @brief File server CPIO dataspace object allocation and management. */  
@@ -32,7 +33,8 @@
 /*! @brief File server dataspace
 
     File server dataspace structure. Dataspace cap is a badged endpoint cap of the file server.
-    The structure has no ownership of the actual file data.
+    The structure has no ownership of the actual file data; it holds a reference on the indexed
+    file, which always has the current data pointer and size, as RAMFS file data may move.
  */
 struct fs_dataspace {
     uint32_t magic;
@@ -42,9 +44,7 @@ struct fs_dataspace {
     seL4_CPtr dataspaceCap;
     seL4_Word permissions;
 
-    char *fileData; /* Not owned. */
-    size_t fileDataSize;
-    bool fileCreated;
+    struct fs_file *file; /* Holds a reference. */
 };
 
 /*! @brief File server CPIO dataspace association
@@ -60,6 +60,10 @@ struct dataspace_association_info {
     int dataspaceID;         /*!< The internal dataspace ID being associated to. */
     int dataspaceOffset;     /*!< Offset into the internal dataspace ID. */
     seL4_CPtr objectCap;     /*!< The associated object's capability; window cap or dspace cap. */
+
+    /* Sequential fault detection, for window associations only. */
+    vaddr_t readAheadNextAddr; /*!< Client page a sequential fault is expected at next. */
+    uint32_t readAheadNPages;  /*!< Number of pages mapped on the previous fault. */
 };
 
 struct fs_dataspace_table {
@@ -86,13 +90,12 @@ void dspace_table_release(struct fs_dataspace_table *dt);
 /*! @brief Assigns an dataspace ID and creates a fs_dataspace structure.
     @param dt The dspace table to allocate from.
     @param deathID The dspace table to allocate from.
-    @param fileData The CPIO file data pointer. (No ownership passed)
-    @param fileDataSize The CPIO file data size.
+    @param file The indexed CPIO or RAMFS file. (No ownership passed, a reference is taken)
     @param permissions The dataspace permissions mask.
     @return Weak pointer to created dataspace. (ie. No ownership)
 */
-struct fs_dataspace* dspace_alloc(struct fs_dataspace_table *dt, uint32_t deathID, char *fileData,
-        size_t fileDataSize, seL4_Word permissions);
+struct fs_dataspace* dspace_alloc(struct fs_dataspace_table *dt, uint32_t deathID,
+        struct fs_file *file, seL4_Word permissions);
 
 /*! @brief Gets the associated dataspace structure given an ID.
     @param dt The dspace table to get from.
@@ -26,32 +26,9 @@
   refos-rpc/data_server.h.
 */
 
-#define CPIO_RAMFS_MAX_CREATED_FILES 64
-#define CPIO_RAMFS_MAX_FILESSIZE 40960
-#define CPIO_RAMFS_MAX_FILENAME 32
-
-/*! @brief Forward declaration of the CPIO archive.
-
-    The CPIO archive is a simple format file archive stored inside a parent program's ELF section.
-    This is a similar idea to something like creating a
-    > const char data[] = { 0x3F, 0xFF, 0x23 ...etc}
-*/
-extern char _cpio_archive[];
-
-/*! @brief Rather hacky minimal ramfs created files.
-    
-    This is a rather terrible hack to allow creation of writable files in CPIO fileserver as a sort
-    of minimal crude RamFS. The functionality is nice for portability, although in the future a
-    much better way to do this should be implemented.
-*/
-static char _ramfs_archive[CPIO_RAMFS_MAX_CREATED_FILES][CPIO_RAMFS_MAX_FILESSIZE];
-static char _ramfs_filename[CPIO_RAMFS_MAX_CREATED_FILES][CPIO_RAMFS_MAX_FILENAME];
-static int _ramfs_filesz[CPIO_RAMFS_MAX_CREATED_FILES];
-static int _ramfs_curfile = 0; /* Incrementally allocated files. */
-
 seL4_CPtr
-data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode , int rpc_size ,
-                  int* rpc_errno)
+data_open_internal_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
+                           int rpc_size , uint32_t* rpc_dspaceSize , int* rpc_errno)
 {
     struct srv_client *c = (struct srv_client *) rpc_userptr;
     assert(c->magic == FS_CLIENT_MAGIC);
@@ -61,65 +38,54 @@ data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_m
         return 0;
     }
 
-    /* Find file data in CPIO. */
+    /* Find the CPIO or RAMFS file in the path index. */
     dprintf("Opening %s...\n", rpc_name);
-    unsigned long fileDataSize = 0;
-    char *fileData = cpio_get_file(_cpio_archive, rpc_name, &fileDataSize);
-    bool fileCreated = false;
+    struct fs_file *file = file_index_find(&fileServ.fileIndex, rpc_name);
 
-    if (fileData && (rpc_flags & O_ACCMODE) != O_RDONLY) {
+    if (file && !file->ramfs && (rpc_flags & O_ACCMODE) != O_RDONLY) {
         /* CPIO dataspaces require read only. */
         SET_ERRNO_PTR(rpc_errno, EACCESSDENIED);
         return 0;
     }
 
-    if (!fileData) {
-        for (int i = 0; i < _ramfs_curfile; i++) {
-            if (!strcmp(rpc_name, _ramfs_filename[i])) {
-                if ((rpc_flags & O_CREAT)) {
-                    /* Re-create this file. */
-                    memset(_ramfs_archive[i], 0, CPIO_RAMFS_MAX_FILESSIZE);
-                    _ramfs_filesz[i] = 0;
-                }
-                fileData = _ramfs_archive[i];
-                fileDataSize = _ramfs_filesz[i];
-                fileCreated = true;
-                break;
-            }
+    if (file && file->ramfs && (rpc_flags & O_TRUNC)) {
+        /* Truncate this file, giving its pages back to the RAMFS page pool. */
+        int error = ramfs_file_resize(&fileServ.ramfs, file, 0);
+        if (error != ESUCCESS) {
+            SET_ERRNO_PTR(rpc_errno, error);
+            return 0;
         }
     }
 
-    if (!fileData) {
+    if (!file) {
         if ((rpc_flags & O_CREAT) == 0) {
             dprintf("File %s not found!\n", rpc_name);
             SET_ERRNO_PTR(rpc_errno, EFILENOTFOUND);
             return 0;
         }
-        /* Assign new blank RAMFS file. */
-        if (_ramfs_curfile >= CPIO_RAMFS_MAX_CREATED_FILES) {
-            SET_ERRNO_PTR(rpc_errno, EACCESSDENIED);
+        /* Assign new blank RAMFS file. Its pages are reserved as it is written to. */
+        dvprintf("Creating new file %s...\n", rpc_name);
+        file = file_index_add_ramfs(&fileServ.fileIndex, rpc_name);
+        if (!file) {
+            SET_ERRNO_PTR(rpc_errno, ENOMEM);
             return 0;
         }
-        dvprintf("Creating new file %s...\n", rpc_name);
-        strncpy(_ramfs_filename[_ramfs_curfile], rpc_name, CPIO_RAMFS_MAX_FILENAME);
-        fileData = _ramfs_archive[_ramfs_curfile++];
-        fileDataSize = 0;
-        fileCreated = true;
     }
 
     /* Allocate new dataspace structure. */
-    struct fs_dataspace* nds = dspace_alloc(&fileServ.dspaceTable, c->deathID, fileData,
-        (size_t) fileDataSize, O_RDONLY);
+    struct fs_dataspace* nds = dspace_alloc(&fileServ.dspaceTable, c->deathID, file, O_RDONLY);
     if (!nds) {
-        ROS_ERROR("data_open_handler failed to allocate dataspace.");
+        ROS_ERROR("data_open_internal_handler failed to allocate dataspace.");
         SET_ERRNO_PTR(rpc_errno, ENOMEM);
         return 0;
     }
-    nds->fileCreated = fileCreated;
 
-    dvprintf("%s file %s OK ID %d...\n", fileCreated ? "Created" : "Opened", rpc_name, nds->dID);
+    dvprintf("%s file %s OK ID %d...\n", file->ramfs ? "Created" : "Opened", rpc_name, nds->dID);
     SET_ERRNO_PTR(rpc_errno, ESUCCESS);
     assert(nds->dataspaceCap);
+    if (rpc_dspaceSize) {
+        (*rpc_dspaceSize) = (uint32_t) file->size;
+    }
     return nds->dataspaceCap;
 }
 
@@ -148,6 +114,85 @@ data_close_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd)
     return ESUCCESS;
 }
 
+refos_err_t
+data_unlink_handler(void *rpc_userptr , char* rpc_name)
+{
+    struct srv_client *c = (struct srv_client *) rpc_userptr;
+    assert(c->magic == FS_CLIENT_MAGIC);
+    (void) c;
+
+    if (!rpc_name) {
+        return EINVALIDPARAM;
+    }
+
+    struct fs_file *file = file_index_find(&fileServ.fileIndex, rpc_name);
+    if (!file) {
+        dprintf("File %s not found!\n", rpc_name);
+        return EFILENOTFOUND;
+    }
+    if (!file->ramfs) {
+        /* CPIO files are read only. */
+        return EACCESSDENIED;
+    }
+
+    /* The file stays alive until its last open dataspace is closed. */
+    dvprintf("Unlinking file %s...\n", rpc_name);
+    ramfs_file_unlink(&fileServ.ramfs, &fileServ.fileIndex, file);
+    return ESUCCESS;
+}
+
+/*! @brief Read from a CPIO / RAMFS file dataspace into the given buffer.
+    @return Number of bytes read.
+*/
+static int
+cpio_dspace_read(struct fs_dataspace* dspace, uint32_t offset, char *buf, uint32_t count)
+{
+    assert(dspace && dspace->magic == FS_DATASPACE_MAGIC);
+    struct fs_file *file = dspace->file;
+    assert(file && file->magic == FS_FILE_MAGIC);
+
+    if (offset >= file->size) {
+        return 0;
+    }
+    count = MIN(file->size - offset, count);
+    memcpy(buf, file->data + offset, count);
+    return count;
+}
+
+/*! @brief Write to a RAMFS file dataspace from the given buffer.
+    @return Number of bytes written if success, negative refos_err_t otherwise.
+*/
+static int
+cpio_dspace_write(struct fs_dataspace* dspace, uint32_t offset, char *buf, uint32_t count)
+{
+    assert(dspace && dspace->magic == FS_DATASPACE_MAGIC);
+    struct fs_file *file = dspace->file;
+    assert(file && file->magic == FS_FILE_MAGIC);
+
+    if (!file->ramfs) {
+        /* Tried to write to a read only CPIO file. */
+        ROS_WARNING("data_write_handler: Tried to write to a read only CPIO file %d.", dspace->dID);
+        return -EACCESSDENIED;
+    }
+
+    if (!count) {
+        return 0;
+    }
+    if (offset + count < offset) {
+        return -EINVALIDPARAM;
+    }
+    if (offset + count > file->size) {
+        /* Extend the file. This may move its data, so only take the data pointer afterwards. */
+        int error = ramfs_file_resize(&fileServ.ramfs, file, offset + count);
+        if (error != ESUCCESS) {
+            return -error;
+        }
+    }
+    memcpy(file->data + offset, buf, count);
+    page_cache_invalidate(&fileServ.pageCache, file, offset, count);
+    return count;
+}
+
 int
 data_read_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
                   rpc_buffer_t rpc_buf , uint32_t rpc_count)
@@ -168,15 +213,8 @@ data_read_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_off
         ROS_WARNING("data_read_handler: no such dataspace.");
         return 0;
     }
-    assert(dspace->magic == FS_DATASPACE_MAGIC);
-    assert(dspace->fileData);
 
-    if (rpc_offset >= dspace->fileDataSize) {
-        return 0;
-    }
-    uint32_t count = MIN(dspace->fileDataSize - rpc_offset, rpc_buf.count);
-    memcpy(rpc_buf.data, dspace->fileData + rpc_offset, count);
-    return count;
+    return cpio_dspace_read(dspace, rpc_offset, rpc_buf.data, rpc_buf.count);
 }
 
 int
@@ -199,30 +237,8 @@ data_write_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_of
         ROS_WARNING("data_write_handler: no such dataspace.");
         return 0;
     }
-    assert(dspace->magic == FS_DATASPACE_MAGIC);
-    assert(dspace->fileData);
-
-    if (!dspace->fileCreated) {
-        /* Tried to write to a read only CPIO file. */
-        ROS_WARNING("data_write_handler: Tried to write to a read only CPIO file %d.", dspace->dID);
-        return -EACCESSDENIED;
-    }
 
-    if (rpc_offset + rpc_buf.count > dspace->fileDataSize) {
-        if (rpc_offset + rpc_buf.count > CPIO_RAMFS_MAX_FILESSIZE) {
-            assert(!"File maxsize overflow.");
-            return -ENOMEM;
-        }
-        dspace->fileDataSize = rpc_offset + rpc_buf.count;
-    }
-    for (int i = 0; i < _ramfs_curfile; i++) {
-        if (_ramfs_archive[i] == dspace->fileData) {
-            _ramfs_filesz[i] = dspace->fileDataSize;
-            break;
-        }
-    }
-    memcpy(dspace->fileData + rpc_offset, rpc_buf.data, rpc_buf.count);
-    return rpc_buf.count;
+    return cpio_dspace_write(dspace, rpc_offset, rpc_buf.data, rpc_buf.count);
 }
 
 int
@@ -260,7 +276,8 @@ data_get_size_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd)
     }
     assert(dspace->magic == FS_DATASPACE_MAGIC);
 
-    return (uint32_t) dspace->fileDataSize;
+    assert(dspace->file && dspace->file->magic == FS_FILE_MAGIC);
+    return (uint32_t) dspace->file->size;
 }
 
 refos_err_t
@@ -432,6 +449,74 @@ data_provide_data_from_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dsp
     return EUNIMPLEMENTED;
 }
 
+int
+data_read_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
+                              uint32_t rpc_count)
+{
+    struct srv_client *c = (struct srv_client *) rpc_userptr;
+    srv_msg_t *m = (srv_msg_t *) c->rpcClient.userptr;
+    assert(c->magic == FS_CLIENT_MAGIC);
+
+    if (!srv_check_dispatch_caps(m, 0x00000001, 1)) {
+        dprintf("data_read_parambuffer_handler EINVALIDPARAM: bad caps.\n");
+        return -EINVALIDPARAM;
+    }
+
+    struct fs_dataspace* dspace = dspace_get_badge(&fileServ.dspaceTable, rpc_dspace_fd);
+    if (!dspace) {
+        ROS_WARNING("data_read_parambuffer_handler: no such dataspace.");
+        return -EINVALIDPARAM;
+    }
+    if (rpc_count == 0) {
+        /* Zero-length probe, sent before the client sets up its parameter buffer. */
+        return 0;
+    }
+
+    /* Read straight into the client's mapped parameter buffer. */
+    char *paramBuffer = client_map_param_buffer(c);
+    if (!paramBuffer) {
+        return -ENOPARAMBUFFER;
+    }
+    if (rpc_count > c->paramBufferSize) {
+        return -EINVALIDPARAM;
+    }
+    return cpio_dspace_read(dspace, rpc_offset, paramBuffer, rpc_count);
+}
+
+int
+data_write_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
+                               uint32_t rpc_count)
+{
+    struct srv_client *c = (struct srv_client *) rpc_userptr;
+    srv_msg_t *m = (srv_msg_t *) c->rpcClient.userptr;
+    assert(c->magic == FS_CLIENT_MAGIC);
+
+    if (!srv_check_dispatch_caps(m, 0x00000001, 1)) {
+        dprintf("data_write_parambuffer_handler EINVALIDPARAM: bad caps.\n");
+        return -EINVALIDPARAM;
+    }
+
+    struct fs_dataspace* dspace = dspace_get_badge(&fileServ.dspaceTable, rpc_dspace_fd);
+    if (!dspace) {
+        ROS_WARNING("data_write_parambuffer_handler: no such dataspace.");
+        return -EINVALIDPARAM;
+    }
+    if (rpc_count == 0) {
+        /* Zero-length probe, sent before the client sets up its parameter buffer. */
+        return 0;
+    }
+
+    /* Write straight from the client's mapped parameter buffer. */
+    char *paramBuffer = client_map_param_buffer(c);
+    if (!paramBuffer) {
+        return -ENOPARAMBUFFER;
+    }
+    if (rpc_count > c->paramBufferSize) {
+        return -EINVALIDPARAM;
+    }
+    return cpio_dspace_write(dspace, rpc_offset, paramBuffer, rpc_count);
+}
+
 int
 check_dispatch_data(srv_msg_t *m, void **userptr)
 {
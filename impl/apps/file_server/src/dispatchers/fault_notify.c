@@ -8,6 +8,8 @@
 #include <refos/error.h>
 #include <refos/share.h>
 #include <refos-rpc/proc_common.h>
+#include <refos-rpc/proc_client.h>
+#include <refos-rpc/proc_client_helper.h>
 #include <refos-rpc/data_client.h>
 #include <refos-rpc/data_client_helper.h>
 #include <refos-util/serv_connect.h>
@@ -26,11 +28,138 @@
     an anonymous memory dataspace (ie. the notification buffer).
 */
 
+#ifndef CONFIG_REFOS_FILESERV_READ_AHEAD_MAX_PAGES
+    #define CONFIG_REFOS_FILESERV_READ_AHEAD_MAX_PAGES 16
+#endif
+
+/*! @brief A page to be mapped into a faulting client window. */
+struct fs_fault_page {
+    uint32_t winOffset; /* Offset into the window to map the page at. */
+    vaddr_t frame; /* The frame in our own vspace to map. */
+    struct fs_page_cache_entry *pe; /* Pinned page cache entry of the frame, NULL if archive. */
+};
+
+/*! @brief Find the CPIO archive's own page to map at the given offset into a client window.
+
+    The CPIO archive is part of our own image, so when a page of a CPIO file lines up exactly with
+    a page of the archive, we can share the archive's frame with a read-only client window,
+    instead of copying the file content into a page cache frame. Writable windows always get a
+    private copy, as the client's writes must never reach the archive. This also needs the file
+    data to be page-aligned in the archive (see CONFIG_REFOS_FILESERV_CPIO_PAGE_ALIGN), and the
+    window base to be page-aligned. Pages that are only partly file data (ie. the last page of a
+    file) are still copied, so the client never sees the neighbouring archive contents.
+
+    @param dspace The dataspace mapped into the faulting window.
+    @param dwa The window association of the faulting window.
+    @param winBase The base address of the faulting window.
+    @param winSize The size of the faulting window.
+    @param winOffset The offset into the window of the page.
+    @param writable Whether the faulting window is writable.
+    @return The address of the archive page, 0 if the page must be copied.
+*/
+static vaddr_t
+handle_fileserver_fault_archive_frame(struct fs_dataspace *dspace,
+        struct dataspace_association_info *dwa, seL4_Word winBase, seL4_Word winSize,
+        size_t winOffset, bool writable)
+{
+    struct fs_file *file = dspace->file;
+    assert(file && file->magic == FS_FILE_MAGIC);
+    if (writable || file->ramfs || !file->data || REFOS_PAGE_ALIGN(winBase) != winBase) {
+        return 0;
+    }
+
+    size_t pageWinOffset = REFOS_PAGE_ALIGN(winOffset);
+    size_t fileOffset = dwa->dataspaceOffset + pageWinOffset;
+    if (pageWinOffset + REFOS_PAGE_SIZE > winSize || fileOffset < pageWinOffset ||
+            fileOffset + REFOS_PAGE_SIZE > file->size) {
+        return 0;
+    }
+    vaddr_t archivePage = (vaddr_t) (file->data + fileOffset);
+    if (REFOS_PAGE_ALIGN(archivePage) != archivePage) {
+        return 0;
+    }
+    return archivePage;
+}
+
+/*! @brief Get the page cache frame holding a page of the file mapped into a faulting window.
+
+    Read-only windows share the cached frame with every other window on the same page. Writable
+    windows get a private copy of the page, since the client's writes must not show through to
+    anyone else mapping the file.
+
+    @param file The file mapped into the faulting window.
+    @param writable Whether the faulting window is writable.
+    @param offset The file offset the frame should start at.
+    @return The pinned page cache entry (No ownership), NULL if there are no frames.
+*/
+static struct fs_page_cache_entry *
+handle_fileserver_fault_cache_page(struct fs_file *file, bool writable, int64_t offset)
+{
+    if (writable) {
+        return page_cache_get_private(&fileServ.pageCache, file, offset);
+    }
+    return page_cache_get(&fileServ.pageCache, file, offset);
+}
+
+/*! @brief Work out how many pages to map for a client page fault.
+
+    A fault landing exactly on the page after the pages mapped on the previous fault in the same
+    window is treated as a sequential scan, and doubles the number of pages to map, up to
+    CONFIG_REFOS_FILESERV_READ_AHEAD_MAX_PAGES. Any other fault maps just the faulting page. Pages
+    past the end of the window or the file are never read ahead.
+
+    @param file The file mapped into the faulting window.
+    @param dwa The window association of the faulting window.
+    @param alignedFaultAddr The page-aligned faulting address.
+    @param winSize The size of the faulting window.
+    @param faultAddrWinOffset The offset of the faulting address into the window.
+    @param pageFileOffset The file offset of the start of the faulting page.
+    @return Number of pages to map, starting from the faulting page.
+*/
+static uint32_t
+handle_fileserver_fault_npages(struct fs_file *file, struct dataspace_association_info *dwa,
+        seL4_Word alignedFaultAddr, seL4_Word winSize, size_t faultAddrWinOffset,
+        int64_t pageFileOffset)
+{
+    uint32_t maxPages = 1;
+    if (dwa->readAheadNPages && alignedFaultAddr == dwa->readAheadNextAddr) {
+        maxPages = MIN(dwa->readAheadNPages * 2, CONFIG_REFOS_FILESERV_READ_AHEAD_MAX_PAGES);
+    }
+    uint32_t nPages = 1;
+    while (nPages < maxPages &&
+            faultAddrWinOffset + nPages * REFOS_PAGE_SIZE < winSize &&
+            pageFileOffset + nPages * REFOS_PAGE_SIZE < (int64_t) file->size) {
+        nPages++;
+    }
+    return nPages;
+}
+
+/*! @brief Map a run of pages, of the same kind and contiguous in our own vspace, into the
+           faulting client window with a single process server call.
+    @return ESUCCESS on success, refos_err_t otherwise.
+*/
+static int
+handle_fileserver_fault_map_run(int winID, struct dataspace_association_info *dwa,
+        struct fs_fault_page *pages, uint32_t nPages)
+{
+    dvprintf("    Mapping %u %s frames at 0x%x ―――▶ client window offset 0x%x\n", nPages,
+            pages[0].pe ? "cached" : "archive", (uint32_t) pages[0].frame, pages[0].winOffset);
+    if (pages[0].pe) {
+        return page_cache_map_run(&fileServ.pageCache, pages[0].frame, nPages, winID,
+                                  dwa->objectCap, pages[0].winOffset);
+    }
+    /* Share the archive frames with the client, read-only. */
+    return proc_window_map_range(dwa->objectCap, pages[0].winOffset, (seL4_Word) pages[0].frame,
+                                 nPages, PROC_WINDOW_PERMISSION_READ);
+}
+
 /*! @brief Handles client page fault notifications.
     
     This function handles client page fault notifications from the process server. When we act as
     the pager, the process server delegates all page faults to us via this notification.
-    We then choose a page to map, and map it.
+    We then choose a page to map, and map it. When the client appears to be scanning through the
+    window sequentially, the pages following the faulting page are read ahead and mapped along
+    with it, saving the client a fault delegation round-trip for each of them.
 
     @param notification Structure containing the notification message, read from the notification
                         ring buffer.
@@ -55,6 +184,7 @@ handle_fileserver_fault(struct proc_notification *notification)
     seL4_Word winSize = notification->arg[1];
     seL4_Word faultAddr = notification->arg[2];
     seL4_Word winBase = notification->arg[3];
+    bool writable = (notification->arg[5] & PROC_WINDOW_PERMISSION_WRITE) != 0;
 
     /* Look up the faulting window. */
     struct dataspace_association_info *dwa = dspace_window_find(&fileServ.dspaceTable, winID);
@@ -77,105 +207,130 @@ handle_fileserver_fault(struct proc_notification *notification)
     }
     size_t faultAddrWinOffset = faultAddr - winBase;
 
-    /* Allocate a frame to page client with. */
-    vaddr_t pframe = pager_alloc_frame(&fileServ.pageFrameBlock);
-    if (!pframe) {
-        ROS_ERROR("File Server Out of memory handling VM fault. Paging not implemented.");
-        ROS_ERROR("  Try increasing FILESERVER_MAX_PAGE_FRAMES.");
+    /* Round faulting address down to page. */
+    seL4_Word alignedFaultAddr = REFOS_PAGE_ALIGN(faultAddr);
+
+    /* initFrameSkip is to compensate for the case where the window base is not page aligned,
+       and the faulting address is the first page of the window, resulting in a region of
+       page overlap that we can't avoid. Illustration:
+
+                                  winBase   faultAddr
+                                        ▼   ▼
+             |_______|_______|_______|__[―――◯|―――――――|―――――――]_______|_______|
+                                     ▲  ◀――――― window ―――――――▶
+                      alignedFaultAddr  
+                                     ◀――▶ initFrameSkip = (winBase - alignedFaultAddr)
+    */ 
+    size_t initFrameSkip = (winBase > alignedFaultAddr) ? (winBase - alignedFaultAddr) : 0;
+
+    /* dataspaceSkipWinOffset is for all cases except the (unsigned window base addr &
+       first page fault) special case. Illustration:
+       
+                                  winBase                faultAddr
+                                        ▼                ▼
+             |_______|_______|_______|__[――――|―――――――|―――◯―――]_______|_______|
+                                     ▲  ◀――――― window ―――――――▶
+                      alignedFaultAddr  
+                                        ◀――――――――――――――――▶ dataspaceSkipWinOffset
+                                          = (alignedFaultAddr - winBase)
+    */ 
+    size_t dataspaceSkipWinOffset = (winBase > alignedFaultAddr) ?
+            0 : (alignedFaultAddr - winBase);
+
+    /* The frame of the faulting page starts (initFrameSkip) bytes before the start of the
+       window's content in the first page. */
+    int64_t pageFileOffset = (int64_t) dwa->dataspaceOffset + (int64_t) dataspaceSkipWinOffset -
+                             (int64_t) initFrameSkip;
+
+    /* Find the frames to map: the faulting page, followed by any pages read ahead. */
+    struct fs_fault_page pages[CONFIG_REFOS_FILESERV_READ_AHEAD_MAX_PAGES > 1 ?
+                               CONFIG_REFOS_FILESERV_READ_AHEAD_MAX_PAGES : 1];
+    uint32_t nPages = handle_fileserver_fault_npages(dspace->file, dwa, alignedFaultAddr,
+            winSize, faultAddrWinOffset, pageFileOffset);
+    uint32_t i;
+    for (i = 0; i < nPages; i++) {
+        pages[i].winOffset = faultAddrWinOffset + i * REFOS_PAGE_SIZE;
+        pages[i].pe = NULL;
+
+        /* Map CPIO file content without copying it, if it lines up with the archive's pages. */
+        pages[i].frame = handle_fileserver_fault_archive_frame(dspace, dwa, winBase, winSize,
+                                                               pages[i].winOffset, writable);
+        if (pages[i].frame) {
+            continue;
+        }
+
+        /* Otherwise get the frame holding this page of the file from the page cache. */
+        pages[i].pe = handle_fileserver_fault_cache_page(dspace->file, writable,
+                                                         pageFileOffset + i * REFOS_PAGE_SIZE);
+        if (!pages[i].pe) {
+            break;
+        }
+        pages[i].frame = pages[i].pe->frame;
+    }
+    if (i == 0) {
+        if (writable) {
+            ROS_ERROR("File Server has no private frame left for a writable window.");
+        } else {
+            ROS_ERROR("File Server could not find a page cache frame to reclaim.");
+        }
         ROS_ERROR("  Faulting client will be permanently blocked.");
         return DISPATCH_ERROR;
     }
-    memset((void*) pframe, 0, REFOS_PAGE_SIZE);
-
-    /* Copy any CPIO file content if there is data. */
-    if (dspace->fileData) {
-        /* Round faulting address down to page. */
-        seL4_Word alignedFaultAddr = REFOS_PAGE_ALIGN(faultAddr);
-
-        /* initFrameSkip is to compensate for the case where the window base is not page aligned,
-           and the faulting address is the first page of the window, resulting in a region of
-           page overlap that we can't avoid. Illustration:
-
-                                      winBase   faultAddr
-                                            ▼   ▼
-                 |_______|_______|_______|__[―――◯|―――――――|―――――――]_______|_______|
-                                         ▲  ◀――――― window ―――――――▶
-                          alignedFaultAddr  
-                                         ◀――▶ initFrameSkip = (winBase - alignedFaultAddr)
-        */ 
-        size_t initFrameSkip = (winBase > alignedFaultAddr) ? (winBase - alignedFaultAddr) : 0;
-
-        /* dataspaceSkipWinOffset is for all cases except the (unsigned window base addr &
-           first page fault) special case. Illustration:
-           
-                                      winBase                faultAddr
-                                            ▼                ▼
-                 |_______|_______|_______|__[――――|―――――――|―――◯―――]_______|_______|
-                                         ▲  ◀――――― window ―――――――▶
-                          alignedFaultAddr  
-                                            ◀――――――――――――――――▶ dataspaceSkipWinOffset
-                                              = (alignedFaultAddr - winBase)
-        */ 
-        size_t dataspaceSkipWinOffset = (winBase > alignedFaultAddr) ?
-                0 : (alignedFaultAddr - winBase);
-
-        /* nbytes is the number of bytes from the offset dataspace start that we should copy into
-           the frame. There are 4 cases here:
-
-            Case 1:
-                 |_______|_______|_______|__[――――|―――――――|―――◯―――]_______|_______| 
-                                            ◀――――▶ nbytes = (REFOS_PAGE_SIZE - initFrameSkip)
-
-            Case 2:
-                 |_______|_______|_______[―――――――|―――◯―――|―――――――]_______|_______| 
-                                                 ◀―――――――▶ nbytes = REFOS_PAGE_SIZE
-
-            Case 3:
-                 |_______|_______|_______[―――――――|―――――――|―◯―××××]_______|_______| 
-                                                         ◀―――▶ nbytes = fileDataSize -
-                                                            dataspaceSkipWinOffset - dataspaceOffset
-                        (× = indicates there is no more CPIO file data here)
-
-            Case 3:
-                 |_______|_______|_______[―――――――|―――――――|―◯――]__|_______|_______| 
-                                                         ◀――――▶ nbytes =
-                                                                winSize - dataspaceSkipWinOffset
-        */
-        size_t nbytes = MIN(REFOS_PAGE_SIZE - initFrameSkip,
-                dspace->fileDataSize - dataspaceSkipWinOffset - dwa->dataspaceOffset);
-        nbytes = MIN(nbytes, winSize - dataspaceSkipWinOffset);
-
-        /* Check if nbytes is sane. */
-        if ((dspace->fileDataSize - dataspaceSkipWinOffset - dwa->dataspaceOffset >
-                dspace->fileDataSize) ||
-            (dspace->fileDataSize - dataspaceSkipWinOffset > dspace->fileDataSize) ||
-            (dspace->fileDataSize - dwa->dataspaceOffset > dspace->fileDataSize)) {
-            ROS_ERROR("nbytes overflowed.\n");
-            assert(!"nbytes overflowed. Fileserver bug.");
-            pager_free_frame(&fileServ.pageFrameBlock, pframe);
-            return DISPATCH_ERROR;
+    nPages = i;
+    dwa->readAheadNPages = nPages;
+    dwa->readAheadNextAddr = alignedFaultAddr + nPages * REFOS_PAGE_SIZE;
+
+    /* Now map the frames into the client's vspace window, batching runs of frames which are
+       contiguous in our vspace. The runs are mapped back to front, so the faulting client is
+       only resumed once every page read ahead for it is already in place. A read-ahead page
+       failing to map is not an error, the client will simply fault on it later. */
+    error = ESUCCESS;
+    uint32_t runEnd = nPages;
+    while (runEnd > 0) {
+        uint32_t runStart = runEnd - 1;
+        while (runStart > 0 && (!pages[runStart - 1].pe) == (!pages[runStart].pe) &&
+                pages[runStart - 1].frame + REFOS_PAGE_SIZE == pages[runStart].frame) {
+            runStart--;
+        }
+        int runError = handle_fileserver_fault_map_run(winID, dwa, &pages[runStart],
+                                                       runEnd - runStart);
+        if (runStart == 0) {
+            error = runError;
+        } else if (runError) {
+            dvprintf("    Could not map read-ahead frames, skipping...\n");
         }
+        runEnd = runStart;
+    }
 
-        memcpy (
-                (void*) (pframe + initFrameSkip),
-                dspace->fileData + dwa->dataspaceOffset + dataspaceSkipWinOffset,
-                nbytes
-        );
+    /* If we could not map the archive frame, fall back to copying the faulting page. */
+    if (error && error != EUNMAPFIRST && !pages[0].pe) {
+        dvprintf("    Could not map archive frame, falling back to copy...\n");
+        pages[0].pe = handle_fileserver_fault_cache_page(dspace->file, writable, pageFileOffset);
+        if (pages[0].pe) {
+            pages[0].frame = pages[0].pe->frame;
+            error = handle_fileserver_fault_map_run(winID, dwa, &pages[0], 1);
+        }
     }
 
-    /* Now map the frame into the client's vspace window. */
-    dvprintf("    Mapping frame at  0x%x ―――▶ client 0x%x\n", (uint32_t) pframe,
-            (uint32_t) faultAddr);
-    error = proc_window_map(dwa->objectCap, faultAddrWinOffset, (seL4_Word) pframe);
+    for (i = 0; i < nPages; i++) {
+        if (pages[i].pe) {
+            page_cache_unpin(&fileServ.pageCache, pages[i].pe);
+        }
+    }
+
+    if (error == EUNMAPFIRST) {
+        ROS_WARNING("File Server client faulted on a page which is already mapped.");
+        ROS_WARNING("  Faulting client will be permanently blocked.");
+        return DISPATCH_ERROR;
+    }
     if (error) {
         ROS_ERROR("File Server Unexpected error while mapping frame!");
         ROS_ERROR("  Most likely a file server bug.");
         assert(!"proc_window_map error. Fileserver bug.");
-        pager_free_frame(&fileServ.pageFrameBlock, pframe);
         return DISPATCH_ERROR;
     }
 
-    dvprintf("    Successfully mapped frame...\n");
+    dvprintf("    Successfully mapped %u frames...\n", nPages);
     return DISPATCH_SUCCESS;
 }
 
@@ -183,7 +338,8 @@ handle_fileserver_fault(struct proc_notification *notification)
 
     Handles dataspace content init notifications from another dataserver. When we act as a data
     provider, the external dataserver (eg. process server for anon memory) notifies us with this
-    notification for us to provide the content for it.
+    notification for us to provide the content for it. The notification may ask for a run of
+    pages, in which case as much of the run as fits in our parameter buffer is provided at once.
     We find the content that was asked for, and reply to the notification with data_provide_data.
 
     @param notification Structure containing the notification message, read from the notification
@@ -197,10 +353,11 @@ handle_fileserver_content_init(struct proc_notification *notification)
     dvprintf("    Label: PROCSERV_NOTIFY_CONTENT_INIT\n");
     dvprintf("    dataID: %d\n", notification->arg[0]);
     dvprintf("    procDsOffset: %d\n", notification->arg[1]);
-    dvprintf("    winOffset: %d\n", notification->arg[2]);
+    dvprintf("    nPages: %d\n", notification->arg[2]);
 
     seL4_Word dataID = notification->arg[0];
     seL4_Word destDataspaceOffset = notification->arg[1];
+    seL4_Word nPages = notification->arg[2] ? notification->arg[2] : 1;
 
     /* Look up the dataspace --> dataspace association. */
     struct dataspace_association_info *dda = dspace_external_find(&fileServ.dspaceTable, dataID);
@@ -224,16 +381,20 @@ handle_fileserver_content_init(struct proc_notification *notification)
     seL4_Word dataspaceOffset = destDataspaceOffset + dda->dataspaceOffset;
 
     /* Check the content size to copy. There are 2 cases here: either the size to copy ends
-       with the next page boundary, or is cut short because we've ran out of file data. */
-    size_t contentSize = MIN(dspace->fileDataSize - dataspaceOffset, REFOS_PAGE_SIZE);
+       with the requested run of pages (cut short to what fits in the parameter buffer), or is cut
+       short because we've ran out of file data. */
+    size_t contentSize = MIN(nPages * REFOS_PAGE_SIZE,
+            REFOS_PAGE_ALIGN(fileServCommon->procServParamBuffer.size));
+    assert(dspace->file && dspace->file->magic == FS_FILE_MAGIC);
+    contentSize = MIN(dspace->file->size - dataspaceOffset, contentSize);
     dvprintf("    Fault file source = 0x%x\n", (uint32_t) dataspaceOffset);
 
     /* Provide the data back to the process server who notified us. */
-    assert(dataspaceOffset < dspace->fileDataSize);
-    if (dspace->fileData) {
+    assert(dataspaceOffset < dspace->file->size);
+    if (dspace->file->data) {
         int error = data_provide_data(
                 REFOS_PROCSERV_EP, dda->objectCap,
-                destDataspaceOffset, (char*)dspace->fileData + dataspaceOffset,
+                destDataspaceOffset, dspace->file->data + dataspaceOffset,
                 contentSize, &fileServCommon->procServParamBuffer
         );
         if (error != ESUCCESS) {
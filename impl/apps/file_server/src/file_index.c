@@ -0,0 +1,245 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <refos/error.h>
+#include <refos/cycle_counter.h>
+#include <refos-util/dprintf.h>
+#include <data_struct/chash.h>
+#include "file_index.h"
+
+/*! @file
+    @brief File server path index module. */
+
+#define CPIO_NEWC_MAGIC "070701"
+#define CPIO_NEWC_HEADER_SIZE 110
+#define CPIO_NEWC_FILESIZE_OFFSET 54
+#define CPIO_NEWC_NAMESIZE_OFFSET 94
+#define CPIO_NEWC_ALIGN 4
+#define CPIO_NEWC_ALIGN_UP(x) (((x) + CPIO_NEWC_ALIGN - 1) & ~(uintptr_t) (CPIO_NEWC_ALIGN - 1))
+#define CPIO_TRAILER_NAME "TRAILER!!!"
+
+/*! @brief Parse an 8 character hex field of a CPIO newc header. */
+static uint32_t
+file_index_parse_hex(const char *s)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') {
+            v |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            v |= c - 'A' + 10;
+        }
+    }
+    return v;
+}
+
+/*! @brief Parse the CPIO newc header at the given position of the archive.
+    @param header The header to parse.
+    @param name Output file name, NULL-terminated inside the archive.
+    @param data Output file data.
+    @param size Output file size.
+    @return The next header in the archive, or NULL if this is the trailer or not a valid header.
+*/
+static char *
+file_index_parse_header(char *header, const char **name, char **data, size_t *size)
+{
+    if (strncmp(header, CPIO_NEWC_MAGIC, strlen(CPIO_NEWC_MAGIC))) {
+        return NULL;
+    }
+    uint32_t fileSize = file_index_parse_hex(header + CPIO_NEWC_FILESIZE_OFFSET);
+    uint32_t nameSize = file_index_parse_hex(header + CPIO_NEWC_NAMESIZE_OFFSET);
+    (*name) = header + CPIO_NEWC_HEADER_SIZE;
+    if (!strcmp(*name, CPIO_TRAILER_NAME)) {
+        return NULL;
+    }
+    (*data) = (char*) CPIO_NEWC_ALIGN_UP((uintptr_t) (*name) + nameSize);
+    (*size) = fileSize;
+    return (char*) CPIO_NEWC_ALIGN_UP((uintptr_t) (*data) + fileSize);
+}
+
+/*! @brief Hash a file path. */
+static inline uint32_t
+file_index_hash(const char *name)
+{
+    return chash_hash_bytes(name, strlen(name));
+}
+
+static void
+file_index_insert(struct fs_file_index *fi, struct fs_file *f)
+{
+    assert(f && f->magic == FS_FILE_MAGIC);
+    f->nameHash = file_index_hash(f->name);
+    struct fs_file **bucket = &fi->buckets[f->nameHash & (fi->hashSize - 1)];
+    f->next = *bucket;
+    (*bucket) = f;
+    fi->count++;
+}
+
+int
+file_index_init(struct fs_file_index *fi, char *archive)
+{
+    assert(fi && archive);
+    memset(fi, 0, sizeof(struct fs_file_index));
+
+    uint64_t startCycles = 0, endCycles = 0;
+    bool haveCounter = refos_read_cycle_counter(&startCycles);
+
+    /* Count the archive files, to size the table and the file array. */
+    const char *name;
+    char *data;
+    size_t size;
+    char *h = archive;
+    while ((h = file_index_parse_header(h, &name, &data, &size))) {
+        fi->archiveCount++;
+    }
+
+    fi->hashSize = FS_FILE_INDEX_MIN_HASHSIZE;
+    while (fi->hashSize < fi->archiveCount * 2) {
+        fi->hashSize <<= 1;
+    }
+    fi->buckets = malloc(sizeof(struct fs_file*) * fi->hashSize);
+    if (!fi->buckets) {
+        ROS_ERROR("file_index_init failed to allocate hash table.");
+        return ENOMEM;
+    }
+    memset(fi->buckets, 0, sizeof(struct fs_file*) * fi->hashSize);
+    if (fi->archiveCount) {
+        fi->archiveFiles = malloc(sizeof(struct fs_file) * fi->archiveCount);
+        if (!fi->archiveFiles) {
+            ROS_ERROR("file_index_init failed to allocate file array.");
+            free(fi->buckets);
+            fi->buckets = NULL;
+            return ENOMEM;
+        }
+    }
+
+    /* Index every archive file. The first of any duplicate paths wins, as with a linear search. */
+    uint32_t i = 0;
+    char *next = file_index_parse_header(archive, &name, &data, &size);
+    while (next) {
+        assert(i < fi->archiveCount);
+        struct fs_file *f = &fi->archiveFiles[i++];
+        memset(f, 0, sizeof(struct fs_file));
+        f->magic = FS_FILE_MAGIC;
+        f->name = name;
+        f->data = data;
+        f->size = size;
+        f->ramfs = false;
+        if (!file_index_find(fi, name)) {
+            file_index_insert(fi, f);
+        }
+        next = file_index_parse_header(next, &name, &data, &size);
+    }
+
+    if (haveCounter && refos_read_cycle_counter(&endCycles)) {
+        fi->indexCycles = endCycles - startCycles;
+    }
+    return ESUCCESS;
+}
+
+void
+file_index_release(struct fs_file_index *fi)
+{
+    if (!fi) {
+        return;
+    }
+    for (uint32_t i = 0; i < fi->hashSize; i++) {
+        struct fs_file *f = fi->buckets[i];
+        while (f) {
+            struct fs_file *next = f->next;
+            if (f->ramfs) {
+                /* The RAMFS page pool is released separately. */
+                f->data = NULL;
+                f->npages = 0;
+                file_index_free_ramfs(f);
+            } else {
+                f->magic = 0;
+            }
+            f = next;
+        }
+    }
+    free(fi->buckets);
+    free(fi->archiveFiles);
+    memset(fi, 0, sizeof(struct fs_file_index));
+}
+
+struct fs_file *
+file_index_find(struct fs_file_index *fi, const char *name)
+{
+    assert(fi && fi->buckets);
+    if (!name) {
+        return NULL;
+    }
+    uint32_t hash = file_index_hash(name);
+    for (struct fs_file *f = fi->buckets[hash & (fi->hashSize - 1)]; f; f = f->next) {
+        assert(f->magic == FS_FILE_MAGIC);
+        if (f->nameHash == hash && !strcmp(f->name, name)) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+struct fs_file *
+file_index_add_ramfs(struct fs_file_index *fi, const char *name)
+{
+    assert(fi && fi->buckets);
+    if (!name || file_index_find(fi, name)) {
+        return NULL;
+    }
+    struct fs_file *f = malloc(sizeof(struct fs_file));
+    if (!f) {
+        ROS_ERROR("file_index_add_ramfs failed to allocate file.");
+        return NULL;
+    }
+    memset(f, 0, sizeof(struct fs_file));
+    char *nameCopy = malloc(strlen(name) + 1);
+    if (!nameCopy) {
+        ROS_ERROR("file_index_add_ramfs failed to allocate file name.");
+        free(f);
+        return NULL;
+    }
+    strcpy(nameCopy, name);
+    f->magic = FS_FILE_MAGIC;
+    f->name = nameCopy;
+    f->data = NULL;
+    f->size = 0;
+    f->ramfs = true;
+    file_index_insert(fi, f);
+    return f;
+}
+
+void
+file_index_remove(struct fs_file_index *fi, struct fs_file *f)
+{
+    assert(fi && fi->buckets);
+    assert(f && f->magic == FS_FILE_MAGIC && f->ramfs);
+    struct fs_file **link = &fi->buckets[f->nameHash & (fi->hashSize - 1)];
+    for (; *link; link = &(*link)->next) {
+        if (*link == f) {
+            (*link) = f->next;
+            f->next = NULL;
+            fi->count--;
+            return;
+        }
+    }
+}
+
+void
+file_index_free_ramfs(struct fs_file *f)
+{
+    assert(f && f->magic == FS_FILE_MAGIC && f->ramfs);
+    assert(!f->data && !f->npages);
+    f->magic = 0;
+    free((char*) f->name);
+    free(f);
+}
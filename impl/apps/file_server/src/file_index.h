@@ -0,0 +1,101 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief File server path index module.
+
+    Maps file paths to their data, for both the files in the CPIO archive and the RAMFS files
+    created at run time (see ramfs.h). The CPIO archive is walked once at start up, so that opening
+    a file is a hash lookup instead of a walk through every archive header.
+*/
+
+#ifndef _FILE_SERVER_FILE_INDEX_H_
+#define _FILE_SERVER_FILE_INDEX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define FS_FILE_MAGIC 0x2F11E1D8
+#define FS_FILE_INDEX_MIN_HASHSIZE 64
+
+/*! @brief Forward declaration of the CPIO archive.
+
+    The CPIO archive is a simple format file archive stored inside a parent program's ELF section.
+    This is a similar idea to something like creating a
+    > const char data[] = { 0x3F, 0xFF, 0x23 ...etc}
+*/
+extern char _cpio_archive[];
+
+/*! @brief A single indexed file. */
+struct fs_file {
+    uint32_t magic;
+    const char *name; /* Owned for RAMFS files, points into the archive for CPIO files. */
+    uint32_t nameHash;
+
+    char *data; /* Not owned. */
+    size_t size;
+    bool ramfs; /* Whether this is a writable RAMFS file, or a read-only CPIO file. */
+
+    uint32_t npages; /* RAMFS pages reserved at data. */
+    uint32_t ref; /* Number of open dataspaces on this file. */
+    bool unlinked; /* RAMFS file removed from the index, waiting for its last close. */
+
+    struct fs_file *next; /* Next file in the same hash bucket. */
+};
+
+/*! @brief File server path index. */
+struct fs_file_index {
+    struct fs_file **buckets;
+    uint32_t hashSize;
+    uint32_t count;
+
+    struct fs_file *archiveFiles; /* Has ownership, one allocation for the whole archive. */
+    uint32_t archiveCount;
+
+    uint64_t indexCycles; /* Cycles spent indexing the archive, 0 if no cycle counter. */
+};
+
+/*! @brief Initialise the path index, and index every file in the given CPIO archive.
+    @param fi The path index to initialise. (No ownership passed)
+    @param archive The CPIO archive to index. (No ownership passed)
+    @return ESUCCESS on success, refos_err_t otherwise.
+*/
+int file_index_init(struct fs_file_index *fi, char *archive);
+
+/*! @brief De-initialise the path index, and release all owned resources.
+    @param fi The path index to release. (No ownership passed, does NOT release the structure)
+*/
+void file_index_release(struct fs_file_index *fi);
+
+/*! @brief Find an indexed file by its path.
+    @param fi The path index.
+    @param name The path of the file to find.
+    @return Weak pointer to the file if found (No ownership), NULL otherwise.
+*/
+struct fs_file *file_index_find(struct fs_file_index *fi, const char *name);
+
+/*! @brief Add a new empty RAMFS file to the index.
+    @param fi The path index.
+    @param name The path of the file. (No ownership passed, the name is copied)
+    @return Weak pointer to the indexed file on success (No ownership), NULL otherwise.
+*/
+struct fs_file *file_index_add_ramfs(struct fs_file_index *fi, const char *name);
+
+/*! @brief Remove a RAMFS file from the index, so it can't be found any more. Does NOT free the
+           file; see file_index_free_ramfs().
+    @param fi The path index.
+    @param f The file to remove. (No ownership passed)
+*/
+void file_index_remove(struct fs_file_index *fi, struct fs_file *f);
+
+/*! @brief Free a RAMFS file that has been removed from the index. The file's data must have
+           already been released.
+    @param f The file to free. (Takes ownership)
+*/
+void file_index_free_ramfs(struct fs_file *f);
+
+#endif /* _FILE_SERVER_FILE_INDEX_H_ */
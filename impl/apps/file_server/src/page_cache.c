@@ -0,0 +1,406 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief File server page cache module.
+
+    The CLOCK reference bit of a cached frame is set whenever a client faults on it, since the
+    file server can't see the hardware accessed bits of client mappings. A frame which keeps being
+    faulted in by new windows (eg. a popular binary being started over and over) survives a
+    sweep of the clock hand, whereas a frame nobody faulted on since the last sweep is reclaimed.
+
+    Shared frames are hashed on the file and the file page their offset falls in, ignoring where
+    in that page the frame starts. A frame then overlaps at most two file pages, its own and the
+    next one, so the frames overlapping a changed range of a file are found by looking up the
+    range's pages (and the one before it), without walking the whole cache.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <autoconf.h>
+#include <utils/arith.h>
+#include <refos/refos.h>
+#include <refos/error.h>
+#include <refos-rpc/proc_client.h>
+#include <refos-rpc/proc_client_helper.h>
+#include <refos-util/dprintf.h>
+
+#include "page_cache.h"
+
+/*! @brief Get the file page a file offset falls in, rounding down for negative offsets. */
+static inline int64_t
+page_cache_file_page(int64_t offset)
+{
+    return offset >> seL4_PageBits;
+}
+
+/*! @brief Hash a (file, file page) page cache key. */
+static inline uint32_t
+page_cache_hash(struct fs_page_cache *pc, struct fs_file *file, int64_t filePage)
+{
+    uint32_t h = ((uint32_t) (uintptr_t) file) * 2654435761u;
+    h ^= ((uint32_t) filePage) * 40503u;
+    return h & (pc->hashSize - 1);
+}
+
+/*! @brief Get the page cache entry for the given pager frame. */
+static inline struct fs_page_cache_entry *
+page_cache_frame_entry(struct fs_page_cache *pc, vaddr_t frame)
+{
+    assert(frame >= pc->frameBlock->frameBlockVAddr);
+    uint32_t i = (frame - pc->frameBlock->frameBlockVAddr) / REFOS_PAGE_SIZE;
+    assert(i < pc->numEntries);
+    return &pc->entries[i];
+}
+
+/*! @brief Unmap a cached frame from every window it is mapped into. */
+static void
+page_cache_unmap_all(struct fs_page_cache *pc, struct fs_page_cache_entry *pe)
+{
+    int count = cvector_count(&pe->mappings);
+    for (int i = 0; i < count; i++) {
+        struct fs_page_cache_mapping *m = (struct fs_page_cache_mapping *)
+                cvector_get(&pe->mappings, i);
+        assert(m);
+        int error = proc_window_unmap(m->windowCap, m->windowOffset);
+        if (error != ESUCCESS) {
+            /* The window may have gone away along with its client already. */
+            dvprintf("page_cache_unmap_all: could not unmap window %d offset 0x%x.\n",
+                     m->winID, m->windowOffset);
+        }
+        free(m);
+    }
+    cvector_reset(&pe->mappings);
+}
+
+/*! @brief Remove a cached frame from the hash table, unmapping it from every client. The frame
+           itself stays with the entry. */
+static void
+page_cache_drop(struct fs_page_cache *pc, struct fs_page_cache_entry *pe)
+{
+    assert(pe && pe->magic == FS_PAGE_CACHE_MAGIC && pe->file);
+    page_cache_unmap_all(pc, pe);
+
+    if (!pe->privateCopy) {
+        struct fs_page_cache_entry **link =
+                &pc->buckets[page_cache_hash(pc, pe->file, page_cache_file_page(pe->offset))];
+        for (; *link; link = &(*link)->next) {
+            if (*link == pe) {
+                (*link) = pe->next;
+                break;
+            }
+        }
+    } else {
+        assert(pc->numPrivate > 0);
+        pc->numPrivate--;
+    }
+    pe->next = NULL;
+    pe->file = NULL;
+    pe->referenced = false;
+    pe->pinned = false;
+    pe->privateCopy = false;
+}
+
+/*! @brief Reclaim a cached frame using the CLOCK algorithm.
+    @return The reclaimed frame, no longer caching anything.
+*/
+static struct fs_page_cache_entry *
+page_cache_evict(struct fs_page_cache *pc)
+{
+    /* Two sweeps always find a victim, as the first sweep clears every reference bit, unless
+       every frame is pinned or private. */
+    for (uint32_t n = 0; n < pc->numEntries * 2; n++) {
+        struct fs_page_cache_entry *pe = &pc->entries[pc->clockHand];
+        pc->clockHand = (pc->clockHand + 1) % pc->numEntries;
+        if (!pe->file || pe->pinned || pe->privateCopy) {
+            continue;
+        }
+        if (pe->referenced) {
+            pe->referenced = false;
+            continue;
+        }
+        dvprintf("page_cache_evict: reclaiming frame 0x%x.\n", (uint32_t) pe->frame);
+        page_cache_drop(pc, pe);
+        return pe;
+    }
+    return NULL;
+}
+
+/*! @brief Get a frame not caching anything, reclaiming one if we have run out.
+    @return The free frame's entry, NULL if every frame is pinned or private.
+*/
+static struct fs_page_cache_entry *
+page_cache_alloc_entry(struct fs_page_cache *pc)
+{
+    vaddr_t frame = pager_alloc_frame(pc->frameBlock);
+    if (!frame) {
+        return page_cache_evict(pc);
+    }
+    struct fs_page_cache_entry *pe = page_cache_frame_entry(pc, frame);
+    assert(pe->frame == frame && !pe->file);
+    return pe;
+}
+
+/*! @brief Fill a frame with the page of file content starting at the given file offset. */
+static void
+page_cache_fill(struct fs_page_cache_entry *pe, struct fs_file *file, int64_t offset)
+{
+    memset((void*) pe->frame, 0, REFOS_PAGE_SIZE);
+    if (!file->data) {
+        return;
+    }
+    int64_t start = MAX(offset, 0);
+    int64_t end = MIN(offset + REFOS_PAGE_SIZE, (int64_t) file->size);
+    if (start < end) {
+        memcpy((void*) (pe->frame + (start - offset)), file->data + start, end - start);
+    }
+}
+
+void
+page_cache_init(struct fs_page_cache *pc, struct fs_frame_block *fb)
+{
+    assert(pc && fb && fb->initialised);
+    memset(pc, 0, sizeof(struct fs_page_cache));
+    pc->frameBlock = fb;
+
+    pc->numEntries = fb->frameBlockNumPages;
+    pc->maxPrivate = pc->numEntries * CONFIG_REFOS_FILESERV_PAGE_CACHE_PRIVATE_PERCENT / 100;
+    pc->entries = malloc(sizeof(struct fs_page_cache_entry) * pc->numEntries);
+    pc->hashSize = 1;
+    while (pc->hashSize < pc->numEntries) {
+        pc->hashSize <<= 1;
+    }
+    pc->buckets = malloc(sizeof(struct fs_page_cache_entry*) * pc->hashSize);
+    if (!pc->entries || !pc->buckets) {
+        ROS_ERROR("page_cache_init out of memory.");
+        assert(!"page_cache_init out of memory.");
+        free(pc->entries);
+        free(pc->buckets);
+        return;
+    }
+    memset(pc->buckets, 0, sizeof(struct fs_page_cache_entry*) * pc->hashSize);
+    for (uint32_t i = 0; i < pc->numEntries; i++) {
+        struct fs_page_cache_entry *pe = &pc->entries[i];
+        memset(pe, 0, sizeof(struct fs_page_cache_entry));
+        pe->magic = FS_PAGE_CACHE_MAGIC;
+        pe->frame = fb->frameBlockVAddr + i * REFOS_PAGE_SIZE;
+        cvector_init(&pe->mappings);
+    }
+
+    pc->initialised = true;
+}
+
+void
+page_cache_release(struct fs_page_cache *pc)
+{
+    if (!pc || !pc->initialised) {
+        return;
+    }
+    for (uint32_t i = 0; i < pc->numEntries; i++) {
+        struct fs_page_cache_entry *pe = &pc->entries[i];
+        if (pe->file) {
+            page_cache_drop(pc, pe);
+            pager_free_frame(pc->frameBlock, pe->frame);
+        }
+        cvector_free(&pe->mappings);
+        pe->magic = 0;
+    }
+    free(pc->entries);
+    free(pc->buckets);
+    memset(pc, 0, sizeof(struct fs_page_cache));
+}
+
+struct fs_page_cache_entry *
+page_cache_get(struct fs_page_cache *pc, struct fs_file *file, int64_t offset)
+{
+    assert(pc && pc->initialised);
+    assert(file && file->magic == FS_FILE_MAGIC);
+
+    /* Look for the page in the cache. */
+    uint32_t bucket = page_cache_hash(pc, file, page_cache_file_page(offset));
+    for (struct fs_page_cache_entry *pe = pc->buckets[bucket]; pe; pe = pe->next) {
+        assert(pe->magic == FS_PAGE_CACHE_MAGIC);
+        if (pe->file == file && pe->offset == offset) {
+            pe->referenced = true;
+            pe->pinned = true;
+            return pe;
+        }
+    }
+
+    /* Not cached, so find a frame for it, reclaiming one if we have run out. */
+    struct fs_page_cache_entry *pe = page_cache_alloc_entry(pc);
+    if (!pe) {
+        return NULL;
+    }
+
+    /* Fill in the frame and add it to the cache. */
+    page_cache_fill(pe, file, offset);
+    pe->file = file;
+    pe->offset = offset;
+    pe->referenced = true;
+    pe->pinned = true;
+    pe->next = pc->buckets[bucket];
+    pc->buckets[bucket] = pe;
+    return pe;
+}
+
+struct fs_page_cache_entry *
+page_cache_get_private(struct fs_page_cache *pc, struct fs_file *file, int64_t offset)
+{
+    assert(pc && pc->initialised);
+    assert(file && file->magic == FS_FILE_MAGIC);
+
+    if (pc->numPrivate >= pc->maxPrivate) {
+        ROS_WARNING("page_cache_get_private: private frames have used up their share.");
+        return NULL;
+    }
+    struct fs_page_cache_entry *pe = page_cache_alloc_entry(pc);
+    if (!pe) {
+        return NULL;
+    }
+    page_cache_fill(pe, file, offset);
+    pe->file = file;
+    pe->offset = offset;
+    pe->pinned = true;
+    pe->privateCopy = true;
+    pc->numPrivate++;
+    return pe;
+}
+
+void
+page_cache_unpin(struct fs_page_cache *pc, struct fs_page_cache_entry *pe)
+{
+    assert(pc && pc->initialised);
+    assert(pe && pe->magic == FS_PAGE_CACHE_MAGIC);
+    if (!pe->privateCopy) {
+        pe->pinned = false;
+        return;
+    }
+    if (cvector_count(&pe->mappings) == 0) {
+        /* Private frame which never got mapped into its window. */
+        page_cache_drop(pc, pe);
+        pager_free_frame(pc->frameBlock, pe->frame);
+    }
+}
+
+int
+page_cache_map_run(struct fs_page_cache *pc, vaddr_t frame, uint32_t nFrames, int winID,
+                   seL4_CPtr windowCap, uint32_t windowOffset)
+{
+    assert(pc && pc->initialised);
+    assert(nFrames > 0);
+
+    /* Record the mappings first, since we can't unmap the frames on eviction without them. */
+    bool privateCopy = page_cache_frame_entry(pc, frame)->privateCopy;
+    uint32_t i;
+    for (i = 0; i < nFrames; i++) {
+        struct fs_page_cache_entry *pe = page_cache_frame_entry(pc, frame + i * REFOS_PAGE_SIZE);
+        assert(pe->magic == FS_PAGE_CACHE_MAGIC && pe->file);
+        assert(pe->privateCopy == privateCopy);
+        struct fs_page_cache_mapping *m = malloc(sizeof(struct fs_page_cache_mapping));
+        if (!m) {
+            break;
+        }
+        m->winID = winID;
+        m->windowCap = windowCap;
+        m->windowOffset = windowOffset + i * REFOS_PAGE_SIZE;
+        if (cvector_add(&pe->mappings, (cvector_item_t) m) < 0) {
+            free(m);
+            break;
+        }
+    }
+    if (i < nFrames) {
+        ROS_ERROR("page_cache_map_run out of memory.");
+        while (i-- > 0) {
+            struct fs_page_cache_entry *pe = page_cache_frame_entry(pc,
+                    frame + i * REFOS_PAGE_SIZE);
+            int last = cvector_count(&pe->mappings) - 1;
+            free(cvector_get(&pe->mappings, last));
+            cvector_delete(&pe->mappings, last);
+        }
+        return ENOMEM;
+    }
+
+    /* Map shared frames read-only, since they are shared with every other window on these
+       pages. If this fails part way through, or the process server ends the run early at a page
+       the client already has mapped, the records of frames which did not get mapped are left
+       behind; unmapping them on eviction is harmless, the client at most faults once more.
+       Private frames left unmapped are given back along with their window. */
+    return proc_window_map_range(windowCap, windowOffset, (seL4_Word) frame, nFrames,
+                                 privateCopy ? PROC_WINDOW_PERMISSION_READWRITE :
+                                               PROC_WINDOW_PERMISSION_READ);
+}
+
+void
+page_cache_invalidate(struct fs_page_cache *pc, struct fs_file *file, size_t offset,
+                      size_t count)
+{
+    assert(pc && pc->initialised);
+    if (!count) {
+        return;
+    }
+    int64_t start = (int64_t) offset;
+    int64_t end = start + (int64_t) count;
+
+    /* A frame starting in the file page before the range may still overlap it. */
+    int64_t firstPage = page_cache_file_page(start) - 1;
+    int64_t lastPage = page_cache_file_page(end - 1);
+    if (lastPage - firstPage >= (int64_t) pc->numEntries) {
+        /* Huge range, eg. truncating a large file; cheaper to just check every frame. */
+        for (uint32_t i = 0; i < pc->numEntries; i++) {
+            struct fs_page_cache_entry *pe = &pc->entries[i];
+            if (pe->file != file || pe->privateCopy || pe->offset >= end ||
+                    pe->offset + REFOS_PAGE_SIZE <= start) {
+                continue;
+            }
+            page_cache_drop(pc, pe);
+            pager_free_frame(pc->frameBlock, pe->frame);
+        }
+        return;
+    }
+
+    for (int64_t page = firstPage; page <= lastPage; page++) {
+        struct fs_page_cache_entry *pe = pc->buckets[page_cache_hash(pc, file, page)];
+        while (pe) {
+            struct fs_page_cache_entry *next = pe->next;
+            if (pe->file == file && pe->offset < end && pe->offset + REFOS_PAGE_SIZE > start) {
+                page_cache_drop(pc, pe);
+                pager_free_frame(pc->frameBlock, pe->frame);
+            }
+            pe = next;
+        }
+    }
+}
+
+void
+page_cache_unmap_window(struct fs_page_cache *pc, int winID)
+{
+    if (!pc->initialised) {
+        return;
+    }
+    for (uint32_t i = 0; i < pc->numEntries; i++) {
+        struct fs_page_cache_entry *pe = &pc->entries[i];
+        if (!pe->file) {
+            continue;
+        }
+        for (int j = cvector_count(&pe->mappings) - 1; j >= 0; j--) {
+            struct fs_page_cache_mapping *m = (struct fs_page_cache_mapping *)
+                    cvector_get(&pe->mappings, j);
+            if (m->winID != winID) {
+                continue;
+            }
+            proc_window_unmap(m->windowCap, m->windowOffset);
+            cvector_delete(&pe->mappings, j);
+            free(m);
+        }
+        if (pe->privateCopy && cvector_count(&pe->mappings) == 0) {
+            /* Nobody else can ever map a private frame, so give it back. */
+            page_cache_drop(pc, pe);
+            pager_free_frame(pc->frameBlock, pe->frame);
+        }
+    }
+}
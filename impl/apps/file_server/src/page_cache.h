@@ -0,0 +1,154 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief File server page cache module.
+
+    Every frame the file server pages clients with belongs to the page cache. A cached frame holds
+    one page worth of a file's content, keyed by the file and the file offset the frame starts at,
+    and is mapped read-only into every read-only client window that faults on that same page, so
+    processes mapping the same file share one frame per page. When the pager frame block runs out
+    of frames, a frame is reclaimed using the CLOCK algorithm: it is unmapped from every window it
+    is mapped into, and reused. Clients touching an evicted page simply fault again.
+
+    Writable client windows are instead given a private copy of the page, mapped read-write. A
+    private frame may hold the only copy of what the client wrote to it, so it is never evicted,
+    and is only given back when its window goes away. Private frames are capped to
+    CONFIG_REFOS_FILESERV_PAGE_CACHE_PRIVATE_PERCENT of the frames, so they can not starve the
+    shared frames.
+*/
+
+#ifndef _FILE_SERVER_PAGE_CACHE_H_
+#define _FILE_SERVER_PAGE_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <refos/refos.h>
+#include <sel4/sel4.h>
+#include <data_struct/cvector.h>
+#include "file_index.h"
+#include "pager.h"
+
+#define FS_PAGE_CACHE_MAGIC 0x9ACEC4C8
+
+#ifndef CONFIG_REFOS_FILESERV_PAGE_CACHE_PRIVATE_PERCENT
+    #define CONFIG_REFOS_FILESERV_PAGE_CACHE_PRIVATE_PERCENT 50
+#endif
+
+/*! @brief A client window mapping of a cached frame. */
+struct fs_page_cache_mapping {
+    int winID;
+    seL4_CPtr windowCap; /* No ownership, owned by the window association. */
+    uint32_t windowOffset;
+};
+
+/*! @brief A cached frame of file content. */
+struct fs_page_cache_entry {
+    uint32_t magic;
+    struct fs_file *file; /* NULL if this frame is not caching anything. */
+    int64_t offset; /* File offset of the start of the frame, may be negative. */
+    vaddr_t frame;
+    bool referenced; /* CLOCK reference bit. */
+    bool pinned; /* Being mapped into a client, must not be evicted. */
+    bool privateCopy; /* Private copy for a single writable window, not in the hash table. */
+
+    cvector_t mappings; /* struct fs_page_cache_mapping */
+    struct fs_page_cache_entry *next; /* Next entry in the same hash bucket. */
+};
+
+/*! @brief File server page cache. */
+struct fs_page_cache {
+    bool initialised;
+    struct fs_frame_block *frameBlock; /* No ownership. */
+
+    struct fs_page_cache_entry *entries; /* One per frame block page. */
+    uint32_t numEntries;
+    struct fs_page_cache_entry **buckets;
+    uint32_t hashSize;
+    uint32_t clockHand;
+
+    uint32_t numPrivate; /* Number of frames holding private copies. */
+    uint32_t maxPrivate;
+};
+
+/*! @brief Initialise the page cache over the given pager frame block.
+    @param pc The page cache to initialise.
+    @param fb The pager frame block to cache pages in. (No ownership passed)
+*/
+void page_cache_init(struct fs_page_cache *pc, struct fs_frame_block *fb);
+
+/*! @brief De-initialise the page cache, unmapping and freeing every cached frame.
+    @param pc The page cache to release. (No ownership passed, does NOT release the structure)
+*/
+void page_cache_release(struct fs_page_cache *pc);
+
+/*! @brief Get the cached frame holding the page of a file starting at the given offset, filling
+           a new frame with the file content if it is not cached. Bytes of the frame outside the
+           file read as zeros. May evict another cached frame. The returned entry is pinned, so
+           that getting more pages can not evict it before it has been mapped; it must be
+           unpinned with page_cache_unpin() afterwards.
+    @param pc The page cache.
+    @param file The file to get the page of.
+    @param offset The file offset the frame should start at. This may be negative, or not page
+                  aligned, when the client window is not aligned to the file.
+    @return The cache entry holding the page (No ownership), NULL if there are no frames.
+*/
+struct fs_page_cache_entry *page_cache_get(struct fs_page_cache *pc, struct fs_file *file,
+                                           int64_t offset);
+
+/*! @brief Get a new private frame holding a copy of the page of a file starting at the given
+           offset, for mapping into a single writable client window. The frame is not shared
+           with anyone else, and stays pinned until its window is unmapped with
+           page_cache_unmap_window(). May evict a shared cached frame.
+    @param pc The page cache.
+    @param file The file to copy the page of.
+    @param offset The file offset the frame should start at, as in page_cache_get().
+    @return The private entry holding the page (No ownership), NULL if there are no frames or
+            private frames are already using up their share of the frames.
+*/
+struct fs_page_cache_entry *page_cache_get_private(struct fs_page_cache *pc,
+                                                   struct fs_file *file, int64_t offset);
+
+/*! @brief Unpin a cache entry returned by page_cache_get(), allowing it to be evicted again.
+           Private entries returned by page_cache_get_private() stay pinned, unless they were
+           never mapped, in which case their frame is given back.
+    @param pc The page cache.
+    @param pe The cache entry to unpin.
+*/
+void page_cache_unpin(struct fs_page_cache *pc, struct fs_page_cache_entry *pe);
+
+/*! @brief Map a run of cached frames, contiguous in the frame block, into contiguous pages of a
+           client window, resolving the client's fault if it is on one of the pages. Shared
+           frames are mapped read-only, private frames read-write.
+    @param pc The page cache.
+    @param frame The first cached frame to map.
+    @param nFrames The number of cached frames to map.
+    @param winID The ID of the window to map into.
+    @param windowCap The cap of the window to map into. (No ownership passed)
+    @param windowOffset The offset into the window to map the first frame at.
+    @return ESUCCESS on success, refos_err_t otherwise.
+*/
+int page_cache_map_run(struct fs_page_cache *pc, vaddr_t frame, uint32_t nFrames, int winID,
+                       seL4_CPtr windowCap, uint32_t windowOffset);
+
+/*! @brief Drop any cached frames holding the given range of a file, unmapping them from clients.
+           Must be called whenever file content changes.
+    @param pc The page cache.
+    @param file The file which has changed.
+    @param offset The start of the changed range.
+    @param count The length of the changed range in bytes.
+*/
+void page_cache_invalidate(struct fs_page_cache *pc, struct fs_file *file, size_t offset,
+                           size_t count);
+
+/*! @brief Unmap every cached frame from the given window, and forget about the window, freeing
+           its private frames. Must be called before the window cap is released.
+    @param pc The page cache.
+    @param winID The ID of the window.
+*/
+void page_cache_unmap_window(struct fs_page_cache *pc, int winID);
+
+#endif /* _FILE_SERVER_PAGE_CACHE_H_ */
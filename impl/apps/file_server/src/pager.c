@@ -55,9 +55,12 @@ pager_init(struct fs_frame_block* fb, uint32_t framesSize)
         return;
     }
 
-    /* Allocate the window to map things into. */
+    /* Allocate the window to map things into. The frames are mapped on into client windows one
+       page at a time, so they must not be backed by large frames. */
     dprintf("        Allocating frame block window...\n");
-    fb->frameBlockVAddr = walloc(fb->frameBlockNumPages, &fb->window);
+    fb->frameBlockVAddr = walloc_ext(fb->frameBlockNumPages, &fb->window,
+                                     PROC_WINDOW_PERMISSION_READWRITE,
+                                     PROC_WINDOW_FLAGS_NO_LARGE_PAGES);
     if (!fb->frameBlockVAddr || !fb->window) {
         ROS_ERROR("page_init failed to allocate window.");
         assert(!"page_init failed to allocate window.");
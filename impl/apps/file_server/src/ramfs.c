@@ -0,0 +1,202 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief File server RAMFS page pool module.
+
+    The invariant kept here is that any bytes of a file's extent past its size are zero. New pages
+    may have been used by another file before, so they are cleared when they are reserved, and the
+    tail of the last page is cleared when a file shrinks. Files may then simply grow over their
+    spare extent without any clearing on the write path.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <utils/arith.h>
+
+#include <refos/refos.h>
+#include <refos-rpc/proc_client.h>
+#include <refos-rpc/proc_client_helper.h>
+#include <refos-rpc/data_client.h>
+#include <refos-rpc/data_client_helper.h>
+#include <refos-util/cspace.h>
+#include <refos-util/walloc.h>
+
+#include "ramfs.h"
+#include "state.h"
+
+void
+ramfs_init(struct fs_ramfs *rfs, uint32_t poolSize)
+{
+    assert(rfs);
+    memset(rfs, 0, sizeof(struct fs_ramfs));
+
+    /* Initialise the page pool allocator. */
+    assert(poolSize % REFOS_PAGE_SIZE == 0);
+    rfs->poolNumPages = poolSize / REFOS_PAGE_SIZE;
+    cbpool_init(&rfs->pagePool, rfs->poolNumPages);
+
+    /* Initialise the anonymous RAM dataspace backing the pool. Its frames are only allocated by
+       the process server when we first touch them. */
+    dprintf("        Creating RAMFS page pool...\n");
+    int error = EINVALID;
+    rfs->dataspace = data_open(REFOS_PROCSERV_EP, "anon", O_CREAT | O_WRONLY | O_TRUNC, O_RDWR,
+                               poolSize, &error);
+    if (error != ESUCCESS || !rfs->dataspace) {
+        ROS_ERROR("ramfs_init failed to open anon dataspace.");
+        assert(!"ramfs_init failed to open anon dataspace.");
+        return;
+    }
+
+    /* Allocate the window to map the pool into. */
+    rfs->poolVAddr = walloc(rfs->poolNumPages, &rfs->window);
+    if (!rfs->poolVAddr || !rfs->window) {
+        ROS_ERROR("ramfs_init failed to allocate window.");
+        assert(!"ramfs_init failed to allocate window.");
+        return;
+    }
+    dprintf("        Allocated RAMFS page pool window 0x%x --> 0x%x...\n",
+            rfs->poolVAddr, rfs->poolVAddr + poolSize);
+
+    /* Map the dataspace into the window. */
+    error = data_datamap(REFOS_PROCSERV_EP, rfs->dataspace, rfs->window, 0);
+    if (error != ESUCCESS) {
+        ROS_ERROR("ramfs_init failed to datamap dataspace to window.");
+        assert(!"ramfs_init failed to datamap dataspace to window.");
+        return;
+    }
+
+    rfs->initialised = true;
+}
+
+void
+ramfs_release(struct fs_ramfs *rfs)
+{
+    rfs->initialised = false;
+
+    /* Destroy the dataspace and memory window. */
+    data_close(REFOS_PROCSERV_EP, rfs->dataspace);
+    seL4_CNode_Delete(REFOS_CSPACE, rfs->dataspace, seL4_WordBits);
+    proc_delete_mem_window(rfs->window);
+    csfree(rfs->dataspace);
+    csfree(rfs->window);
+
+    /* Release the allocator pool. */
+    rfs->poolVAddr = 0;
+    rfs->poolNumPages = 0;
+    cbpool_release(&rfs->pagePool);
+}
+
+/*! @brief Get the pool page index of the start of a file's extent. */
+static inline uint32_t
+ramfs_extent_start(struct fs_ramfs *rfs, struct fs_file *f)
+{
+    assert(f->data && (vaddr_t) f->data >= rfs->poolVAddr);
+    return ((vaddr_t) f->data - rfs->poolVAddr) / REFOS_PAGE_SIZE;
+}
+
+/*! @brief Grow a file's extent to at least the given number of pages.
+    @return ESUCCESS on success, ENOMEM if the page pool has no room.
+*/
+static int
+ramfs_file_grow(struct fs_ramfs *rfs, struct fs_file *f, uint32_t npages)
+{
+    assert(npages > f->npages);
+
+    /* Try to grow the extent in place, if the pages right after it are free. */
+    if (f->npages) {
+        uint32_t start = ramfs_extent_start(rfs, f);
+        uint32_t i = start + f->npages;
+        while (i < start + npages && i < rfs->poolNumPages &&
+                !cbpool_check_single(&rfs->pagePool, i)) {
+            i++;
+        }
+        if (i == start + npages) {
+            for (i = start + f->npages; i < start + npages; i++) {
+                cbpool_set_single(&rfs->pagePool, i, true);
+            }
+            memset(f->data + f->npages * REFOS_PAGE_SIZE, 0,
+                   (npages - f->npages) * REFOS_PAGE_SIZE);
+            f->npages = npages;
+            return ESUCCESS;
+        }
+    }
+
+    /* Otherwise move the file into a new extent, twice the size of the old one so that a file
+       being appended to is only moved a logarithmic number of times. */
+    uint32_t newNPages = MAX(npages, f->npages * 2);
+    uint32_t newStart = cbpool_alloc(&rfs->pagePool, newNPages);
+    if (newStart == CBPOOL_INVALID && newNPages > npages) {
+        newNPages = npages;
+        newStart = cbpool_alloc(&rfs->pagePool, newNPages);
+    }
+    if (newStart == CBPOOL_INVALID) {
+        ROS_WARNING("RAMFS page pool out of room for %u pages.", npages);
+        return ENOMEM;
+    }
+
+    char *newData = (char*) (rfs->poolVAddr + newStart * REFOS_PAGE_SIZE);
+    if (f->npages) {
+        memcpy(newData, f->data, f->size);
+        cbpool_free(&rfs->pagePool, ramfs_extent_start(rfs, f), f->npages);
+    }
+    memset(newData + f->size, 0, newNPages * REFOS_PAGE_SIZE - f->size);
+    f->data = newData;
+    f->npages = newNPages;
+    return ESUCCESS;
+}
+
+int
+ramfs_file_resize(struct fs_ramfs *rfs, struct fs_file *f, size_t size)
+{
+    assert(rfs && rfs->initialised);
+    assert(f && f->magic == FS_FILE_MAGIC && f->ramfs);
+    uint32_t npages = refos_round_up_npages(size);
+
+    if (npages > f->npages) {
+        int error = ramfs_file_grow(rfs, f, npages);
+        if (error != ESUCCESS) {
+            return error;
+        }
+    } else if (size < f->size) {
+        /* Drop any cached pages of the cut off content. */
+        page_cache_invalidate(&fileServ.pageCache, f, size, f->size - size);
+
+        /* Give back the pages past the new end, and clear the rest of the last page. */
+        if (npages < f->npages) {
+            cbpool_free(&rfs->pagePool, ramfs_extent_start(rfs, f) + npages, f->npages - npages);
+            f->npages = npages;
+        }
+        if (npages) {
+            memset(f->data + size, 0, MIN(f->size, npages * REFOS_PAGE_SIZE) - size);
+        } else {
+            f->data = NULL;
+        }
+    }
+
+    f->size = size;
+    return ESUCCESS;
+}
+
+void
+ramfs_file_unlink(struct fs_ramfs *rfs, struct fs_file_index *fi, struct fs_file *f)
+{
+    assert(f && f->magic == FS_FILE_MAGIC && f->ramfs && !f->unlinked);
+    file_index_remove(fi, f);
+    f->unlinked = true;
+    if (!f->ref) {
+        ramfs_file_delete(rfs, f);
+    }
+}
+
+void
+ramfs_file_delete(struct fs_ramfs *rfs, struct fs_file *f)
+{
+    assert(f && f->magic == FS_FILE_MAGIC && f->ramfs && f->unlinked && !f->ref);
+    ramfs_file_resize(rfs, f, 0);
+    file_index_free_ramfs(f);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief File server RAMFS page pool module.
+
+    Writable files created at run time live in a big anonymous RAM dataspace mapped into the file
+    server, which the process server pages in on demand. Each RAMFS file owns a contiguous run of
+    pool pages (an extent), so reads, writes and client page faults work on a flat buffer exactly
+    like CPIO files do. Extents grow in place when the following pages are free, and otherwise
+    move to a run twice as big; truncating or unlinking a file gives its pages back to the pool.
+*/
+
+#ifndef _FILE_SERVER_RAMFS_H_
+#define _FILE_SERVER_RAMFS_H_
+
+#include <refos/refos.h>
+#include <sel4/sel4.h>
+#include <data_struct/cbpool.h>
+#include "file_index.h"
+#include "pager.h"
+
+/*! @brief File server RAMFS page pool. */
+struct fs_ramfs {
+    bool initialised;
+    cbpool_t pagePool;
+    seL4_CPtr dataspace;
+    seL4_CPtr window;
+    vaddr_t poolVAddr;
+    uint32_t poolNumPages;
+};
+
+/*! @brief Initialise the RAMFS page pool.
+    @param rfs The RAMFS page pool to initialise.
+    @param poolSize The size of the page pool in bytes. This number must be a multiple of
+                    PAGE_SIZE (4k).
+*/
+void ramfs_init(struct fs_ramfs *rfs, uint32_t poolSize);
+
+/*! @brief De-initialise the RAMFS page pool, and release its dataspace and window.
+    @param rfs The RAMFS page pool to release. (No ownership passed)
+*/
+void ramfs_release(struct fs_ramfs *rfs);
+
+/*! @brief Resize a RAMFS file. Growing the file reserves pages for it, which may move its data;
+           the new part of the file reads as zeros. Shrinking the file gives back its pages past
+           the new end.
+    @param rfs The RAMFS page pool.
+    @param f The RAMFS file to resize. (No ownership passed)
+    @param size The new size of the file in bytes.
+    @return ESUCCESS on success, ENOMEM if the page pool has no room.
+*/
+int ramfs_file_resize(struct fs_ramfs *rfs, struct fs_file *f, size_t size);
+
+/*! @brief Unlink a RAMFS file. The file is removed from the index straight away, and deleted once
+           it is no longer open.
+    @param rfs The RAMFS page pool.
+    @param fi The path index the file is in.
+    @param f The RAMFS file to unlink. (Takes ownership)
+*/
+void ramfs_file_unlink(struct fs_ramfs *rfs, struct fs_file_index *fi, struct fs_file *f);
+
+/*! @brief Delete an unlinked RAMFS file that is no longer open, giving back its pages.
+    @param rfs The RAMFS page pool.
+    @param f The RAMFS file to delete. (Takes ownership)
+*/
+void ramfs_file_delete(struct fs_ramfs *rfs, struct fs_file *f);
+
+#endif /* _FILE_SERVER_RAMFS_H_ */
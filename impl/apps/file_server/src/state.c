@@ -17,7 +17,10 @@
 #include "badge.h"
 #include "state.h"
 #include "dataspace.h"
+#include "file_index.h"
 #include "pager.h"
+#include "page_cache.h"
+#include "ramfs.h"
 
  /*! @file
      @brief CPIO Fileserver global state & helper functions. */
@@ -39,7 +42,7 @@ fileserv_init(void) {
         .clientBadgeBase = FS_CLIENT_BADGE_BASE,
         .clientMagic = FS_CLIENT_MAGIC,
         .notificationBufferSize = FILESERVER_NOTIFICATION_BUFFER_SIZE,
-        .paramBufferSize = SRV_DEFAULT_PARAM_BUFFER_SIZE, 
+        .paramBufferSize = FILESERVER_PARAM_BUFFER_SIZE,
         .serverName = "fileserver",
         .mountPointPath = FILESERVER_MOUNTPOINT,
         .nameServEP = REFOS_NAMESERV_EP,
@@ -54,6 +57,26 @@ fileserv_init(void) {
     dprintf("    initialising pager frame block...\n");
     pager_init(&s->pageFrameBlock, FILESERVER_MAX_PAGE_FRAMES * REFOS_PAGE_SIZE);
 
+    dprintf("    initialising page cache...\n");
+    page_cache_init(&s->pageCache, &s->pageFrameBlock);
+
     dprintf("    initialising dataspace allocation table...\n");
     dspace_table_init(&s->dspaceTable);
+
+    dprintf("    initialising RAMFS page pool...\n");
+    ramfs_init(&s->ramfs, FILESERVER_RAMFS_POOL_SIZE);
+
+    dprintf("    indexing CPIO archive...\n");
+    int error = file_index_init(&s->fileIndex, _cpio_archive);
+    if (error != ESUCCESS) {
+        ROS_ERROR("Failed to index CPIO archive.");
+        assert(!"Failed to index CPIO archive.");
+        return;
+    }
+    if (s->fileIndex.indexCycles) {
+        dprintf("    indexed %u files in %llu cycles.\n", s->fileIndex.count,
+                (unsigned long long) s->fileIndex.indexCycles);
+    } else {
+        dprintf("    indexed %u files in n/a cycles (no cycle counter).\n", s->fileIndex.count);
+    }
 }
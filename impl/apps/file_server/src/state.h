@@ -24,7 +24,10 @@
 #include <refos-util/serv_common.h>
 
 #include "dataspace.h"
+#include "file_index.h"
 #include "pager.h"
+#include "page_cache.h"
+#include "ramfs.h"
 
  /*! @file
      @brief CPIO Fileserver global state & helper functions. */
@@ -33,7 +36,9 @@
 #include <refos-util/dprintf.h>
 
 #define FILESERVER_MAX_PAGE_FRAMES 128
+#define FILESERVER_RAMFS_POOL_SIZE 0x1000000 /* 16MB of RAMFS file space, paged in on demand. */
 #define FILESERVER_NOTIFICATION_BUFFER_SIZE 0x2000 /* 2 Frames. */
+#define FILESERVER_PARAM_BUFFER_SIZE 0x8000 /* 8 Frames, enough for a batched content-init. */
 #define FILESERVER_MOUNTPOINT "fileserv"
 #define FS_CLIENT_MAGIC 0x3FA3EF6E
 
@@ -43,7 +48,10 @@ struct fs_state {
 
     /* Main file server data structures. */
     struct fs_frame_block pageFrameBlock;
+    struct fs_page_cache pageCache;
     struct fs_dataspace_table dspaceTable;
+    struct fs_file_index fileIndex;
+    struct fs_ramfs ramfs;
 };
 
 /*! @brief Global CPIO file server state. */
@@ -37,4 +37,9 @@
 #define RAM_DATASPACE_BADGE_BASE W_BADGE_END
 #define RAM_DATASPACE_BADGE_END (RAM_DATASPACE_BADGE_BASE + RAM_DATASPACE_MAX_NUM_DATASPACE)
 
+/* ---- BadgeID 20483 to 28674 : Read-only RAM Dataspace Objects ---- */
+
+#define RAM_DATASPACE_RO_BADGE_BASE RAM_DATASPACE_BADGE_END
+#define RAM_DATASPACE_RO_BADGE_END (RAM_DATASPACE_RO_BADGE_BASE + RAM_DATASPACE_MAX_NUM_DATASPACE)
+
 #endif /* _REFOS_PROCESS_SERVER_BADGE_H_ */
@@ -23,8 +23,8 @@
 */
 
 seL4_CPtr
-data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode , int rpc_size ,
-                  int* rpc_errno)
+data_open_internal_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
+                           int rpc_size , uint32_t* rpc_dspaceSize , int* rpc_errno)
 {
     struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
     assert(pcb && pcb->magic == REFOS_PCB_MAGIC);
@@ -68,6 +68,9 @@ data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_m
 
     SET_ERRNO_PTR(rpc_errno, ESUCCESS);
     assert(newDataspace->magic == RAM_DATASPACE_MAGIC);
+    if (rpc_dspaceSize) {
+        (*rpc_dspaceSize) = ram_dspace_get_size(newDataspace);
+    }
     return newDataspace->capability.capPtr;
 }
 
@@ -98,7 +101,7 @@ data_close_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd)
     w_purge_dspace(&procServ.windowList, dspace);
 
     /* Purge the dataspace from all notification buffers and ring buffers. */
-    pid_iterate(&procServ.PIDList, proc_dspace_delete_callback, (void*) dspace);
+    proc_purge_dspace(dspace);
 
     /* Check that this is the last reference to the dataspace. */
     if (dspace->ref != 1) {
@@ -111,6 +114,15 @@ data_close_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd)
     return ESUCCESS;
 }
 
+refos_err_t
+data_unlink_handler(void *rpc_userptr , char* rpc_name)
+{
+    /* Anonymous RAM dataspaces have no name to remove. */
+    (void) rpc_userptr;
+    (void) rpc_name;
+    return EUNIMPLEMENTED;
+}
+
 int
 data_getc_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , int rpc_block)
 {
@@ -203,12 +215,17 @@ data_datamap_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , seL4_CPtr rpc
         return EINVALIDWINDOW;
     }
 
-    /* Verify and find the RAM dataspace. */
-    if (!dispatcher_badge_dspace(rpc_dspace_fd)) {
+    /* Verify and find the RAM dataspace. Read-only dataspace caps may be datamapped too. */
+    struct ram_dspace *dspace = NULL;
+    bool readOnly = dispatcher_badge_dspace_read_only(rpc_dspace_fd);
+    if (readOnly) {
+        dspace = ram_dspace_get_badge_read_only(&procServ.dspaceList, rpc_dspace_fd);
+    } else if (dispatcher_badge_dspace(rpc_dspace_fd)) {
+        dspace = ram_dspace_get_badge(&procServ.dspaceList, rpc_dspace_fd);
+    } else {
         ROS_ERROR("EINVALIDPARAM: invalid RAM dataspace badge..\n");
         return EINVALIDPARAM;
     }
-    struct ram_dspace *dspace = ram_dspace_get_badge(&procServ.dspaceList, rpc_dspace_fd);
     if (!dspace) {
         ROS_ERROR("EINVALIDPARAM: dataspace not found.\n");
         return EINVALIDPARAM;
@@ -221,7 +238,7 @@ data_datamap_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , seL4_CPtr rpc
 
     /* Associate the dataspace with the window. This will release whatever the window was associated
        with beforehand. */
-    w_set_anon_dspace(window, dspace, rpc_offset);
+    w_set_anon_dspace(window, dspace, rpc_offset, readOnly);
     return ESUCCESS;
 }
 
@@ -256,7 +273,7 @@ data_dataunmap_handler(void *rpc_userptr , seL4_CPtr rpc_memoryWindow)
     }
 
     /* Reset the window back to empty. */
-    w_set_anon_dspace(window, NULL, 0);
+    w_set_anon_dspace(window, NULL, 0, false);
     return ESUCCESS;
 }
 
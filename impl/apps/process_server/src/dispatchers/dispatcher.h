@@ -79,6 +79,17 @@ dispatcher_badge_dspace(seL4_Word badge)
     return (badge >= RAM_DATASPACE_BADGE_BASE && badge < RAM_DATASPACE_BADGE_END);
 }
 
+/*! @brief Checks whether a given badge is a read-only ram dataspace. A read-only dataspace cap
+           may only be datamapped, and the window it is datamapped into is mapped read-only.
+    @param badge The badge to check.
+    @return true if the given badge is a valid read-only ram dataspace ID, false otherwise.
+ */
+static inline bool
+dispatcher_badge_dspace_read_only(seL4_Word badge)
+{
+    return (badge >= RAM_DATASPACE_RO_BADGE_BASE && badge < RAM_DATASPACE_RO_BADGE_END);
+}
+
 /*! @brief Checks whether a given badge is a window.
     @param badge The badge to check.
     @return true if the given badge is a valid windowID, false otherwise.
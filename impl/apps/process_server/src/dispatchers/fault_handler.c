@@ -24,6 +24,14 @@
 /*! @file
     @brief Process server fault dispatcher which handles VM faults. */
 
+#ifndef CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES
+    #define CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES 16
+#endif
+
+#ifndef CONFIG_PROCSERV_CONTENT_INIT_BATCH_PAGES
+    #define CONFIG_PROCSERV_CONTENT_INIT_BATCH_PAGES 8
+#endif
+
 /*! @brief Temporary internal VM fault message info struct. */
 struct procserv_vmfault_msg {
     /*! The faulting program's process control block. */
@@ -88,6 +96,7 @@ fault_delegate_notification(struct procserv_vmfault_msg *f, struct proc_pcb *del
             output_segmentation_fault("Failed to save caller reply cap.", f);
             return;
         }
+        f->pcb->faultAddr = f->faultAddr;
     }
 
     /* Append notification to pager's notification buffer. */
@@ -102,6 +111,131 @@ fault_delegate_notification(struct procserv_vmfault_msg *f, struct proc_pcb *del
     dispatcher_notify(delegationEP.capPtr);
 }
 
+/*! @brief Helper function to work out how many pages to map around an anonymous memory fault.
+
+    A fault landing exactly at the end of the previous run of pages mapped in the same window is
+    treated as sequential access, and doubles the fault-around size, up to
+    CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES. Any other fault resets it back to a single page.
+
+    @param window The anonymous window which was faulted in.
+    @param windowOffset The page-aligned offset into the window of the faulting address.
+    @return Number of pages to attempt to map, starting from the faulting page.
+*/
+static int
+fault_around_npages(struct w_window *window, vaddr_t windowOffset)
+{
+    assert(window && window->magic == W_MAGIC);
+    uint32_t nPages = 1;
+    if (window->faultAroundNPages && windowOffset == window->faultAroundNextOffset) {
+        nPages = window->faultAroundNPages * 2;
+    }
+    if (nPages > CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES) {
+        nPages = CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES;
+    }
+    if (nPages < 1) {
+        nPages = 1;
+    }
+    window->faultAroundNPages = nPages;
+    return (int) nPages;
+}
+
+/*! @brief Helper function to collect the dataspace pages following a faulting page.
+
+    Fills in frames[1] onwards with the dataspace pages which directly follow the faulting page,
+    allocating them if needed. For read faults, untouched pages are filled in with the shared zero
+    frame instead (see ram_dspace_get_page_read()). Stops early at the end of the window or
+    dataspace, at a page which is already mapped, at a page which is backed by a large frame, or at
+    a page which still needs content initialisation. frames[0] is expected to already be filled in
+    with the faulting page.
+
+    @param f The VM fault message info struct.
+    @param aw Found associated window of the faulting address & client.
+    @param dspace The anonymous dataspace the window is mapped to.
+    @param dspaceOffset The offset into the dataspace of the faulting address.
+    @param frames Output frame array, of at least nPages in size.
+    @param nPages The maximum number of pages to collect, including the faulting page.
+    @return The number of valid frames in the frames array, including the faulting page.
+*/
+static int
+fault_around_collect(struct procserv_vmfault_msg *f, struct w_associated_window *aw,
+        struct ram_dspace *dspace, vaddr_t dspaceOffset, seL4_CPtr frames[], int nPages)
+{
+    assert(f && f->pcb && aw);
+    assert(dspace && dspace->magic == RAM_DATASPACE_MAGIC);
+    vaddr_t vaddr = REFOS_PAGE_ALIGN(f->faultAddr);
+    dspaceOffset = REFOS_PAGE_ALIGN(dspaceOffset);
+
+    int n = 1;
+    for (; n < nPages; n++) {
+        vaddr_t va = vaddr + n * REFOS_PAGE_SIZE;
+        vaddr_t offset = dspaceOffset + n * REFOS_PAGE_SIZE;
+        if (va >= aw->offset + aw->size || offset >= dspace->npages * REFOS_PAGE_SIZE) {
+            break;
+        }
+        if (dspace->contentInitEnabled && ram_dspace_need_content_init(dspace, offset) != false) {
+            break;
+        }
+        if (vs_get_frame(&f->pcb->vspace, va).capPtr != 0) {
+            break;
+        }
+        if (ram_dspace_check_large_page(dspace, offset)) {
+            /* Don't split up a large frame just to fault around. */
+            break;
+        }
+        frames[n] = f->read ? ram_dspace_get_page_read(dspace, offset) :
+                              ram_dspace_get_page(dspace, offset);
+        if (!frames[n]) {
+            break;
+        }
+    }
+    return n;
+}
+
+/*! @brief Helper function to map the whole large page around an anonymous memory fault using a
+           single large frame.
+
+    This only works if the large page around the faulting address lies entirely within the window,
+    the window is mapped at a large-page aligned offset into the dataspace, and none of the pages
+    under the large page have been mapped yet. Otherwise, the fault is left to be mapped using 4k
+    frames.
+
+    @param f The VM fault message info struct.
+    @param aw Found associated window of the faulting address & client.
+    @param window The window structure of the faulting address & client.
+    @param dspace The anonymous dataspace the window is mapped to.
+    @return TRUE if the large frame was mapped, FALSE otherwise.
+*/
+static bool
+fault_map_large(struct procserv_vmfault_msg *f, struct w_associated_window *aw,
+        struct w_window *window, struct ram_dspace *dspace)
+{
+    assert(f && f->pcb && aw && window);
+    assert(dspace && dspace->magic == RAM_DATASPACE_MAGIC);
+    vaddr_t vaddr = f->faultAddr & ~((vaddr_t) RAM_DATASPACE_LARGE_PAGE_SIZE - 1);
+    if (vaddr < aw->offset || vaddr - aw->offset + RAM_DATASPACE_LARGE_PAGE_SIZE > aw->size) {
+        return false;
+    }
+    vaddr_t dspaceOffset = (vaddr + window->ramDataspaceOffset) - REFOS_PAGE_ALIGN(aw->offset);
+    if (dspaceOffset % RAM_DATASPACE_LARGE_PAGE_SIZE) {
+        return false;
+    }
+    for (vaddr_t va = vaddr; va < vaddr + RAM_DATASPACE_LARGE_PAGE_SIZE; va += REFOS_PAGE_SIZE) {
+        if (vs_get_frame(&f->pcb->vspace, va).capPtr != 0) {
+            return false;
+        }
+    }
+
+    seL4_CPtr frame = ram_dspace_get_large_page(dspace, dspaceOffset);
+    if (!frame) {
+        return false;
+    }
+    if (vs_map_large(&f->pcb->vspace, vaddr, frame) != ESUCCESS) {
+        return false;
+    }
+    procServ.faultStats.largePageFaults++;
+    return true;
+}
+
 /* ----------------------------- Proc Server fault handler functions ---------------------------- */
 
 /*! @brief Handles faults on windows mapped to anonymous memory.
@@ -111,7 +245,20 @@ fault_delegate_notification(struct procserv_vmfault_msg *f, struct proc_pcb *del
 
     If the dataspace has been set to content-initialised, then we will need to delegate and save the
     reply cap to reply to it once the content has been initialised. If it has not been initialised
-    we simply map the dataspace page and reply.
+    we simply map the dataspace page and reply. When the window is being accessed sequentially, a
+    run of following pages is mapped along with the faulting page (see fault_around_npages()).
+
+    Reading an untouched anonymous page maps the shared zero frame read-only, instead of
+    allocating a frame for it. Writing to the page afterwards faults again (with the zero frame
+    still mapped), at which point the page gets a frame of its own which replaces the zero frame.
+
+    In windows flagged for large pages, the whole large page around a write fault is mapped using a
+    single large frame where possible (see fault_map_large()). A read fault only maps a large frame
+    the large page already has, and otherwise maps the zero frame as usual, so that reading a few
+    bytes here and there doesn't allocate and zero a whole large frame each time.
+
+    Windows datamapped using a read-only dataspace cap always have the pages mapped read-only, and
+    writing to them is a segmentation fault.
 
     @param m The recieved IPC fault message from the kernel.
     @param f The VM fault message info struct.
@@ -133,6 +280,34 @@ handle_vm_fault_dspace(struct procserv_msg *m, struct procserv_vmfault_msg *f,
 
     dvprintf("# PID %d VM fault ―――――▶ anon RAM dspace %d\n", f->pcb->pid, dspace->ID);
 
+    if (window->ramDataspaceReadOnly && !f->read) {
+        output_segmentation_fault("write to window datamapped with a read-only dataspace.", f);
+        return EACCESSDENIED;
+    }
+
+    if (vs_get_frame(&f->pcb->vspace, f->faultAddr).capPtr != 0) {
+        /* There is already a page mapped here, so this must be a write to the zero frame. */
+        if (f->read || !ram_dspace_is_zero_mapped(dspace, dspaceOffset)) {
+            output_segmentation_fault("entry already occupied; book-keeping error.", f);
+            return EINVALID;
+        }
+
+        /* Give the page its own frame. This unmaps the zero frame from every window it was
+           mapped into for this page, including the faulting one. */
+        seL4_CPtr frame = ram_dspace_get_page(dspace, dspaceOffset);
+        if (!frame) {
+            output_segmentation_fault("Out of memory to allocate page.", f);
+            return ENOMEM;
+        }
+        int error = vs_map(&f->pcb->vspace, f->faultAddr, &frame, 1);
+        if (error != ESUCCESS) {
+            output_segmentation_fault("Failed to map frame into client's vspace at faultAddr.", f);
+            return error;
+        }
+        procServ.faultStats.zeroFrameWriteFaults++;
+        return ESUCCESS;
+    }
+
     if (dspace->contentInitEnabled) {
         /* Data space is backed by external content. Content initialisation delegation. */
         int contentInitState =  ram_dspace_need_content_init(dspace, dspaceOffset);
@@ -167,12 +342,28 @@ handle_vm_fault_dspace(struct procserv_msg *m, struct procserv_vmfault_msg *f,
                 return EINVALID;
             }
 
+            /* Request the whole run of following pages which still need content, up to the end
+               of the window, so the content initialiser can provide them in a single call. */
+            vaddr_t runOffset = REFOS_PAGE_ALIGN(dspaceOffset);
+            vaddr_t runEnd = window->ramDataspaceOffset + aw->size;
+            uint32_t maxPages = CONFIG_PROCSERV_CONTENT_INIT_BATCH_PAGES;
+            if (runOffset + maxPages * REFOS_PAGE_SIZE > runEnd) {
+                maxPages = (runEnd - runOffset + REFOS_PAGE_SIZE - 1) / REFOS_PAGE_SIZE;
+            }
+            int nPages = ram_dspace_content_init_run(dspace, runOffset, maxPages);
+            if (nPages < 1) {
+                nPages = 1;
+            }
+
             /* Set up and send the fault notification. */
+            procServ.faultStats.contentInitFaults++;
+            procServ.faultStats.contentInitPages += nPages;
             struct proc_notification vmFaultNotification;
             vmFaultNotification.magic = PROCSERV_NOTIFICATION_MAGIC;
             vmFaultNotification.label = PROCSERV_NOTIFY_CONTENT_INIT;
             vmFaultNotification.arg[0] = dspace->ID;
-            vmFaultNotification.arg[1] = REFOS_PAGE_ALIGN(dspaceOffset);
+            vmFaultNotification.arg[1] = runOffset;
+            vmFaultNotification.arg[2] = nPages;
 
             fault_delegate_notification(f, cinitPCB, dspace->contentInitEP, vmFaultNotification,
                                         false);
@@ -184,20 +375,49 @@ handle_vm_fault_dspace(struct procserv_msg *m, struct procserv_vmfault_msg *f,
         /* Fallthrough to normal dspace mapping if content-init state is set to already provided. */
     }
 
+    /* Map a whole large frame if the window allows it. */
+    if (window->largePages && !window->ramDataspaceReadOnly && !dspace->physicalAddrEnabled &&
+            !dspace->contentInitEnabled &&
+            (!f->read || ram_dspace_check_large_page(dspace, dspaceOffset)) &&
+            fault_map_large(f, aw, window, dspace)) {
+        return ESUCCESS;
+    }
+
     /* Get the page at the dataspaceOffset into the dataspace. */
-    seL4_CPtr frame = ram_dspace_get_page(dspace, dspaceOffset);
-    if (!frame) {
+    seL4_CPtr frames[CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES > 1 ?
+                     CONFIG_PROCSERV_FAULT_AROUND_MAX_PAGES : 1];
+    frames[0] = f->read ? ram_dspace_get_page_read(dspace, dspaceOffset) :
+                          ram_dspace_get_page(dspace, dspaceOffset);
+    if (!frames[0]) {
         output_segmentation_fault("Out of memory to allocate page or read off end of dspace.", f);
         return ENOMEM;
     }
 
-    /* Map this frame into the client process's page directory. */
-    int error = vs_map(&f->pcb->vspace, f->faultAddr, &frame, 1);
+    /* Collect the following pages to map along with the faulting page. Device memory dataspaces
+       are left to be faulted in one page at a time. */
+    vaddr_t windowOffset = REFOS_PAGE_ALIGN(f->faultAddr) - REFOS_PAGE_ALIGN(aw->offset);
+    int nFrames = 1;
+    if (!dspace->physicalAddrEnabled) {
+        nFrames = fault_around_collect(f, aw, dspace, dspaceOffset, frames,
+                                       fault_around_npages(window, windowOffset));
+    }
+
+    /* Map these frames into the client process's page directory. */
+    int error = window->ramDataspaceReadOnly ?
+                vs_map_read_only(&f->pcb->vspace, f->faultAddr, frames, nFrames) :
+                vs_map(&f->pcb->vspace, f->faultAddr, frames, nFrames);
     if (error != ESUCCESS) {
         output_segmentation_fault("Failed to map frame into client's vspace at faultAddr.", f);
         return error;
     }
 
+    window->faultAroundNextOffset = windowOffset + nFrames * REFOS_PAGE_SIZE;
+    procServ.faultStats.faultAroundPages += nFrames - 1;
+    for (int i = 0; i < nFrames; i++) {
+        if (frames[i] == procServ.zeroFrameRO.capPtr) {
+            procServ.faultStats.zeroFramePages++;
+        }
+    }
     return ESUCCESS;
 }
 
@@ -264,6 +484,7 @@ static void
 handle_vm_fault(struct procserv_msg *m, struct procserv_vmfault_msg *f)
 {
     assert(f && f->pcb);
+    procServ.faultStats.vmFaults++;
     dvprintf("# Process server recieved PID %d VM fault\n", f->pcb->pid);
     dvprintf("# %s %s fault at 0x%x, Instruction Pointer 0x%x, Fault Status Register 0x%x\n",
             f->instruction ? "Instruction" : "Data", f->read ? "read" : "write",
@@ -301,9 +522,10 @@ handle_vm_fault(struct procserv_msg *m, struct procserv_vmfault_msg *f)
         return;
     }
 
-    /* Check that there isn't a page entry already mapped. */
+    /* Check that there isn't a page entry already mapped. Anonymous windows may write fault on the
+       shared zero frame, which is handled by handle_vm_fault_dspace(). */
     cspacepath_t pageEntry = vs_get_frame(&f->pcb->vspace, f->faultAddr);
-    if (pageEntry.capPtr != 0) {
+    if (pageEntry.capPtr != 0 && (f->read || window->mode != W_MODE_ANONYMOUS)) {
         output_segmentation_fault("entry already occupied; book-keeping error.", f);
         return;
     }
@@ -315,9 +537,11 @@ handle_vm_fault(struct procserv_msg *m, struct procserv_vmfault_msg *f)
             output_segmentation_fault("fault in empty window.", f);
             break;
         case W_MODE_ANONYMOUS:
+            procServ.faultStats.anonFaults++;
             error = handle_vm_fault_dspace(m, f, aw, window);
             break;
         case W_MODE_PAGER:
+            procServ.faultStats.pagerFaults++;
             error = handle_vm_fault_pager(m, f, aw, window);
             break;
         default:
@@ -27,6 +27,10 @@
     separted into two files for better code organisation.
 */
 
+#ifndef CONFIG_PROCSERV_LARGE_PAGE_MIN_WINDOW_SIZE
+    #define CONFIG_PROCSERV_LARGE_PAGE_MIN_WINDOW_SIZE 1048576
+#endif
+
 /*! @brief Handles memory window creation syscalls.
 
     The window must not be overlapping with an existing window in the client's VSpace, or
@@ -37,6 +41,9 @@
     PAGE_ALIGN(B) bytes of the mapped dataspace is unaccessible. This can have unintended effects
     when two processes map the same dataspace for sharing purposes. In other words, when sharing
     dataspaces, it's easiest for the window bases for BOTH processes to be page-aligned.
+
+    Big windows (or ones created with W_FLAGS_LARGE_PAGES) are flagged to have their anonymous
+    memory mapped using large frames, where the window and dataspace alignment allows it.
  */
 seL4_CPtr
 proc_create_mem_window_internal_handler(void *rpc_userptr , uint32_t rpc_vaddr , uint32_t rpc_size ,
@@ -75,6 +82,15 @@ proc_create_mem_window_internal_handler(void *rpc_userptr , uint32_t rpc_vaddr ,
 
     assert(window->magic == W_MAGIC);
     assert(window->capability.capPtr);
+
+    /* Decide whether anonymous memory in this window may be backed by large frames. */
+    window->largePages = (flags & W_FLAGS_LARGE_PAGES) ||
+            (CONFIG_PROCSERV_LARGE_PAGE_MIN_WINDOW_SIZE > 0 &&
+             rpc_size >= CONFIG_PROCSERV_LARGE_PAGE_MIN_WINDOW_SIZE);
+    if (flags & W_FLAGS_NO_LARGE_PAGES) {
+        window->largePages = false;
+    }
+
     SET_ERRNO_PTR(rpc_errno, ESUCCESS);
     return window->capability.capPtr;
 }
@@ -101,6 +117,76 @@ proc_resize_mem_window_handler(void *rpc_userptr , seL4_CPtr rpc_window , uint32
     return vs_resize_window(&pcb->vspace, rpc_window - W_BADGE_BASE, rpc_size);
 }
 
+/*! @brief Handles combined memory window and anonymous dataspace resize syscalls.
+
+    When growing, the dataspace is expanded before the window so the window never covers pages
+    past the end of the dataspace. When shrinking, the window is shrunk first, which unmaps the
+    trimmed pages, and then the dataspace is contracted to release their frames.
+*/
+refos_err_t
+proc_resize_mem_window_dspace_handler(void *rpc_userptr , seL4_CPtr rpc_window ,
+                                      uint32_t rpc_size)
+{
+    struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
+    struct procserv_msg *m = (struct procserv_msg*) pcb->rpcClient.userptr;
+    assert(pcb && pcb->magic == REFOS_PCB_MAGIC);
+
+    if (!check_dispatch_caps(m, 0x00000001, 1)) {
+        dvprintf("Warning: proc_resize_mem_window_dspace invalid window cap.\n");
+        return EINVALIDWINDOW;
+    }
+
+    if (!dispatcher_badge_window(rpc_window)) {
+        dvprintf("Warning: proc_resize_mem_window_dspace invalid window badge.\n");
+        return EINVALIDWINDOW;
+    }
+
+    /* The window must belong to the caller and have an anonymous dataspace mapped. */
+    int wID = rpc_window - W_BADGE_BASE;
+    struct w_window *window = w_get_window(&procServ.windowList, wID);
+    if (!window || !w_associate_find_winID(&pcb->vspace.windows, wID)) {
+        return EINVALIDWINDOW;
+    }
+    if (window->mode != W_MODE_ANONYMOUS || !window->ramDataspace) {
+        dvprintf("Warning: proc_resize_mem_window_dspace window has no anon dataspace.\n");
+        return EINVALIDPARAM;
+    }
+    if (!rpc_size) {
+        return EINVALIDPARAM;
+    }
+
+    struct ram_dspace *dspace = window->ramDataspace;
+    uint32_t dspaceSize = window->ramDataspaceOffset + rpc_size;
+    int error = ESUCCESS;
+
+    if (rpc_size >= window->size) {
+        /* Grow the dataspace, then the window. */
+        if (dspaceSize > ram_dspace_get_size(dspace)) {
+            error = ram_dspace_expand(dspace, dspaceSize);
+            if (error != ESUCCESS) {
+                return error;
+            }
+        }
+        return vs_resize_window(&pcb->vspace, wID, rpc_size);
+    }
+
+    /* Shrink the window, then the dataspace. Check the dataspace can be contracted first, so a
+       failed resize does not leave the window shrunk. */
+    if (dspaceSize < ram_dspace_get_size(dspace) &&
+            (dspace->contentInitEnabled || dspace->physicalAddrEnabled)) {
+        dvprintf("Warning: proc_resize_mem_window_dspace can not shrink this dataspace.\n");
+        return EINVALIDPARAM;
+    }
+    error = vs_resize_window(&pcb->vspace, wID, rpc_size);
+    if (error != ESUCCESS) {
+        return error;
+    }
+    if (dspaceSize < ram_dspace_get_size(dspace)) {
+        error = ram_dspace_resize(dspace, dspaceSize);
+    }
+    return error;
+}
+
 /*! @brief Handles memory window deletion syscalls. */
 refos_err_t
 proc_delete_mem_window_handler(void *rpc_userptr , seL4_CPtr rpc_window)
@@ -178,9 +264,52 @@ proc_get_mem_window_dspace_handler(void *rpc_userptr , seL4_CPtr rpc_window ,
     assert(window->ramDataspace && window->ramDataspace->magic == RAM_DATASPACE_MAGIC);
 
     SET_ERRNO_PTR(rpc_errno, ESUCCESS);
+    if (window->ramDataspaceReadOnly) {
+        /* Don't hand out more rights than the window was datamapped with. */
+        return ram_dspace_get_read_only_cap(window->ramDataspace);
+    }
     return window->ramDataspace->capability.capPtr;
 }
 
+/*! @brief Handles read-only dataspace capability syscalls.
+
+    The owner of an anonymous dataspace calls this to get a capability which only allows
+    datamapping the dataspace read-only, to share the dataspace with untrusted readers.
+ */
+seL4_CPtr
+proc_get_dspace_read_only_handler(void *rpc_userptr , seL4_CPtr rpc_dataspace ,
+                                  refos_err_t* rpc_errno)
+{
+    struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
+    struct procserv_msg *m = (struct procserv_msg*) pcb->rpcClient.userptr;
+    assert(pcb && pcb->magic == REFOS_PCB_MAGIC);
+
+    if (!check_dispatch_caps(m, 0x00000001, 1)) {
+        SET_ERRNO_PTR(rpc_errno, EINVALIDPARAM);
+        return 0;
+    }
+
+    /* Verify & find the dataspace. Only a full dataspace cap may be used to get a read-only
+       one. */
+    if (!dispatcher_badge_dspace(rpc_dataspace)) {
+        SET_ERRNO_PTR(rpc_errno, EINVALIDPARAM);
+        return 0;
+    }
+    struct ram_dspace *dspace = ram_dspace_get_badge(&procServ.dspaceList, rpc_dataspace);
+    if (!dspace) {
+        SET_ERRNO_PTR(rpc_errno, EINVALIDPARAM);
+        return 0;
+    }
+
+    seL4_CPtr readOnlyCap = ram_dspace_get_read_only_cap(dspace);
+    if (!readOnlyCap) {
+        SET_ERRNO_PTR(rpc_errno, ENOMEM);
+        return 0;
+    }
+    SET_ERRNO_PTR(rpc_errno, ESUCCESS);
+    return readOnlyCap;
+}
+
 
 /*! @brief Handles server pager setup syscalls.
 
@@ -292,15 +421,47 @@ proc_notification_buffer_handler(void *rpc_userptr , seL4_CPtr rpc_dataspace)
     return proc_set_notificationbuffer(pcb, dspace);
 }
 
+/*! @brief Resume a client blocked on a fault delegated to its pager, if the given run of pages
+           in one of its windows covers the faulting address. Pages mapped ahead of the fault (eg.
+           by pager read-ahead) leave the client blocked until its own page is mapped.
+    @param clientPCB The client owning the window.
+    @param window The window which was mapped into.
+    @param windowOffset The offset into the window of the first mapped page.
+    @param nFrames The number of pages mapped.
+*/
+static void
+mem_syscall_resume_fault(struct proc_pcb *clientPCB, struct w_window *window,
+                         uint32_t windowOffset, uint32_t nFrames)
+{
+    assert(clientPCB && clientPCB->magic == REFOS_PCB_MAGIC);
+    assert(window && window->magic == W_MAGIC);
+    if (!clientPCB->faultReply.capPtr || !clientPCB->faultAddr || !nFrames) {
+        return;
+    }
+    struct w_associated_window *wa = w_associate_find_winID(&clientPCB->vspace.windows,
+                                                            window->wID);
+    if (!wa) {
+        return;
+    }
+    vaddr_t mapStart = REFOS_PAGE_ALIGN(wa->offset + windowOffset);
+    vaddr_t faultPage = REFOS_PAGE_ALIGN(clientPCB->faultAddr);
+    if (faultPage < mapStart || faultPage - mapStart >= nFrames * REFOS_PAGE_SIZE) {
+        return;
+    }
+    assert(procServ.unblockClientFaultPID == PID_NULL);
+    procServ.unblockClientFaultPID = clientPCB->pid;
+}
+
 /*! @brief Handles server window map syscalls.
 
     A server calls this on the process server in response to a prior fault delegation notification
     made by the process server, in order to map the given frame in the dataserver's VSpace into
-    the faulting address frame, resolving the fault.
+    the faulting address frame, resolving the fault. The faulting client is only resumed when the
+    mapped frame is the one it faulted on.
  */
 refos_err_t
 proc_window_map_handler(void *rpc_userptr , seL4_CPtr rpc_window , uint32_t rpc_windowOffset ,
-                        uint32_t rpc_srcAddr)
+                        uint32_t rpc_srcAddr , uint32_t rpc_permissions)
 {
     struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
     struct procserv_msg *m = (struct procserv_msg*) pcb->rpcClient.userptr;
@@ -322,19 +483,138 @@ proc_window_map_handler(void *rpc_userptr , seL4_CPtr rpc_window , uint32_t rpc_
     
     /* Map the frame from src vspace to dest vspace. */
     struct proc_pcb *clientPCB = NULL;
-    int error = vs_map_across_vspace(&pcb->vspace, rpc_srcAddr, window, rpc_windowOffset,
-                                    &clientPCB);
+    int error = vs_map_across_vspace(&pcb->vspace, rpc_srcAddr, window, rpc_windowOffset, 1,
+                                     rpc_permissions, &clientPCB);
     if (error) {
         return error;
     }
     assert(clientPCB != NULL && clientPCB->magic == REFOS_PCB_MAGIC);
 
     /* Resume the blocked faulting thread if there is one. */
-    assert(procServ.unblockClientFaultPID == PID_NULL);
-    procServ.unblockClientFaultPID = clientPCB->pid;
+    mem_syscall_resume_fault(clientPCB, window, rpc_windowOffset, 1);
     return ESUCCESS;
 }
 
+/*! @brief Handles server window map range syscalls.
+
+    Same as proc_window_map, except that a run of frames, contiguous in the dataserver's VSpace, is
+    mapped into contiguous pages of the window at once. Lets a pager map pages around a fault (eg.
+    read-ahead for a sequential scan) without a round-trip per page.
+ */
+refos_err_t
+proc_window_map_range_handler(void *rpc_userptr , seL4_CPtr rpc_window ,
+                              uint32_t rpc_windowOffset , uint32_t rpc_srcAddr ,
+                              uint32_t rpc_nFrames , uint32_t rpc_permissions)
+{
+    struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
+    struct procserv_msg *m = (struct procserv_msg*) pcb->rpcClient.userptr;
+    assert(pcb && pcb->magic == REFOS_PCB_MAGIC);
+
+    if (!check_dispatch_caps(m, 0x00000001, 1)) {
+        return EINVALIDPARAM;
+    }
+
+    /* Retrieve and verify the window cap. */
+    if (!dispatcher_badge_window(rpc_window)) {
+        return EINVALIDPARAM;
+    }
+    struct w_window *window = w_get_window(&procServ.windowList, rpc_window - W_BADGE_BASE);
+    if (!window) {
+        ROS_ERROR("window does not exist!\n");
+        return EINVALIDWINDOW;
+    }
+    if (rpc_nFrames == 0 || rpc_nFrames > window->size / REFOS_PAGE_SIZE + 1) {
+        ROS_ERROR("invalid number of frames to map!\n");
+        return EINVALIDPARAM;
+    }
+
+    /* End the run at the first page after the first that the client already has mapped; the
+       pager may not know about everything in the window (eg. reading ahead past a page mapped on
+       an earlier, out of order fault), and mapping over it would fail the whole batch. */
+    struct proc_pcb *clientPCB = pid_get_pcb(&procServ.PIDList, window->clientOwnerPID);
+    if (clientPCB) {
+        assert(clientPCB->magic == REFOS_PCB_MAGIC);
+        struct w_associated_window *wa = w_associate_find_winID(&clientPCB->vspace.windows,
+                                                                window->wID);
+        for (uint32_t i = 1; wa && i < rpc_nFrames; i++) {
+            vaddr_t vaddr = REFOS_PAGE_ALIGN(wa->offset + rpc_windowOffset + i * REFOS_PAGE_SIZE);
+            if (vspace_get_cap(&clientPCB->vspace.vspace, (void*) vaddr)) {
+                rpc_nFrames = i;
+                break;
+            }
+        }
+    }
+
+    /* Map the frames from src vspace to dest vspace, as many at once as we can. */
+    clientPCB = NULL;
+    int error = ESUCCESS;
+    uint32_t nMapped = 0;
+    while (nMapped < rpc_nFrames) {
+        uint32_t n = MIN(rpc_nFrames - nMapped, VS_MAP_SCRATCH_FRAMES);
+        error = vs_map_across_vspace(&pcb->vspace, rpc_srcAddr + nMapped * REFOS_PAGE_SIZE,
+                                     window, rpc_windowOffset + nMapped * REFOS_PAGE_SIZE, n,
+                                     rpc_permissions, &clientPCB);
+        if (error) {
+            break;
+        }
+        nMapped += n;
+    }
+
+    /* Resume the blocked faulting thread if its page was mapped. */
+    if (clientPCB && nMapped > 0) {
+        assert(clientPCB->magic == REFOS_PCB_MAGIC);
+        mem_syscall_resume_fault(clientPCB, window, rpc_windowOffset, nMapped);
+    }
+    return error;
+}
+
+/*! @brief Handles server window unmap syscalls.
+
+    A server calls this on the process server to take back a frame it has previously mapped into a
+    client's window using proc_window_map, so it can reclaim the frame.
+ */
+refos_err_t
+proc_window_unmap_handler(void *rpc_userptr , seL4_CPtr rpc_window , uint32_t rpc_windowOffset)
+{
+    struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
+    struct procserv_msg *m = (struct procserv_msg*) pcb->rpcClient.userptr;
+    assert(pcb && pcb->magic == REFOS_PCB_MAGIC);
+
+    if (!check_dispatch_caps(m, 0x00000001, 1)) {
+        return EINVALIDPARAM;
+    }
+
+    /* Retrieve and verify the window cap. */
+    if (!dispatcher_badge_window(rpc_window)) {
+        return EINVALIDPARAM;
+    }
+    struct w_window *window = w_get_window(&procServ.windowList, rpc_window - W_BADGE_BASE);
+    if (!window) {
+        ROS_ERROR("window does not exist!\n");
+        return EINVALIDWINDOW;
+    }
+    if (rpc_windowOffset >= window->size) {
+        ROS_ERROR("invalid window offset address!\n");
+        return EINVALIDPARAM;
+    }
+
+    /* Find the client which this window lives in. */
+    struct proc_pcb *clientPCB = pid_get_pcb(&procServ.PIDList, window->clientOwnerPID);
+    if (!clientPCB) {
+        ROS_ERROR("could not find window's corresponding client.\n");
+        return EINVALIDWINDOW;
+    }
+    assert(clientPCB->magic == REFOS_PCB_MAGIC);
+    struct w_associated_window *wa = w_associate_find_winID(&clientPCB->vspace.windows,
+                                                            window->wID);
+    if (!wa) {
+        ROS_ERROR("client did not map its window, so invalid unmap call.\n");
+        return EINVALIDWINDOW;
+    }
+
+    return vs_unmap(&clientPCB->vspace, REFOS_PAGE_ALIGN(wa->offset + rpc_windowOffset), 1);
+}
+
 /*! @brief Handles device server device map syscalls. */
 refos_err_t
 proc_device_map_handler(void *rpc_userptr , seL4_CPtr rpc_window , uint32_t rpc_windowOffset ,
@@ -277,6 +277,7 @@ proc_exit_handler(void *rpc_userptr , int32_t rpc_status)
     struct proc_pcb *pcb = (struct proc_pcb*) rpc_userptr;
     assert(pcb->magic == REFOS_PCB_MAGIC);
     dprintf("Process PID %u exiting with status %d !!!\n", pcb->pid, rpc_status);
+    procserv_fault_stats_print();
     pcb->exitStatus = rpc_status;
     pcb->rpcClient.skip_reply = true;
     proc_queue_release(pcb);
@@ -110,6 +110,7 @@ proc_server_handle_message(struct procserv_state *s, struct procserv_msg *msg)
     is to exit and the whole system is to by shut down (which is possibly never). It blocks on the
     process server endpoint and waits for an IPC message, and then handles the dispatching of
     the message when it recieves one, before looping around and waiting for the next IPC message.
+    In between, once the client has been replied to, it tops up the frame pool.
 
     @return Does not return, runs endlessly.
 */
@@ -124,6 +125,9 @@ proc_server_loop(void)
         msg.message = seL4_Recv(s->endpoint.cptr, &msg.badge);
         proc_server_handle_message(s, &msg);
         s->faketime++;
+
+        /* The client has been replied to, so top up the frame pool before waiting again. */
+        procserv_frame_pool_refill(CONFIG_PROCSERV_FRAME_POOL_REFILL_BATCH);
     }
 
     return 0;
@@ -101,6 +101,24 @@ initialise_modules(struct procserv_state *s)
     nameserv_init(&s->nameServRegList, procserv_nameserv_callback_free_cap);
 }
 
+/*! @brief Initialise the shared zero frame, and the read-only copy of its cap which is handed out
+           to be mapped into clients. New frames are cleared by the kernel, so it reads as zeros.
+    @param s The process server global state.
+ */
+static void
+initialise_zero_frame(struct procserv_state *s)
+{
+    int error = vka_alloc_frame(&s->vka, seL4_PageBits, &s->zeroFrame);
+    assert(!error && s->zeroFrame.cptr);
+    error = vka_cspace_alloc_path(&s->vka, &s->zeroFrameRO);
+    assert(!error);
+    cspacepath_t pathSrc;
+    vka_cspace_make_path(&s->vka, s->zeroFrame.cptr, &pathSrc);
+    error = vka_cnode_copy(&s->zeroFrameRO, &pathSrc, seL4_CanRead);
+    assert(!error);
+    (void) error;
+}
+
 #ifdef CONFIG_ARCH_ARM
 /*! @brief Wrapper function for allocating a portion of an untyped into an object.
     @param data cookie for the underlying allocator.
@@ -191,6 +209,8 @@ initialise(seL4_BootInfo *info, struct procserv_state *s)
     /* Initialise miscellaneous states. */
     dprintf("Initialising process server modules...\n");
     initialise_modules(s);
+    initialise_zero_frame(s);
+    procserv_frame_pool_refill(CONFIG_PROCSERV_FRAME_POOL_SIZE);
     chash_init(&s->irqHandlerList, PROCSERV_IRQ_HANDLER_HASHTABLE_SIZE);
     s->unblockClientFaultPID = PID_NULL;
 
@@ -223,45 +243,179 @@ procserv_mint_badge(int badge)
     return path;
 }
 
+/*! @brief Get a persistent mapping of the given frame in our own vspace, mapping it into the frame
+           mapping cache if it isn't already there.
+    @param frame CPtr to the frame to map.
+    @param sizeBits The size of the frame in bits.
+    @return The vaddr the frame is mapped at on success, NULL otherwise.
+*/
+static char*
+procserv_frame_map_cached(seL4_CPtr frame, int sizeBits)
+{
+    struct procserv_frame_map_cache *fc = &procServ.frameMapCache;
+    struct procserv_frame_map_entry *victim = &fc->entry[0];
+
+    if (++fc->tick == 0) {
+        /* The LRU clock wrapped around; restart the ordering from scratch. */
+        for (int i = 0; i < CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE; i++) {
+            fc->entry[i].lastUsed = 0;
+        }
+        fc->tick = 1;
+    }
+
+    /* Look for the frame, remembering the least recently used slot on the way. */
+    for (int i = 0; i < CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE; i++) {
+        struct procserv_frame_map_entry *e = &fc->entry[i];
+        if (e->frame == frame && e->vaddr) {
+            assert(e->sizeBits == sizeBits);
+            e->lastUsed = fc->tick;
+            fc->hits++;
+            return e->vaddr;
+        }
+        if (e->lastUsed < victim->lastUsed) {
+            victim = e;
+        }
+    }
+    fc->misses++;
+
+    /* Evict the least recently used frame, and map the new frame in its place. */
+    if (victim->vaddr) {
+        vspace_unmap_pages(&procServ.vspace, victim->vaddr, 1, victim->sizeBits,
+                           VSPACE_PRESERVE);
+        victim->vaddr = NULL;
+        victim->frame = 0;
+    }
+    char *addr = (char*) vspace_map_pages(&procServ.vspace, &frame, NULL, seL4_AllRights, 1,
+                                          sizeBits, true);
+    if (!addr) {
+        victim->lastUsed = 0;
+        return NULL;
+    }
+    victim->frame = frame;
+    victim->sizeBits = sizeBits;
+    victim->vaddr = addr;
+    victim->lastUsed = fc->tick;
+    return addr;
+}
+
+void
+procserv_frame_unmap_cached(seL4_CPtr frame)
+{
+    struct procserv_frame_map_cache *fc = &procServ.frameMapCache;
+    for (int i = 0; i < CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE; i++) {
+        struct procserv_frame_map_entry *e = &fc->entry[i];
+        if (e->frame != frame || !e->vaddr) {
+            continue;
+        }
+        vspace_unmap_pages(&procServ.vspace, e->vaddr, 1, e->sizeBits, VSPACE_PRESERVE);
+        e->frame = 0;
+        e->vaddr = NULL;
+        e->lastUsed = 0;
+        return;
+    }
+}
+
 int
-procserv_frame_write(seL4_CPtr frame, const char* src, size_t len, size_t offset)
+procserv_frame_write_sized(seL4_CPtr frame, int sizeBits, const char* src, size_t len,
+                           size_t offset)
 {
-    if (offset + len > REFOS_PAGE_SIZE) {
+    if (offset + len > (1 << sizeBits)) {
         ROS_ERROR("procserv_frame_write invalid offset and length.");
         return EINVALIDPARAM;
     }
-    char* addr = (char*) vspace_map_pages(&procServ.vspace, &frame, NULL, seL4_AllRights, 1,
-                                          seL4_PageBits, true);
+    char* addr = procserv_frame_map_cached(frame, sizeBits);
     if (!addr) {
         ROS_ERROR ("procserv_frame_write couldn't map frame.");
         return ENOMEM;
     }
     memcpy((void*)(addr + offset), (void*) src, len);
-    procserv_flush(&frame, 1);
-    vspace_unmap_pages(&procServ.vspace, addr, 1, seL4_PageBits, VSPACE_PRESERVE);
+    procserv_flush_range(frame, offset, offset + len);
     return ESUCCESS;
 }
 
 int
-procserv_frame_read(seL4_CPtr frame, const char* dst, size_t len, size_t offset)
+procserv_frame_read_sized(seL4_CPtr frame, int sizeBits, const char* dst, size_t len,
+                          size_t offset)
 {
-    if (offset + len > REFOS_PAGE_SIZE) {
+    if (offset + len > (1 << sizeBits)) {
         ROS_ERROR("procserv_frame_read invalid offset and length.");
         return EINVALIDPARAM;
     }
 
-    char* addr = (char*) vspace_map_pages(&procServ.vspace, &frame, NULL, seL4_AllRights, 1,
-                                          seL4_PageBits, true);
+    char* addr = procserv_frame_map_cached(frame, sizeBits);
     if (!addr) {
         ROS_ERROR ("procserv_frame_read couldn't map frame.");
         return ENOMEM;
     }
-    procserv_flush(&frame, 1);
+    procserv_flush_range(frame, offset, offset + len);
     memcpy((void*) dst, (void*)(addr + offset), len);
-    vspace_unmap_pages(&procServ.vspace, addr, 1, seL4_PageBits, VSPACE_PRESERVE);
     return ESUCCESS;
 }
 
+int
+procserv_frame_write(seL4_CPtr frame, const char* src, size_t len, size_t offset)
+{
+    return procserv_frame_write_sized(frame, seL4_PageBits, src, len, offset);
+}
+
+int
+procserv_frame_read(seL4_CPtr frame, const char* dst, size_t len, size_t offset)
+{
+    return procserv_frame_read_sized(frame, seL4_PageBits, dst, len, offset);
+}
+
+int
+procserv_frame_pool_alloc(vka_object_t *frame)
+{
+    struct procserv_frame_pool *fp = &procServ.framePool;
+    assert(frame);
+    if (fp->count > 0) {
+        (*frame) = fp->frame[--fp->count];
+        memset(&fp->frame[fp->count], 0, sizeof(vka_object_t));
+        fp->hits++;
+        return ESUCCESS;
+    }
+    fp->misses++;
+    int error = vka_alloc_frame(&procServ.vka, seL4_PageBits, frame);
+    if (error || !frame->cptr) {
+        memset(frame, 0, sizeof(vka_object_t));
+        return ENOMEM;
+    }
+    return ESUCCESS;
+}
+
+uint32_t
+procserv_frame_pool_refill(uint32_t maxFrames)
+{
+    struct procserv_frame_pool *fp = &procServ.framePool;
+    uint32_t n = 0;
+    for (; n < maxFrames && fp->count < CONFIG_PROCSERV_FRAME_POOL_SIZE; n++) {
+        vka_object_t *frame = &fp->frame[fp->count];
+        int error = vka_alloc_frame(&procServ.vka, seL4_PageBits, frame);
+        if (error || !frame->cptr) {
+            /* Low on memory. Leave what's left to the clients. */
+            memset(frame, 0, sizeof(vka_object_t));
+            break;
+        }
+        fp->count++;
+    }
+    return n;
+}
+
+void
+procserv_fault_stats_print(void)
+{
+    dprintf("VM fault stats: %u faults (%u anon, %u pager, %u content-init).\n",
+            procServ.faultStats.vmFaults, procServ.faultStats.anonFaults,
+            procServ.faultStats.pagerFaults, procServ.faultStats.contentInitFaults);
+    dprintf("    %u content-init pages, %u faulted-around pages.\n",
+            procServ.faultStats.contentInitPages, procServ.faultStats.faultAroundPages);
+    dprintf("    %u zero frame pages, %u zero frame write faults.\n",
+            procServ.faultStats.zeroFramePages, procServ.faultStats.zeroFrameWriteFaults);
+    dprintf("    %u large page faults, %u large page splits.\n",
+            procServ.faultStats.largePageFaults, procServ.faultStats.largePageSplits);
+}
+
 /*! @brief The free EP cap callback function, used by the nameserv implementation helper library.
     @param cap The endpoint cap to free.
  */
@@ -322,7 +476,6 @@ procserv_find_device(void *paddr, int size)
 void
 procserv_flush(seL4_CPtr *frame, int nFrames)
 {
-#ifdef CONFIG_ARCH_ARM
     if (!frame) {
         return;
     }
@@ -330,8 +483,18 @@ procserv_flush(seL4_CPtr *frame, int nFrames)
         if (!frame[i]) {
             continue;
         }
-        seL4_ARM_Page_Unify_Instruction(frame[i], 0, REFOS_PAGE_SIZE);
+        procserv_flush_range(frame[i], 0, REFOS_PAGE_SIZE);
+    }
+}
+
+void
+procserv_flush_range(seL4_CPtr frame, size_t start, size_t end)
+{
+#ifdef CONFIG_ARCH_ARM
+    if (!frame || start >= end) {
+        return;
     }
+    seL4_ARM_Page_Unify_Instruction(frame, start, end);
 #endif /* CONFIG_ARCH_ARM */
 }
 
@@ -37,6 +37,69 @@
 /*! @file
     @brief Global environment struct & helper functions for process server. */
 
+#ifndef CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE
+    #define CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE 32
+#endif
+
+#ifndef CONFIG_PROCSERV_FRAME_POOL_SIZE
+    #define CONFIG_PROCSERV_FRAME_POOL_SIZE 32
+#endif
+
+#ifndef CONFIG_PROCSERV_FRAME_POOL_REFILL_BATCH
+    #define CONFIG_PROCSERV_FRAME_POOL_REFILL_BATCH 8
+#endif
+
+/*! @brief A frame persistently mapped into the process server's own vspace. */
+struct procserv_frame_map_entry {
+    seL4_CPtr frame;
+    int sizeBits;
+    char *vaddr;
+    uint32_t lastUsed;
+};
+
+/*! @brief Small LRU cache of frames persistently mapped into the process server's vspace.
+
+    Reading / writing a frame from the process server requires the frame to be mapped into our own
+    vspace. Rather than mapping, flushing and unmapping the frame on every access, recently used
+    frames are kept mapped here, and the least recently used one is unmapped when a new frame needs
+    a slot. Frames must be removed from this cache through procserv_frame_unmap_cached() before
+    they are deleted.
+*/
+struct procserv_frame_map_cache {
+    struct procserv_frame_map_entry entry[CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE];
+    uint32_t tick;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/*! @brief Pool of ready 4k frames for anonymous memory.
+
+    Frames are allocated (retyped from untyped, and so cleared by the kernel) ahead of time, off
+    the VM fault path, and handed out to dataspace pages on first touch. A frame taken from the
+    pool has never been used, so it needs no cleaning. Frames are never given back to the pool;
+    freed frames go straight back to the allocator.
+*/
+struct procserv_frame_pool {
+    vka_object_t frame[CONFIG_PROCSERV_FRAME_POOL_SIZE];
+    uint32_t count;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/*! @brief VM fault counters, used to measure the effect of fault-around. */
+struct procserv_fault_stats {
+    uint32_t vmFaults;
+    uint32_t anonFaults;
+    uint32_t pagerFaults;
+    uint32_t contentInitFaults;
+    uint32_t contentInitPages;
+    uint32_t faultAroundPages;
+    uint32_t zeroFramePages;
+    uint32_t zeroFrameWriteFaults;
+    uint32_t largePageFaults;
+    uint32_t largePageSplits;
+};
+
 /*! @brief A list of global process server objects; represents an instance of the process server. */
 struct procserv_state {
     /* Allocator information. */
@@ -65,6 +128,13 @@ struct procserv_state {
     struct ram_dspace_list             dspaceList;
     nameserv_state_t                   nameServRegList;
     chash_t                            irqHandlerList;
+    struct procserv_frame_map_cache    frameMapCache;
+    struct procserv_frame_pool         framePool;
+    struct procserv_fault_stats        faultStats;
+
+    /* Shared zero frame, mapped read-only for reads of untouched anonymous memory. */
+    vka_object_t                       zeroFrame;
+    cspacepath_t                       zeroFrameRO;
 
     /* Misc states. */
     uint32_t                           faketime;
@@ -133,6 +203,56 @@ int procserv_frame_write(seL4_CPtr frame, const char* src, size_t len, size_t of
 */
 int procserv_frame_read(seL4_CPtr frame, const char* dst, size_t len, size_t offset);
 
+/*! @brief Write data to a frame of the given size. Same as procserv_frame_write(), but also works
+           on large frames.
+    @param frame CPtr to destination frame.
+    @param sizeBits The size of the frame in bits (eg. seL4_LargePageBits).
+    @param src Data source buffer.
+    @param len Data source buffer length.
+    @param offset Offset into frame to write to.
+    @return ESUCCESS if write successful, refos error otherwise.
+*/
+int procserv_frame_write_sized(seL4_CPtr frame, int sizeBits, const char* src, size_t len,
+                               size_t offset);
+
+/*! @brief Read data from a frame of the given size. Same as procserv_frame_read(), but also works
+           on large frames.
+    @param frame CPtr to source frame.
+    @param sizeBits The size of the frame in bits (eg. seL4_LargePageBits).
+    @param dst Data destination buffer.
+    @param len Data destination buffer max length.
+    @param offset Offset into frame to read from.
+    @return ESUCCESS if read successful, refos error otherwise.
+*/
+int procserv_frame_read_sized(seL4_CPtr frame, int sizeBits, const char* dst, size_t len,
+                              size_t offset);
+
+/*! @brief Remove a frame from the persistent frame mapping cache, unmapping it from the process
+           server's vspace if it was mapped. This must be called before a frame which may have
+           been read / written using procserv_frame_read() / procserv_frame_write() is deleted.
+    @param frame CPtr to the frame to remove.
+*/
+void procserv_frame_unmap_cached(seL4_CPtr frame);
+
+/*! @brief Allocate a 4k frame, taking a ready one from the frame pool if there is one, and
+           falling back to the allocator otherwise. The frame is freed with vka_free_object()
+           as usual.
+    @param frame Output frame object. (Gives ownership)
+    @return ESUCCESS on success, refos error otherwise.
+*/
+int procserv_frame_pool_alloc(vka_object_t *frame);
+
+/*! @brief Top up the frame pool. Must not be called on the VM fault path.
+    @param maxFrames Max number of frames to allocate.
+    @return The number of frames allocated.
+*/
+uint32_t procserv_frame_pool_refill(uint32_t maxFrames);
+
+/*! @brief Print out the VM fault counters, to see how many faults fault-around, the shared zero
+           frame and large pages have saved. Only prints when debug output is enabled.
+*/
+void procserv_fault_stats_print(void);
+
 /*! @brief Helper function to finds a MMIO device frame.
     @param paddr Physical address of the device MMIO frame.
     @param size Size of device frame in bytes.
@@ -146,6 +266,13 @@ cspacepath_t procserv_find_device(void *paddr, int size);
 */
 void procserv_flush(seL4_CPtr *frame, int nFrames);
 
+/*! @brief Helper Function to TLB flush a byte range of a single frame of any size.
+    @param frame The frame cap to flush.
+    @param start Offset into the frame of the start of the range.
+    @param end Offset into the frame of the end of the range.
+*/
+void procserv_flush_range(seL4_CPtr frame, size_t start, size_t end);
+
 /*! @brief Helper function to retrieve an IRQ handler for the given IRQ number. Uses a hash table
            in order to avoid creating the same IRQ handler twice.
     @param irq The IRQ number to create the handler for.
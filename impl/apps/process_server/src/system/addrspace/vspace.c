@@ -19,6 +19,13 @@
 
 #define VSPACE_WINDOW_VERBOSE_DEBUG true
 
+/* Scratch space for mapping frames. The process server is single threaded, so these are never
+   used by two mappings at once. The scratch cslots are allocated on first use, and kept around
+   to hold the temporary read-only frame cap copies of later mappings. */
+static seL4_CPtr _vsMapFrameCopy[VS_MAP_SCRATCH_FRAMES];
+static seL4_CPtr _vsMapSrcFrames[VS_MAP_SCRATCH_FRAMES];
+static seL4_CPtr _vsMapScratchSlots[VS_MAP_SCRATCH_FRAMES];
+
 /* -------------------- VSpace Helper Library Callback Functions ---------------------------------*/
 
 static void
@@ -400,7 +407,10 @@ vs_map(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frames[], int nFrames)
     }
 
     /* Make a copy of every cap given. */
-    seL4_CPtr* frameCopy = malloc(sizeof(seL4_CPtr) * nFrames);
+    seL4_CPtr* frameCopy = _vsMapFrameCopy;
+    if (nFrames > VS_MAP_SCRATCH_FRAMES) {
+        frameCopy = malloc(sizeof(seL4_CPtr) * nFrames);
+    }
     if (!frameCopy) {
         ROS_ERROR("Could not allocate frame copy array, procserv out of memory.\n");
         return ENOMEM;
@@ -432,7 +442,9 @@ vs_map(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frames[], int nFrames)
     procserv_flush(frameCopy, nFrames);
 
     dvprintf("mapping vaddr 0x%x OK.\n", (uint32_t) vaddr);
-    free(frameCopy);
+    if (frameCopy != _vsMapFrameCopy) {
+        free(frameCopy);
+    }
     return ESUCCESS;
 
     /* Exit stack. */
@@ -446,26 +458,132 @@ exit1:
             vka_cspace_free(&procServ.vka, frameCopy[i]);
         }
     }
-    free(frameCopy);
+    if (frameCopy != _vsMapFrameCopy) {
+        free(frameCopy);
+    }
     return error;
 }
 
+int
+vs_map_large(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frame)
+{
+    assert(vs && vs->magic == REFOS_VSPACE_MAGIC);
+    const vaddr_t largeSize = (1 << seL4_LargePageBits);
+    if (!frame || (vaddr & (largeSize - 1))) {
+        return EINVALIDPARAM;
+    }
+
+    /* Check the window association to make sure there exists a window there. */
+    struct w_associated_window *awindow = w_associate_find_range(&vs->windows, vaddr, largeSize);
+    if (!awindow) {
+        dvprintf("could not find window association for large frame.\n");
+        return EINVALIDWINDOW;
+    }
+
+    /* Retrieve the window structure. */
+    struct w_window* window = w_get_window(&procServ.windowList, awindow->winID);
+    if (!window) {
+        dvprintf("could not find window.\n");
+        assert(!"window book keeping bug. Should not happen.");
+        return EINVALIDWINDOW;
+    }
+    assert(window->vspace == &vs->vspace);
+
+    /* Check that every page under the large frame is unmapped. */
+    for (vaddr_t va = vaddr; va < vaddr + largeSize; va += REFOS_PAGE_SIZE) {
+        if (vspace_get_cap(&vs->vspace, (void*) va)) {
+            return EUNMAPFIRST;
+        }
+    }
+
+    /* Make a copy of the cap, and map it. */
+    cspacepath_t pathDest, pathSrc;
+    int error = vka_cspace_alloc_path(&procServ.vka, &pathDest);
+    if (error) {
+        ROS_ERROR("Could not allocate cslot to copy large frame.\n");
+        return ENOMEM;
+    }
+    vka_cspace_make_path(&procServ.vka, frame, &pathSrc);
+    vka_cnode_copy(&pathDest, &pathSrc, seL4_AllRights);
+    error = vspace_map_pages_at_vaddr(&vs->vspace, &pathDest.capPtr, NULL, (void*) vaddr, 1,
+                                      seL4_LargePageBits, window->reservation);
+    if (error) {
+        dvprintf("could not map large frame into vaddr 0x%x. error: %d\n", (uint32_t) vaddr,
+                 error);
+        vka_cnode_delete(&pathDest);
+        vka_cspace_free(&procServ.vka, pathDest.capPtr);
+        return EUNMAPFIRST;
+    }
+
+    /* Flush the page caches. */
+    procserv_flush_range(pathDest.capPtr, 0, largeSize);
+
+    dvprintf("mapping large frame at vaddr 0x%x OK.\n", (uint32_t) vaddr);
+    return ESUCCESS;
+}
+
+/*! @brief Work out the size of the frame mapped at a vaddr. The vspace book keeping records a
+           large frame's cap at every 4k page under it, whereas every 4k frame mapping gets a cap
+           copy of its own, so a large frame mapping is one whose cap is also found at another
+           page of the same large page.
+    @param vs The vspace to look in.
+    @param vaddr The vaddr the frame is mapped at.
+    @param frameCap The cap found at vaddr.
+    @return The size of the mapped frame in bits.
+*/
+static int
+vs_frame_size_bits(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frameCap)
+{
+    vaddr_t base = vaddr & ~((vaddr_t) (1 << seL4_LargePageBits) - 1);
+    vaddr_t other = (REFOS_PAGE_ALIGN(vaddr) == base) ? base + REFOS_PAGE_SIZE : base;
+    if (frameCap && vspace_get_cap(&vs->vspace, (void*) other) == frameCap) {
+        return seL4_LargePageBits;
+    }
+    return seL4_PageBits;
+}
+
+/*! @brief Get the i-th scratch cslot, allocating it if this is its first use.
+    @return The scratch cslot, 0 if the process server is out of cslots.
+*/
+static seL4_CPtr
+vs_map_scratch_slot(int i)
+{
+    assert(i >= 0 && i < VS_MAP_SCRATCH_FRAMES);
+    if (!_vsMapScratchSlots[i]) {
+        vka_cspace_alloc(&procServ.vka, &_vsMapScratchSlots[i]);
+    }
+    return _vsMapScratchSlots[i];
+}
+
 int
 vs_map_across_vspace(struct vs_vspace *vsSrc, vaddr_t vaddrSrc, struct w_window *windowDest,
-                     uint32_t windowDestOffset, struct proc_pcb **outClientPCB)
+                     uint32_t windowDestOffset, uint32_t nFrames, seL4_Word permissions,
+                     struct proc_pcb **outClientPCB)
 {
     assert(vsSrc && vsSrc->magic == REFOS_VSPACE_MAGIC);
     assert(windowDest && windowDest->magic == W_MAGIC);
-
-    /* Find the cap in the source vspace's pagetable. */
-    seL4_CPtr frameCap = vspace_get_cap(&vsSrc->vspace, (void*) vaddrSrc);
-    if (!frameCap) {
-        dvprintf("vs_map_across_vspace could not find source frame.\n");
+    if (nFrames == 0 || nFrames > VS_MAP_SCRATCH_FRAMES) {
         return EINVALIDPARAM;
     }
 
-    /* Verify that the offset is within the window limits. */
-    if (windowDestOffset >= windowDest->size) {
+    /* Find the caps in the source vspace's pagetable. */
+    for (uint32_t i = 0; i < nFrames; i++) {
+        _vsMapSrcFrames[i] = vspace_get_cap(&vsSrc->vspace,
+                                            (void*) (vaddrSrc + i * REFOS_PAGE_SIZE));
+        if (!_vsMapSrcFrames[i]) {
+            dvprintf("vs_map_across_vspace could not find source frame.\n");
+            return EINVALIDPARAM;
+        }
+        if (vs_frame_size_bits(vsSrc, vaddrSrc + i * REFOS_PAGE_SIZE, _vsMapSrcFrames[i]) !=
+                seL4_PageBits) {
+            dvprintf("vs_map_across_vspace can not map from a large frame.\n");
+            return EINVALIDPARAM;
+        }
+    }
+
+    /* Verify that the run is within the window limits. */
+    if (windowDestOffset >= windowDest->size ||
+            (nFrames - 1) * REFOS_PAGE_SIZE >= windowDest->size - windowDestOffset) {
         ROS_ERROR("invalid window offset address!\n");
         return EINVALIDPARAM;
     }
@@ -488,7 +606,49 @@ vs_map_across_vspace(struct vs_vspace *vsSrc, vaddr_t vaddrSrc, struct w_window
         return EINVALIDWINDOW;
     }
 
-    return vs_map(&clientPCB->vspace, wa->offset + windowDestOffset, &frameCap, 1);
+    if (permissions & W_PERMISSION_WRITE) {
+        return vs_map(&clientPCB->vspace, wa->offset + windowDestOffset, _vsMapSrcFrames,
+                      nFrames);
+    }
+    return vs_map_read_only(&clientPCB->vspace, wa->offset + windowDestOffset, _vsMapSrcFrames,
+                            nFrames);
+}
+
+int
+vs_map_read_only(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frames[], int nFrames)
+{
+    assert(vs && vs->magic == REFOS_VSPACE_MAGIC);
+    if (nFrames <= 0 || nFrames > VS_MAP_SCRATCH_FRAMES) {
+        return EINVALIDPARAM;
+    }
+
+    /* Map read-only copies of the frame caps. vs_map() copies the caps again, and a copy can never
+       have more rights than its source, so the mappings end up read-only. */
+    int error = ESUCCESS;
+    int nCopied;
+    for (nCopied = 0; nCopied < nFrames; nCopied++) {
+        seL4_CPtr frameCapRO = vs_map_scratch_slot(nCopied);
+        if (!frameCapRO) {
+            ROS_ERROR("Could not allocate cslot for read-only frame copy, out of cslots.\n");
+            error = ENOMEM;
+            break;
+        }
+        cspacepath_t pathDest, pathSrc;
+        vka_cspace_make_path(&procServ.vka, frameCapRO, &pathDest);
+        vka_cspace_make_path(&procServ.vka, frames[nCopied], &pathSrc);
+        vka_cnode_copy(&pathDest, &pathSrc, seL4_CanRead);
+    }
+    if (error == ESUCCESS) {
+        error = vs_map(vs, vaddr, _vsMapScratchSlots, nFrames);
+    }
+
+    /* Delete the read-only copies, keeping their cslots around for next time. */
+    for (int i = 0; i < nCopied; i++) {
+        cspacepath_t path;
+        vka_cspace_make_path(&procServ.vka, _vsMapScratchSlots[i], &path);
+        vka_cnode_delete(&path);
+    }
+    return error;
 }
 
 int
@@ -565,8 +725,12 @@ vs_unmap_frame(struct vs_vspace *vs, vaddr_t vaddr)
         return;
     }
 
-    /* Unmap the page & clear the pagetable entries. */
-    vspace_unmap_pages(&vs->vspace, (void*) vaddr, 1, seL4_PageBits, VSPACE_PRESERVE);
+    /* Unmap the page & clear the pagetable entries. A large frame is unmapped as a whole. */
+    int sizeBits = vs_frame_size_bits(vs, vaddr, frameCap);
+    if (sizeBits != seL4_PageBits) {
+        vaddr &= ~((vaddr_t) (1 << sizeBits) - 1);
+    }
+    vspace_unmap_pages(&vs->vspace, (void*) vaddr, 1, sizeBits, VSPACE_PRESERVE);
 
     /* Revoke and delete the cap. */
     cspacepath_t path;
@@ -34,6 +34,10 @@
 
 #define REFOS_VSPACE_MAGIC 0x03FFED14
 
+/*! @brief Max number of frames vs_map_across_vspace() maps per call. vs_map() calls mapping up to
+           this many frames use static scratch space instead of allocating. */
+#define VS_MAP_SCRATCH_FRAMES 64
+
 struct proc_pcb;
 
 /*! @brief Client VSpace structure. Each process is assigned one. */
@@ -144,16 +148,44 @@ int vs_resize_window(struct vs_vspace *vs, int wID, vaddr_t size);
 */
 int vs_map(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frames[], int nFrames);
 
-/*! @brief Map an array of frames that have been mapped into one vspace, into another vspace.
+/*! @brief Map an array of frames into vspace read-only, whatever the rights of the given frame
+           caps and of the window covering the address range are.
+    @param vs The vspace to map frames into.
+    @param vaddr The starting destination vaddr into vspace to map frames into.
+    @param frames Array of frames to map.
+    @param nFrames Number of frames in given frame array, at most VS_MAP_SCRATCH_FRAMES.
+    @return ESUCCESS on success, refos_err_t otherwise.
+*/
+int vs_map_read_only(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frames[], int nFrames);
+
+/*! @brief Map a single large frame (seL4_LargePageBits) into vspace. Needs a valid window to be
+           covering the whole large page, and every 4k page under it to be unmapped.
+    @param vs The vspace to map the frame into.
+    @param vaddr The destination vaddr, aligned to the large page size.
+    @param frame The large frame to map.
+    @return ESUCCESS on success, refos_err_t otherwise.
+*/
+int vs_map_large(struct vs_vspace *vs, vaddr_t vaddr, seL4_CPtr frame);
+
+/*! @brief Map a run of frames that have been mapped into one vspace, into another vspace.
+
+    The frames at nFrames contiguous pages of the source vspace are mapped into contiguous pages of
+    the destination window, all in one go. Either the whole run is mapped, or nothing is. Pages of
+    the source vspace mapped using large frames can not be mapped across.
+
     @param vsSrc The source vspace to map from.
     @param vaddrSrc The vaddr in the source vspace to map from.
     @param windowDest Destination window to map into.
     @param windowDestOffset Offset into destination window.
+    @param nFrames The number of frames to map, at most VS_MAP_SCRATCH_FRAMES.
+    @param permissions The W_PERMISSION_* bitmask to map the frames with. Without W_PERMISSION_WRITE
+                       the frames are mapped read-only, whatever the window's own permissions are.
     @param outClientPCB Optional destination client PCB which uses this vspace.
     @return ESUCCESS on success, refos_err_t otherwise.
 */
 int vs_map_across_vspace(struct vs_vspace *vsSrc, vaddr_t vaddrSrc, struct w_window *windowDest,
-                         uint32_t windowDestOffset, struct proc_pcb **outClientPCB);
+                         uint32_t windowDestOffset, uint32_t nFrames, seL4_Word permissions,
+                         struct proc_pcb **outClientPCB);
 
 /*! @brief Find & map a device frame into client's vspace. 
     @param vs The vspace to map device frame into.
@@ -168,7 +200,8 @@ int vs_map_device(struct vs_vspace *vs, struct w_window *window, uint32_t window
                   uint32_t paddr , uint32_t size, bool cached);
 
 /*! @brief Unmap a series of frames from vspace. Needs a valid window to be covering that
-           address range.
+           address range. Unmapping any page of a large frame mapping unmaps the whole large
+           frame.
     @param vs The vspace to unmap frames from.
     @param vaddr The vaddr to unmap frames from.
     @param nFrames The number of 4k frames from given vaddr to unmap.
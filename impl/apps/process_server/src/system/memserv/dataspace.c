@@ -15,13 +15,151 @@
 
 extern seL4_MessageInfo_t _dispatcherEmptyReply;
 
+/* Page table index helpers. A page index is split into the top node, inner node and leaf slot. */
+#define RAM_DSPACE_TOP_SHIFT (RAM_DATASPACE_LEAF_BITS + RAM_DATASPACE_RADIX_BITS)
+#define RAM_DSPACE_TOP_INDEX(idx) ((idx) >> RAM_DSPACE_TOP_SHIFT)
+#define RAM_DSPACE_MID_INDEX(idx) \
+        (((idx) >> RAM_DATASPACE_LEAF_BITS) & (RAM_DATASPACE_RADIX_SIZE - 1))
+#define RAM_DSPACE_LEAF_INDEX(idx) ((idx) & (RAM_DATASPACE_LEAF_NPAGES - 1))
+#define RAM_DSPACE_MAX_NPAGES (1 << (RAM_DSPACE_TOP_SHIFT + RAM_DATASPACE_RADIX_BITS))
+
+/* ----------------------------- RAM dataspace page table functions ----------------------------- */
+
+/*! @brief Calculates the page index into the dataspace based on the nbytes offset.
+    @param nbytes The offset into the ram dataspace.
+    @return The page index into the dataspace.
+ */
+static inline uint32_t
+ram_dspace_get_index(size_t nbytes)
+{
+    return (uint32_t)(nbytes / REFOS_PAGE_SIZE);
+}
+
+/*! @brief Helper function to allocate a zeroed page table node, accounting for its size.
+    @param dataspace The ram dataspace the node belongs to.
+    @param size The size of the node in bytes.
+    @return The new node on success, NULL if the process server is out of memory.
+ */
+static void *
+ram_dspace_table_alloc(struct ram_dspace *dataspace, size_t size)
+{
+    void *node = kmalloc(size);
+    if (!node) {
+        ROS_ERROR("ram_dspace could not allocate page table node, procserv out of mem!");
+        return NULL;
+    }
+    memset(node, 0, size);
+    dataspace->bookkeepingBytes += size;
+    return node;
+}
+
+/*! @brief Helper function to free a page table node allocated by ram_dspace_table_alloc().
+    @param dataspace The ram dataspace the node belongs to.
+    @param node The node to free. (Takes ownership)
+    @param size The size of the node in bytes.
+ */
+static void
+ram_dspace_table_free(struct ram_dspace *dataspace, void *node, size_t size)
+{
+    assert(node && dataspace->bookkeepingBytes >= size);
+    kfree(node);
+    dataspace->bookkeepingBytes -= size;
+}
+
+/*! @brief Helper function to look up the page table leaf holding a page.
+    @param dataspace The ram dataspace.
+    @param idx The index of the page.
+    @param create Whether to allocate the leaf and the nodes above it if they don't exist yet.
+    @return The leaf holding the page (No ownership), NULL if there isn't one or on OOM.
+ */
+static struct ram_dspace_leaf *
+ram_dspace_get_leaf(struct ram_dspace *dataspace, uint32_t idx, bool create)
+{
+    assert(idx < RAM_DSPACE_MAX_NPAGES);
+    if (!dataspace->pageTable) {
+        if (!create) {
+            return NULL;
+        }
+        dataspace->pageTable = ram_dspace_table_alloc(dataspace, sizeof(struct ram_dspace_node));
+        if (!dataspace->pageTable) {
+            return NULL;
+        }
+    }
+
+    void **midSlot = &dataspace->pageTable->child[RAM_DSPACE_TOP_INDEX(idx)];
+    if (!(*midSlot)) {
+        if (!create) {
+            return NULL;
+        }
+        (*midSlot) = ram_dspace_table_alloc(dataspace, sizeof(struct ram_dspace_node));
+        if (!(*midSlot)) {
+            return NULL;
+        }
+    }
+
+    struct ram_dspace_node *mid = (struct ram_dspace_node *) (*midSlot);
+    void **leafSlot = &mid->child[RAM_DSPACE_MID_INDEX(idx)];
+    if (!(*leafSlot)) {
+        if (!create) {
+            return NULL;
+        }
+        (*leafSlot) = ram_dspace_table_alloc(dataspace, sizeof(struct ram_dspace_leaf));
+    }
+    return (struct ram_dspace_leaf *) (*leafSlot);
+}
+
+/*! @brief Helper function to look up the frame slot of a page.
+    @param dataspace The ram dataspace.
+    @param idx The index of the page.
+    @param create Whether to allocate the page table leaf for the page if it doesn't exist yet.
+    @return The frame slot of the page (No ownership), NULL if there isn't one or on OOM.
+ */
+static inline vka_object_t *
+ram_dspace_page(struct ram_dspace *dataspace, uint32_t idx, bool create)
+{
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx, create);
+    return leaf ? &leaf->pages[RAM_DSPACE_LEAF_INDEX(idx)] : NULL;
+}
+
+/*! @brief Helper function to get the frame of a page, without allocating anything.
+    @param dataspace The ram dataspace.
+    @param idx The index of the page.
+    @return The 4k frame of the page if it has one, 0 otherwise.
+ */
+static inline seL4_CPtr
+ram_dspace_page_cptr(struct ram_dspace *dataspace, uint32_t idx)
+{
+    vka_object_t *page = ram_dspace_page(dataspace, idx, false);
+    return page ? page->cptr : 0;
+}
+
+/*! @brief Helper function to test the bit of a page in one of its leaf's bitmasks. */
+static inline bool
+ram_dspace_leaf_test(uint32_t *bitmask, uint32_t idx)
+{
+    uint32_t i = RAM_DSPACE_LEAF_INDEX(idx);
+    return (bitmask[i / 32] >> (i % 32)) & 0x1;
+}
+
+/*! @brief Helper function to set or clear the bit of a page in one of its leaf's bitmasks. */
+static inline void
+ram_dspace_leaf_set(uint32_t *bitmask, uint32_t idx, bool set)
+{
+    uint32_t i = RAM_DSPACE_LEAF_INDEX(idx);
+    if (set) {
+        bitmask[i / 32] |= (1 << (i % 32));
+    } else {
+        bitmask[i / 32] &= ~(1 << (i % 32));
+    }
+}
+
 /* --------------------------- RAM dataspace OAT callback functions ----------------------------- */
 
 /*! @brief Dataspace OAT creation callback function.
     
     This callback function is called by the OAT allocation helper library in <data_struct/coat.h>,
     in order to create dataspace objects. Here we malloc some memory for the structure, initialise
-    its data structures, initialise its page array, and mint the dataspace badge capability.
+    its data structures, and mint the dataspace badge capability. The page table starts out empty.
 
     @param oat The parent dataspace list (struct ram_dspace_list*).
     @param id The dataspace ID allocated by the OAT table.
@@ -41,46 +179,162 @@ ram_dspace_oat_create(coat_t *oat, int id, uint32_t arg[COAT_ARGS])
     ndspace->ID = id;
     ndspace->npages = (arg[0] / REFOS_PAGE_SIZE) + ((arg[0] % REFOS_PAGE_SIZE) ? 1 : 0);
     ndspace->ref = 1;
-    ndspace->contentInitBitmask = NULL;
+    ndspace->pageTable = NULL;
     ndspace->contentInitEP.capPtr = 0;
     ndspace->contentInitPID = PID_NULL;
     ndspace->parentList = (struct ram_dspace_list *) oat;
     assert(ndspace->parentList->magic == RAM_DATASPACE_LIST_MAGIC);
 
-    /* Initialise content init list. */
+    /* Initialise content init list and large frame table. */
     cvector_init(&ndspace->contentInitWaitingList);
-
-    /* Create the page array. */
-    ndspace->pages = kmalloc(sizeof(vka_object_t) * ndspace->npages);
-    if (!ndspace->pages) {
-        ROS_ERROR("ram_dspace_oat_create could not allocate page array, procserv out of mem!");
-        goto exit1;
-    }
-    memset(ndspace->pages, 0, sizeof(vka_object_t) * ndspace->npages);
+    chash_init(&ndspace->largePages, 0);
 
     /* Mint the badged capability representing this ram dataspace. */
     ndspace->capability = procserv_mint_badge(RAM_DATASPACE_BADGE_BASE + id);
     if (!ndspace->capability.capPtr) {
         ROS_ERROR("ram_dspace_oat_create could not mint cap!");
-        goto exit2;
+        goto exit1;
     }
 
     return (cvector_item_t) ndspace;
 
     /* Exit stack. */
-exit2:
-    assert(ndspace->pages);
-    free(ndspace->pages);
 exit1:
+    chash_release(&ndspace->largePages);
     free(ndspace);
     return NULL;
 }
 
+/*! @brief Releases a single page of a dataspace, if it has been allocated. Revoking the frame
+           cap also unmaps it from every window the page has been mapped into, but the caller has
+           to drop the windows' vspace book-keeping of it with w_unmap_dspace_page().
+    @param rds The dataspace to free page from.
+    @param i The index of the page to free.
+*/
+static void
+ram_dspace_free_page(struct ram_dspace *rds, uint32_t i)
+{
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(rds, i, false);
+    vka_object_t *page = leaf ? &leaf->pages[RAM_DSPACE_LEAF_INDEX(i)] : NULL;
+    if (!page || !page->cptr) {
+        return;
+    }
+    /* Drop our own persistent mapping of this frame before it goes away. */
+    procserv_frame_unmap_cached(page->cptr);
+    cspacepath_t path;
+    vka_cspace_make_path(&procServ.vka, page->cptr, &path);
+    vka_cnode_revoke(&path);
+    if (rds->physicalAddrEnabled) {
+        /* Frames belong to a device, we do not own this frame. Just delete the cslot. */
+        vka_cnode_delete(&path);
+        vka_cspace_free(&procServ.vka, path.capPtr);
+    } else {
+        /* We do own this anonymous dataspace frame. */
+        vka_free_object(&procServ.vka, page);
+    }
+    memset(page, 0, sizeof(vka_object_t));
+    assert(leaf->count > 0);
+    leaf->count--;
+}
+
+/*! @brief Releases a single large frame of a dataspace, if it has been allocated. Unlike
+           ram_dspace_free_page(), this does not take care of any windows it has been mapped into;
+           they must have been unmapped already.
+    @param rds The dataspace to free the large frame from.
+    @param l The index of the large page to free.
+*/
+static void
+ram_dspace_free_large_page(struct ram_dspace *rds, uint32_t l)
+{
+    vka_object_t *large = (vka_object_t *) chash_get(&rds->largePages, l);
+    if (!large) {
+        return;
+    }
+    assert(large->cptr);
+    procserv_frame_unmap_cached(large->cptr);
+    cspacepath_t path;
+    vka_cspace_make_path(&procServ.vka, large->cptr, &path);
+    vka_cnode_revoke(&path);
+    vka_free_object(&procServ.vka, large);
+    chash_remove(&rds->largePages, l);
+    ram_dspace_table_free(rds, large, sizeof(vka_object_t));
+}
+
+/*! @brief Helper function to take the shared zero frame back from every window it has been mapped
+           into for the given page, if any. Must be called before the page gets a frame.
+    @param dataspace The ram dataspace.
+    @param idx The index of the page.
+ */
+static void
+ram_dspace_zero_unmap(struct ram_dspace *dataspace, uint32_t idx)
+{
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx, false);
+    if (!leaf || !ram_dspace_leaf_test(leaf->zeroMapBitmask, idx)) {
+        return;
+    }
+    ram_dspace_leaf_set(leaf->zeroMapBitmask, idx, false);
+    w_unmap_dspace_page(&procServ.windowList, dataspace, idx * REFOS_PAGE_SIZE);
+}
+
+/*! @brief Releases every page of a dataspace from the given page index onwards, and prunes the
+           page table nodes which no longer cover any page in use.
+    @param rds The dataspace to free the pages of.
+    @param start The index of the first page to free.
+    @param unmapWindows Whether to unmap the freed pages, and the shared zero frame, from every
+                        window they have been mapped into. Not needed when the dataspace has
+                        been unmapped from every window.
+*/
+static void
+ram_dspace_free_pages_from(struct ram_dspace *rds, uint32_t start, bool unmapWindows)
+{
+    struct ram_dspace_node *top = rds->pageTable;
+    if (!top) {
+        return;
+    }
+    for (uint32_t t = 0; t < RAM_DATASPACE_RADIX_SIZE; t++) {
+        struct ram_dspace_node *mid = (struct ram_dspace_node *) top->child[t];
+        if (!mid) {
+            continue;
+        }
+        for (uint32_t m = 0; m < RAM_DATASPACE_RADIX_SIZE; m++) {
+            struct ram_dspace_leaf *leaf = (struct ram_dspace_leaf *) mid->child[m];
+            uint32_t base = ((t << RAM_DATASPACE_RADIX_BITS) | m) << RAM_DATASPACE_LEAF_BITS;
+            if (!leaf || base + RAM_DATASPACE_LEAF_NPAGES <= start) {
+                continue;
+            }
+            for (uint32_t i = MAX(base, start); i < base + RAM_DATASPACE_LEAF_NPAGES; i++) {
+                if (unmapWindows && (leaf->pages[RAM_DSPACE_LEAF_INDEX(i)].cptr ||
+                        ram_dspace_leaf_test(leaf->zeroMapBitmask, i))) {
+                    /* Revoking the frame takes it out of the client page tables, but not out of
+                       their vspace book-keeping, which would then clash with a later mapping. */
+                    w_unmap_dspace_page(&procServ.windowList, rds, i * REFOS_PAGE_SIZE);
+                }
+                ram_dspace_leaf_set(leaf->zeroMapBitmask, i, false);
+                ram_dspace_leaf_set(leaf->contentInitBitmask, i, false);
+                ram_dspace_free_page(rds, i);
+            }
+            if (base >= start) {
+                assert(!leaf->count);
+                ram_dspace_table_free(rds, leaf, sizeof(struct ram_dspace_leaf));
+                mid->child[m] = NULL;
+            }
+        }
+        if ((t << RAM_DSPACE_TOP_SHIFT) >= start) {
+            ram_dspace_table_free(rds, mid, sizeof(struct ram_dspace_node));
+            top->child[t] = NULL;
+        }
+    }
+    if (!start) {
+        ram_dspace_table_free(rds, top, sizeof(struct ram_dspace_node));
+        rds->pageTable = NULL;
+    }
+}
+
 /*! @brief Dataspace OAT deletion callback function.
     
     This callback function is called by the OAT library defined in <data_struct/coat.h>, in order
     to delete dataspace objects created by ram_dspace_oat_create(). It unmaps the dataspace from
-    all mapped windows, frees the caps, cslots, frames & frame arrays, and then the structure 
+    all mapped windows, frees the caps, cslots, frames & page table, and then the structure 
     itself.
 
     @param oat The parent dataspace list (struct ram_dspace_list*).
@@ -109,12 +363,6 @@ ram_dspace_oat_delete(coat_t *oat, cvector_item_t *obj)
         assert(!"RAM dspace hanging reference. Process server bug.");
     }
 
-    /* Free the content initialised bitmask. */
-    if (rds->contentInitBitmask) {
-        kfree(rds->contentInitBitmask);
-        rds->contentInitBitmask = NULL;
-    }
-
     /* Free the content init endpoint & cslot. */
     if (rds->contentInitEnabled) {
         assert(rds->contentInitEP.capPtr);
@@ -139,30 +387,26 @@ ram_dspace_oat_delete(coat_t *oat, cvector_item_t *obj)
     }
     cvector_free(&rds->contentInitWaitingList);
 
-    /* Free the pages. */
-    assert(rds->pages);
-    for (int i = 0; i < rds->npages; i++) {
-        if (rds->pages[i].cptr) {
-            cspacepath_t path;
-            vka_cspace_make_path(&procServ.vka, rds->pages[i].cptr, &path);
-            vka_cnode_revoke(&path);
-            if (rds->physicalAddrEnabled) {
-                /* Frames belong to a device, we do not own this frame. Just delete the cslot. */
-                vka_cnode_delete(&path);
-                vka_cspace_free(&procServ.vka, path.capPtr);
-            } else {
-                /* We do own this anonymous dataspace frame. */
-                vka_free_object(&procServ.vka, &rds->pages[i]);
-            }
-        }
+    /* Free the pages and the page table. The windows have all been unmapped above. */
+    ram_dspace_free_pages_from(rds, 0, false);
+
+    /* Free the large frames. */
+    for (uint32_t l = 0; l < rds->npages / RAM_DATASPACE_LARGE_PAGE_NPAGES; l++) {
+        ram_dspace_free_large_page(rds, l);
     }
-    kfree(rds->pages);
+    assert(!rds->largePages.count && !rds->bookkeepingBytes);
+    chash_release(&rds->largePages);
 
-    /* Free the capability. */
+    /* Free the capabilities. */
     assert(rds->capability.capPtr);
     vka_cnode_revoke(&rds->capability);
     vka_cnode_delete(&rds->capability);
     vka_cspace_free(&procServ.vka, rds->capability.capPtr);
+    if (rds->readOnlyCapability.capPtr) {
+        vka_cnode_revoke(&rds->readOnlyCapability);
+        vka_cnode_delete(&rds->readOnlyCapability);
+        vka_cspace_free(&procServ.vka, rds->readOnlyCapability.capPtr);
+    }
 
     /* Free the actual window structure. */
     free(rds);
@@ -170,14 +414,92 @@ ram_dspace_oat_delete(coat_t *oat, cvector_item_t *obj)
 
 /* ------------------------------- RAM dataspace table functions -------------------------------- */
 
-/*! @brief Calculates the page index into the dataspace based on the nbytes offset.
-    @param nbytes The offset into the ram dataspace.
-    @return The page index into the dataspace.
+/*! @brief Helper function to check whether a page has been mapped to the shared zero frame.
+    @param dataspace The ram dataspace.
+    @param idx The index of the page.
+    @return TRUE if the page has been mapped to the zero frame, FALSE otherwise.
  */
-static inline uint32_t
-ram_dspace_get_index(size_t nbytes)
+static inline bool
+ram_dspace_zero_mapped(struct ram_dspace *dataspace, uint32_t idx)
 {
-    return (uint32_t)(nbytes / REFOS_PAGE_SIZE);
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx, false);
+    return leaf && ram_dspace_leaf_test(leaf->zeroMapBitmask, idx);
+}
+
+/*! @brief Helper function to find the large frame backing a page, if any.
+    @param dataspace The ram dataspace.
+    @param idx The index of the page.
+    @return The large frame object covering the page if there is one, NULL otherwise.
+ */
+static inline vka_object_t *
+ram_dspace_large_frame(struct ram_dspace *dataspace, uint32_t idx)
+{
+    uint32_t l = idx / RAM_DATASPACE_LARGE_PAGE_NPAGES;
+    if (l >= dataspace->npages / RAM_DATASPACE_LARGE_PAGE_NPAGES) {
+        return NULL;
+    }
+    return (vka_object_t *) chash_get(&dataspace->largePages, l);
+}
+
+/*! @brief Helper function to split a large frame back up into 4k frames.
+
+    The large frame is unmapped from every window it has been mapped into first, so its content
+    can't change while it is being copied into the new 4k frames. Clients touching it again fault
+    the new 4k frames in.
+
+    @param dataspace The ram dataspace.
+    @param l The index of the large page to split.
+    @return ESUCCESS if success, refos_err_t otherwise.
+ */
+static int
+ram_dspace_split_large_page(struct ram_dspace *dataspace, uint32_t l)
+{
+    static char pageContent[REFOS_PAGE_SIZE];
+    vka_object_t *large = (vka_object_t *) chash_get(&dataspace->largePages, l);
+    uint32_t idx = l * RAM_DATASPACE_LARGE_PAGE_NPAGES;
+    assert(large && large->cptr);
+
+    w_unmap_dspace_page(&procServ.windowList, dataspace, idx * REFOS_PAGE_SIZE);
+
+    uint32_t i;
+    int error = ESUCCESS;
+    for (i = 0; i < RAM_DATASPACE_LARGE_PAGE_NPAGES; i++) {
+        struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx + i, true);
+        if (!leaf) {
+            error = ENOMEM;
+            break;
+        }
+        vka_object_t *page = &leaf->pages[RAM_DSPACE_LEAF_INDEX(idx + i)];
+        assert(!page->cptr);
+        error = procserv_frame_pool_alloc(page);
+        if (error || !page->cptr) {
+            ROS_ERROR("Could not allocate frame to split large frame. Procserv out of memory.");
+            memset(page, 0, sizeof(vka_object_t));
+            error = ENOMEM;
+            break;
+        }
+        leaf->count++;
+        error = procserv_frame_read_sized(large->cptr, seL4_LargePageBits, pageContent,
+                                          REFOS_PAGE_SIZE, i * REFOS_PAGE_SIZE);
+        if (error == ESUCCESS) {
+            error = procserv_frame_write(page->cptr, pageContent, REFOS_PAGE_SIZE, 0);
+        }
+        if (error != ESUCCESS) {
+            i++;
+            break;
+        }
+    }
+    if (error != ESUCCESS) {
+        /* Keep the content in the large frame, and give back the new frames. */
+        while (i-- > 0) {
+            ram_dspace_free_page(dataspace, idx + i);
+        }
+        return error;
+    }
+
+    ram_dspace_free_large_page(dataspace, l);
+    procServ.faultStats.largePageSplits++;
+    return ESUCCESS;
 }
 
 void
@@ -268,7 +590,7 @@ ram_dspace_check_page(struct ram_dspace *dataspace, uint32_t offset)
         /* Offset of of range. */
         return (seL4_CPtr) 0;
     }
-    return dataspace->pages[idx].cptr;
+    return ram_dspace_page_cptr(dataspace, idx);
 }
 
 seL4_CPtr
@@ -280,7 +602,16 @@ ram_dspace_get_page(struct ram_dspace *dataspace, uint32_t offset)
         /* Offset of of range. */
         return (seL4_CPtr) 0;
     }
-    if (!dataspace->pages[idx].cptr) {
+    if (ram_dspace_large_frame(dataspace, idx) && ram_dspace_split_large_page(dataspace,
+            idx / RAM_DATASPACE_LARGE_PAGE_NPAGES) != ESUCCESS) {
+        return (seL4_CPtr) 0;
+    }
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx, true);
+    if (!leaf) {
+        return (seL4_CPtr) 0;
+    }
+    vka_object_t *page = &leaf->pages[RAM_DSPACE_LEAF_INDEX(idx)];
+    if (!page->cptr) {
         if (dataspace->physicalAddrEnabled) {
             /* Allocate a physical address device memory region frame to fill this page. */
             cspacepath_t deviceFrame = procserv_find_device(
@@ -289,18 +620,113 @@ ram_dspace_get_page(struct ram_dspace *dataspace, uint32_t offset)
                 ROS_WARNING("Could not allocate frame object. No such device.");
                 return (seL4_CPtr) 0;
             }
-            memset(&dataspace->pages[idx], 0, sizeof(vka_object_t));
-            dataspace->pages[idx].cptr = deviceFrame.capPtr;
+            memset(page, 0, sizeof(vka_object_t));
+            page->cptr = deviceFrame.capPtr;
         } else {
             /* Allocate a normal frame to fill this page. */
-            int error = vka_alloc_frame(&procServ.vka, seL4_PageBits, &dataspace->pages[idx]);
-            if (error || !dataspace->pages[idx].cptr) {
+            int error = procserv_frame_pool_alloc(page);
+            if (error || !page->cptr) {
                 ROS_ERROR("Could not allocate frame object. Procserv out of memory.");
+                memset(page, 0, sizeof(vka_object_t));
                 return (seL4_CPtr) 0;
             }
+            ram_dspace_zero_unmap(dataspace, idx);
+        }
+        leaf->count++;
+    }
+    return page->cptr;
+}
+
+seL4_CPtr
+ram_dspace_get_page_read(struct ram_dspace *dataspace, uint32_t offset)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    uint32_t idx = ram_dspace_get_index(offset);
+    if (idx >= dataspace->npages) {
+        /* Offset of of range. */
+        return (seL4_CPtr) 0;
+    }
+    if (ram_dspace_page_cptr(dataspace, idx) || dataspace->physicalAddrEnabled ||
+            dataspace->contentInitEnabled || ram_dspace_large_frame(dataspace, idx)) {
+        return ram_dspace_get_page(dataspace, offset);
+    }
+
+    /* Record that the page has been mapped to the zero frame, so it can be unmapped again when the
+       page gets its own frame. */
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx, true);
+    if (!leaf) {
+        return (seL4_CPtr) 0;
+    }
+    ram_dspace_leaf_set(leaf->zeroMapBitmask, idx, true);
+    return procServ.zeroFrameRO.capPtr;
+}
+
+seL4_CPtr
+ram_dspace_get_large_page(struct ram_dspace *dataspace, uint32_t offset)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    uint32_t nlarge = dataspace->npages / RAM_DATASPACE_LARGE_PAGE_NPAGES;
+    uint32_t l = offset / RAM_DATASPACE_LARGE_PAGE_SIZE;
+    if ((offset % RAM_DATASPACE_LARGE_PAGE_SIZE) || l >= nlarge ||
+            dataspace->physicalAddrEnabled || dataspace->contentInitEnabled) {
+        return (seL4_CPtr) 0;
+    }
+    vka_object_t *large = (vka_object_t *) chash_get(&dataspace->largePages, l);
+    if (large) {
+        return large->cptr;
+    }
+
+    /* The large page can only be backed by a large frame if none of its pages has a frame. */
+    uint32_t idx = l * RAM_DATASPACE_LARGE_PAGE_NPAGES;
+    for (uint32_t i = 0; i < RAM_DATASPACE_LARGE_PAGE_NPAGES; i++) {
+        if (ram_dspace_page_cptr(dataspace, idx + i)) {
+            return (seL4_CPtr) 0;
         }
     }
-    return dataspace->pages[idx].cptr;
+
+    large = ram_dspace_table_alloc(dataspace, sizeof(vka_object_t));
+    if (!large) {
+        return (seL4_CPtr) 0;
+    }
+    int error = vka_alloc_frame(&procServ.vka, seL4_LargePageBits, large);
+    if (error || !large->cptr) {
+        dvprintf("Could not allocate large frame object, falling back to 4k frames.\n");
+        ram_dspace_table_free(dataspace, large, sizeof(vka_object_t));
+        return (seL4_CPtr) 0;
+    }
+    if (chash_set(&dataspace->largePages, l, (chash_item_t) large)) {
+        ROS_ERROR("ram_dspace_get_large_page failed to grow large frame table. Procserv OOM.");
+        vka_free_object(&procServ.vka, large);
+        ram_dspace_table_free(dataspace, large, sizeof(vka_object_t));
+        return (seL4_CPtr) 0;
+    }
+    for (uint32_t i = 0; i < RAM_DATASPACE_LARGE_PAGE_NPAGES; i++) {
+        ram_dspace_zero_unmap(dataspace, idx + i);
+    }
+    return large->cptr;
+}
+
+seL4_CPtr
+ram_dspace_check_large_page(struct ram_dspace *dataspace, uint32_t offset)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    uint32_t idx = ram_dspace_get_index(offset);
+    if (idx >= dataspace->npages) {
+        return (seL4_CPtr) 0;
+    }
+    vka_object_t *large = ram_dspace_large_frame(dataspace, idx);
+    return large ? large->cptr : (seL4_CPtr) 0;
+}
+
+bool
+ram_dspace_is_zero_mapped(struct ram_dspace *dataspace, uint32_t offset)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    uint32_t idx = ram_dspace_get_index(offset);
+    if (idx >= dataspace->npages || ram_dspace_page_cptr(dataspace, idx)) {
+        return false;
+    }
+    return ram_dspace_zero_mapped(dataspace, idx);
 }
 
 struct ram_dspace *
@@ -324,6 +750,23 @@ ram_dspace_get_badge(struct ram_dspace_list *rdslist, seL4_Word badge)
     return ram_dspace_get(rdslist, badge - RAM_DATASPACE_BADGE_BASE);
 }
 
+struct ram_dspace *
+ram_dspace_get_badge_read_only(struct ram_dspace_list *rdslist, seL4_Word badge)
+{
+    return ram_dspace_get(rdslist, badge - RAM_DATASPACE_RO_BADGE_BASE);
+}
+
+seL4_CPtr
+ram_dspace_get_read_only_cap(struct ram_dspace *dataspace)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    if (!dataspace->readOnlyCapability.capPtr) {
+        dataspace->readOnlyCapability = procserv_mint_badge(RAM_DATASPACE_RO_BADGE_BASE +
+                                                            dataspace->ID);
+    }
+    return dataspace->readOnlyCapability.capPtr;
+}
+
 uint32_t
 ram_dspace_get_size(struct ram_dspace *dataspace)
 {
@@ -331,6 +774,14 @@ ram_dspace_get_size(struct ram_dspace *dataspace)
     return dataspace->npages * REFOS_PAGE_SIZE;
 }
 
+uint32_t
+ram_dspace_get_bookkeeping_size(struct ram_dspace *dataspace)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    return sizeof(struct ram_dspace) + dataspace->bookkeepingBytes +
+           dataspace->largePages.tableSize * sizeof(chash_entry_t);
+}
+
 int
 ram_dspace_expand(struct ram_dspace *dataspace, uint32_t size)
 {
@@ -344,33 +795,46 @@ ram_dspace_expand(struct ram_dspace *dataspace, uint32_t size)
         /* Nothing to do here. */
         return ESUCCESS;
     }
-    uint32_t nbitmaskPrev = (dataspace->npages / 32) + 1;
 
-    /* Expand the dataspace. */
-    dataspace->pages = krealloc(dataspace->pages, sizeof(vka_object_t) * npages);
-    if (!dataspace->pages) {
-        ROS_ERROR("ram_dspace_expand could not reallocate page array, procserv out of mem!");
-        return ENOMEM; /* Easier to not clean up, leave extra bit of mem. */
+    /* The page table covers the whole 32-bit range already, nothing else to grow. Pages past the
+       old end have never been touched, so there can't be any state recorded for them. */
+    dataspace->npages = npages;
+    return ESUCCESS;
+}
+
+int
+ram_dspace_resize(struct ram_dspace *dataspace, uint32_t size)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+    uint32_t npages = (size / REFOS_PAGE_SIZE) + ((size % REFOS_PAGE_SIZE) ? 1 : 0);
+    if (npages >= dataspace->npages) {
+        return ram_dspace_expand(dataspace, size);
+    }
+    if (!npages || dataspace->contentInitEnabled || dataspace->physicalAddrEnabled) {
+        /* Contraction of content-initialised and device dataspaces not supported. */
+        return EINVALIDPARAM;
     }
-    uint32_t pageDiff = npages - dataspace->npages;
-    assert(pageDiff);
-    memset(&dataspace->pages[dataspace->npages], 0, sizeof(vka_object_t) * pageDiff);
 
-    /* Expand the dataspace content init mask. */
-    uint32_t nbitmask = (npages / 32) + 1;
-    if (dataspace->contentInitBitmask && nbitmaskPrev < nbitmask) {
-        dataspace->contentInitBitmask = krealloc (
-                dataspace->contentInitBitmask, nbitmask * sizeof(uint32_t)
-        );
-        if (!dataspace->contentInitBitmask) {
-            ROS_ERROR("ram_dspace_expand failed to realloc content init bitmask. Procserv OOM.");
-            return ENOMEM; /* Easier to not clean up, leave extra bit of mem. */
+    /* Release the large frames past the new end, and split the one the new end falls in. */
+    uint32_t nlarge = dataspace->npages / RAM_DATASPACE_LARGE_PAGE_NPAGES;
+    for (uint32_t l = npages / RAM_DATASPACE_LARGE_PAGE_NPAGES; l < nlarge; l++) {
+        if (!ram_dspace_large_frame(dataspace, l * RAM_DATASPACE_LARGE_PAGE_NPAGES)) {
+            continue;
+        }
+        if (l * RAM_DATASPACE_LARGE_PAGE_NPAGES < npages) {
+            int error = ram_dspace_split_large_page(dataspace, l);
+            if (error != ESUCCESS) {
+                return error;
+            }
+            continue;
         }
-        uint32_t bitmaskDiff = nbitmask - nbitmaskPrev;
-        assert(bitmaskDiff > 0);
-        memset(&dataspace->contentInitBitmask[nbitmaskPrev], 0, bitmaskDiff * sizeof(uint32_t));
+        w_unmap_dspace_page(&procServ.windowList, dataspace,
+                            l * RAM_DATASPACE_LARGE_PAGE_SIZE);
+        ram_dspace_free_large_page(dataspace, l);
     }
 
+    /* Release the frames past the new end, along with the page table nodes covering them. */
+    ram_dspace_free_pages_from(dataspace, npages, true);
     dataspace->npages = npages;
     return ESUCCESS;
 }
@@ -390,8 +854,12 @@ ram_dspace_set_to_paddr(struct ram_dspace *dataspace, uint32_t paddr)
 
     /* Check that the dataspace is empty. */
     dprintf("Checking pages...\n");
-    for (int i = 0; i < dataspace->npages; i++) {
-        if (dataspace->pages[i].cptr) {
+    if (dataspace->largePages.count) {
+        ROS_WARNING("Dataspace already has mapped anonymous content.");
+        return EINVALID;
+    }
+    for (int i = 0; dataspace->pageTable && i < dataspace->npages; i++) {
+        if (ram_dspace_page_cptr(dataspace, i) || ram_dspace_zero_mapped(dataspace, i)) {
             ROS_WARNING("Dataspace already has mapped anonymous content.");
             return EINVALID;
         }
@@ -438,6 +906,17 @@ ram_dspace_read_page(char *buf, size_t len, struct ram_dspace *dataspace, uint32
         dvprintf("WARNING: capping at len > PAGE_SIZE - skipBytes.\n");
         len = (REFOS_PAGE_SIZE - skipBytes);
     }
+    seL4_CPtr large = ram_dspace_check_large_page(dataspace, offset);
+    if (large) {
+        return procserv_frame_read_sized(large, seL4_LargePageBits, buf, len,
+                                         offset % RAM_DATASPACE_LARGE_PAGE_SIZE);
+    }
+    if (offset < ram_dspace_get_size(dataspace) && !ram_dspace_check_page(dataspace, offset) &&
+            !dataspace->physicalAddrEnabled) {
+        /* Untouched anonymous memory reads as zeros, no need to allocate a frame for it. */
+        memset(buf, 0, len);
+        return ESUCCESS;
+    }
     seL4_CPtr frame = ram_dspace_get_page(dataspace, offset);
     if (!frame) {
         ROS_ERROR("ram_dspace_read_page failed to allocate page. Procserv out of memory.");
@@ -469,6 +948,11 @@ ram_dspace_write_page(char *buf, size_t len, struct ram_dspace *dataspace, uint3
         dvprintf("WARNING: capping at len > PAGE_SIZE - skipBytes.\n");
         len = (REFOS_PAGE_SIZE - skipBytes);
     }
+    seL4_CPtr large = ram_dspace_check_large_page(dataspace, offset);
+    if (large) {
+        return procserv_frame_write_sized(large, seL4_LargePageBits, buf, len,
+                                          offset % RAM_DATASPACE_LARGE_PAGE_SIZE);
+    }
     seL4_CPtr frame = ram_dspace_get_page(dataspace, offset);
     if (!frame) {
         ROS_ERROR("ram_dataspace_write_page failed to allocate page. Procserv out of memory.");
@@ -542,6 +1026,30 @@ ram_dspace_write(char *buf, size_t len, struct ram_dspace *dataspace, uint32_t o
 
 /* --------------------------- RAM dataspace content init functions ----------------------------- */
 
+/*! @brief Helper function to take the zero frame back from every page mapped to it, and to clear
+           the content provided bits of every page, walking only the populated page table leaves.
+    @param dataspace The ram dataspace.
+ */
+static void
+ram_dspace_content_init_reset(struct ram_dspace *dataspace)
+{
+    struct ram_dspace_node *top = dataspace->pageTable;
+    for (uint32_t t = 0; top && t < RAM_DATASPACE_RADIX_SIZE; t++) {
+        struct ram_dspace_node *mid = (struct ram_dspace_node *) top->child[t];
+        for (uint32_t m = 0; mid && m < RAM_DATASPACE_RADIX_SIZE; m++) {
+            struct ram_dspace_leaf *leaf = (struct ram_dspace_leaf *) mid->child[m];
+            if (!leaf) {
+                continue;
+            }
+            uint32_t base = ((t << RAM_DATASPACE_RADIX_BITS) | m) << RAM_DATASPACE_LEAF_BITS;
+            for (uint32_t i = 0; i < RAM_DATASPACE_LEAF_NPAGES; i++) {
+                ram_dspace_zero_unmap(dataspace, base + i);
+            }
+            memset(leaf->contentInitBitmask, 0, sizeof(leaf->contentInitBitmask));
+        }
+    }
+}
+
 int
 ram_dspace_content_init(struct ram_dspace *dataspace, cspacepath_t initEP, uint32_t initPID)
 {
@@ -553,11 +1061,9 @@ ram_dspace_content_init(struct ram_dspace *dataspace, cspacepath_t initEP, uint3
         return EINVALID;
     }
 
-    /* Free any previous content initialised bitmasks. */
-    if (dataspace->contentInitBitmask) {
-        kfree(dataspace->contentInitBitmask);
-        dataspace->contentInitBitmask = NULL;
-    }
+    /* Pages mapped to the zero frame would no longer read as zeros, and any previously provided
+       content is forgotten about. */
+    ram_dspace_content_init_reset(dataspace);
 
     /* Free any previous content initialisation endpoints. */
     if (dataspace->contentInitEnabled) {
@@ -575,15 +1081,6 @@ ram_dspace_content_init(struct ram_dspace *dataspace, cspacepath_t initEP, uint3
         return ESUCCESS;
     }
 
-    /* Allocate bitmask. */
-    uint32_t nbitmask = (dataspace->npages / 32) + 1;
-    dataspace->contentInitBitmask = kmalloc(nbitmask * sizeof(uint32_t));
-    if (!dataspace->contentInitBitmask) {
-        ROS_ERROR("ram_dspace_content_init failed to malloc content init bitmask. Procserv OOM.");
-        return ENOMEM;
-    }
-    memset(dataspace->contentInitBitmask, 0, nbitmask * sizeof(uint32_t));
-
     /* Clear the waiting list. */
     int waitingListCount = cvector_count(&dataspace->contentInitWaitingList);
     for (int i = 0; i < waitingListCount; i++) {
@@ -607,12 +1104,24 @@ ram_dspace_content_init(struct ram_dspace *dataspace, cspacepath_t initEP, uint3
     return ESUCCESS;
 }
 
+/*! @brief Helper function to check whether the content of a page has been provided. Pages without
+           a page table leaf have never been provided. */
+static inline bool
+ram_dspace_content_provided(struct ram_dspace *dataspace, uint32_t idx)
+{
+    if (idx >= dataspace->npages) {
+        return false;
+    }
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, idx, false);
+    return leaf && ram_dspace_leaf_test(leaf->contentInitBitmask, idx);
+}
+
 int
 ram_dspace_need_content_init(struct ram_dspace *dataspace, uint32_t offset)
 {
     assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
 
-    if (!dataspace->contentInitEnabled || !dataspace->contentInitBitmask) {
+    if (!dataspace->contentInitEnabled) {
         return -EINVALID;
     }
     if (offset > ram_dspace_get_size(dataspace)) {
@@ -620,11 +1129,49 @@ ram_dspace_need_content_init(struct ram_dspace *dataspace, uint32_t offset)
     }
 
     uint32_t npage = (offset / REFOS_PAGE_SIZE);
-    uint32_t idxbitmask = npage / 32;
-    uint32_t idxshift = npage % 32;
     assert(npage <= dataspace->npages);
+    return !ram_dspace_content_provided(dataspace, npage);
+}
 
-    return !((dataspace->contentInitBitmask[idxbitmask] >> idxshift) & 0x1);
+/*! @brief Helper function to check whether any waiter is blocked on the given page. */
+static bool
+ram_dspace_content_init_has_waiter(struct ram_dspace *dataspace, uint32_t npage)
+{
+    int waitingListCount = cvector_count(&dataspace->contentInitWaitingList);
+    for (int i = 0; i < waitingListCount; i++) {
+        struct ram_dspace_waiter *waiter = (struct ram_dspace_waiter *)
+                cvector_get(&dataspace->contentInitWaitingList, i);
+        assert(waiter && waiter->magic == RAM_DATASPACE_WAITER_MAGIC);
+        if (waiter->pageidx == npage) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+ram_dspace_content_init_run(struct ram_dspace *dataspace, uint32_t offset, uint32_t maxPages)
+{
+    assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
+
+    if (!dataspace->contentInitEnabled) {
+        return -EINVALID;
+    }
+
+    uint32_t npage = (offset / REFOS_PAGE_SIZE);
+    uint32_t n = 0;
+    for (; n < maxPages && npage + n < dataspace->npages; n++) {
+        uint32_t idx = npage + n;
+        if (ram_dspace_content_provided(dataspace, idx)) {
+            /* Already provided. */
+            break;
+        }
+        if (n > 0 && ram_dspace_content_init_has_waiter(dataspace, idx)) {
+            /* Already requested by an earlier fault. */
+            break;
+        }
+    }
+    return (int) n;
 }
 
 int
@@ -731,22 +1278,23 @@ ram_dspace_set_content_init_provided(struct ram_dspace *dataspace, uint32_t offs
 {
     assert(dataspace && dataspace->magic == RAM_DATASPACE_MAGIC);
 
-    if (!dataspace->contentInitEnabled || !dataspace->contentInitBitmask) {
+    if (!dataspace->contentInitEnabled) {
         ROS_WARNING("set_content_init_provided called with content init disabled.");
         return;
     }
-    if (offset > ram_dspace_get_size(dataspace)) {
+    if (offset >= ram_dspace_get_size(dataspace)) {
         ROS_WARNING("set_content_init_provided offset out-of-bounds.");
         return;
     }
 
-    uint32_t npage = (offset / REFOS_PAGE_SIZE);
-    uint32_t idxbitmask = npage / 32;
-    uint32_t idxshift = npage % 32;
-    assert(npage <= dataspace->npages);
-
     /* Set the bitmask bit. */
-    dataspace->contentInitBitmask[idxbitmask] |= (1 << idxshift);
+    uint32_t npage = (offset / REFOS_PAGE_SIZE);
+    struct ram_dspace_leaf *leaf = ram_dspace_get_leaf(dataspace, npage, true);
+    if (!leaf) {
+        ROS_ERROR("set_content_init_provided failed to allocate page table. Procserv OOM.");
+        return;
+    }
+    ram_dspace_leaf_set(leaf->contentInitBitmask, npage, true);
 }
 
 
@@ -9,8 +9,18 @@
 
     A dataspace implementation which is backed by physical RAM. Provides methods for creating &
     deleting ram dataspaces, as well as manages reading and writing to them directly. The actual
-    frames objects are lazily allocated. Dataspace objects support shared strong references through
-    refcounting.
+    frames objects are lazily allocated. Until a page is written to, reading it maps a shared
+    read-only zero frame instead of allocating a frame for it. Dataspace objects support shared
+    strong references through refcounting.
+
+    Large-page aligned runs of pages may instead be backed by a single large frame, so that they
+    can be mapped into big windows in one go. A large frame is split back up into 4k frames (by
+    copying its content) whenever one of its pages needs a 4k frame of its own, eg. to be mapped
+    into a window which isn't aligned to it.
+
+    The per-page state of a dataspace is kept in a sparse, fixed depth radix tree indexed by page
+    number, so that a huge mostly untouched dataspace only pays bookkeeping for the ranges which
+    have actually been populated, and a page lookup is always a constant three levels deep.
 */
 
 #ifndef _REFOS_PROCESS_SERVER_SYSTEM_MEMSERV_RAM_DATASPACE_H_
@@ -21,6 +31,7 @@
 #include <sel4/sel4.h>
 #include <data_struct/cvector.h>
 #include <data_struct/coat.h>
+#include <data_struct/chash.h>
 #include <vspace/vspace.h>
 #include "../../common.h"
 
@@ -29,7 +40,35 @@
 #define RAM_DATASPACE_WAITER_MAGIC 0x351095BC
 #define RAM_DATASPACE_INVALID_ID 0
 
+/* Size of a large frame, and the number of pages it covers. */
+#define RAM_DATASPACE_LARGE_PAGE_SIZE (1 << seL4_LargePageBits)
+#define RAM_DATASPACE_LARGE_PAGE_NPAGES (1 << (seL4_LargePageBits - seL4_PageBits))
+
+/* Page table radix tree geometry. Two levels of RADIX_BITS wide inner nodes over leaves of
+   LEAF_NPAGES pages cover a 32-bit dataspace of 4k pages. */
+#define RAM_DATASPACE_RADIX_BITS 7
+#define RAM_DATASPACE_RADIX_SIZE (1 << RAM_DATASPACE_RADIX_BITS)
+#define RAM_DATASPACE_LEAF_BITS 6
+#define RAM_DATASPACE_LEAF_NPAGES (1 << RAM_DATASPACE_LEAF_BITS)
+#define RAM_DATASPACE_LEAF_NWORDS (RAM_DATASPACE_LEAF_NPAGES / 32)
+
+/*! @brief Ram dataspace page table leaf, holding the state of a run of LEAF_NPAGES pages. */
+struct ram_dspace_leaf {
+    vka_object_t pages[RAM_DATASPACE_LEAF_NPAGES]; /*< Has ownership. */
+    uint32_t zeroMapBitmask[RAM_DATASPACE_LEAF_NWORDS]; /*< Mapped to the shared zero frame. */
+    uint32_t contentInitBitmask[RAM_DATASPACE_LEAF_NWORDS]; /*< Content has been provided. */
+    uint32_t count; /*< Number of allocated 4k frames in this leaf. */
+};
+
+/*! @brief Ram dataspace page table inner node. The children of the top level node are inner
+           nodes, and the children of those are leaves. */
+struct ram_dspace_node {
+    void *child[RAM_DATASPACE_RADIX_SIZE]; /*< Has ownership. */
+};
+
 struct ram_dspace_list;
+struct w_window;
+struct proc_dspace_link;
 
 /*! @brief Ram dataspace structure
 
@@ -40,23 +79,31 @@ struct ram_dspace {
     int ID;
     uint32_t magic;
     cspacepath_t capability;
+    cspacepath_t readOnlyCapability; /*< Minted on first use, 0 until then. */
     uint32_t ref;
 
     /* Anonymous RAM frames. */
-    vka_object_t *pages; /*< Has ownership. */
+    struct ram_dspace_node *pageTable; /*< Sparse page table, NULL if empty. Has ownership. */
     uint32_t npages;
+    chash_t largePages; /*< Large page index --> vka_object_t*. Has ownership. */
+    uint32_t bookkeepingBytes; /*< Size of the page table and large frame objects. */
 
     /* Content init state. */
     bool contentInitEnabled;
     cspacepath_t contentInitEP;
     uint32_t contentInitPID; /* No ownership. */
-    uint32_t *contentInitBitmask;
     cvector_t contentInitWaitingList; /* ram_dspace_waiter */
 
     /* Physical device state. */
     bool physicalAddrEnabled;
     uint32_t physicalAddr;
 
+    /* Reverse map of the users of this dataspace, so that purging it doesn't need to look at
+       every window and process in the system. */
+    struct w_window *windows; /*< Anonymous windows on this dataspace. No ownership. */
+    struct proc_dspace_link *paramBufferUsers; /*< No ownership. */
+    struct proc_dspace_link *notificationBufferUsers; /*< No ownership. */
+
     /*! Weak reference to this dataspace's parent. */
     struct ram_dspace_list *parentList; /* No ownership. */
 };
@@ -105,19 +152,64 @@ void ram_dspace_unref(struct ram_dspace_list *rdslist, int ID);
 /*! @brief Checks whether a page in the ram dataspace exists, and finds & returns it if it does.
     @param dataspace The ram dataspace to find and get the page object from.
     @param offset Offset into the ram dataspace.
-    @return CPtr to frame if there's a page at the given offset in the given dataspace,
-            0 otherwise. No ownership transfer.
+    @return CPtr to frame if there's a 4k page at the given offset in the given dataspace,
+            0 otherwise (including pages backed by a large frame). No ownership transfer.
  */
 seL4_CPtr ram_dspace_check_page(struct ram_dspace *dataspace, uint32_t offset);
 
 /*! @brief Retrieves a page at a given offset. If the page hasn't been created, it will be
-           allocated. Note that this does NOT perform content init.
+           allocated. If the page is backed by a large frame, the large frame is split up into 4k
+           frames first. Note that this does NOT perform content init.
     @param dataspace The ram dataspace to get the page object from.
     @param offset Offset into the ram dataspace.
     @return CPtr to frame if success, 0 if offset invalid or out of memory. No ownership transfer.
  */
 seL4_CPtr ram_dspace_get_page(struct ram_dspace *dataspace, uint32_t offset);
 
+/*! @brief Retrieves a page at a given offset to be mapped for reading.
+
+    If an anonymous page hasn't been created yet, the page is not allocated. Instead, the page is
+    recorded as being mapped to the shared zero frame, and the read-only zero frame is returned.
+    When the page is later allocated (eg. on a write fault, see ram_dspace_is_zero_mapped()), the
+    zero frame is unmapped from wherever it was mapped for the page. Pages of device and
+    content-initialised dataspaces are always allocated, as with ram_dspace_get_page().
+
+    @param dataspace The ram dataspace to get the page object from.
+    @param offset Offset into the ram dataspace.
+    @return CPtr to frame if success, 0 if offset invalid or out of memory. No ownership transfer.
+ */
+seL4_CPtr ram_dspace_get_page_read(struct ram_dspace *dataspace, uint32_t offset);
+
+/*! @brief Retrieves the large frame backing the large page at a given offset. If the large page
+           hasn't been created, it will be allocated, as long as none of its pages have been
+           given a 4k frame already.
+
+    Only anonymous dataspaces which are not device or content-initialised ones are backed by
+    large frames. Any of the pages mapped to the shared zero frame are unmapped.
+
+    @param dataspace The ram dataspace to get the large frame from.
+    @param offset Offset into the ram dataspace, aligned to RAM_DATASPACE_LARGE_PAGE_SIZE. The
+                  whole large page must lie within the dataspace.
+    @return CPtr to large frame if success, 0 if the large page can't be backed by a large frame or
+            out of memory. No ownership transfer.
+ */
+seL4_CPtr ram_dspace_get_large_page(struct ram_dspace *dataspace, uint32_t offset);
+
+/*! @brief Checks whether a page in the ram dataspace is backed by a large frame.
+    @param dataspace The ram dataspace to check.
+    @param offset Offset into the ram dataspace.
+    @return CPtr to the large frame covering the given offset, 0 otherwise. No ownership transfer.
+ */
+seL4_CPtr ram_dspace_check_large_page(struct ram_dspace *dataspace, uint32_t offset);
+
+/*! @brief Checks whether a page is currently mapped to the shared zero frame, with no frame of its
+           own yet.
+    @param dataspace The ram dataspace to check.
+    @param offset Offset into the ram dataspace.
+    @return TRUE if the page is mapped to the zero frame, FALSE otherwise.
+ */
+bool ram_dspace_is_zero_mapped(struct ram_dspace *dataspace, uint32_t offset);
+
 /*! @brief Finds a ram dataspace in a ram dataspace list by a dataspace ID.
     @param rdslist The source list of ram dataspaces. (No ownership)
     @param ID The dataspace ID to locate the ram dataspace in the list.
@@ -132,12 +224,35 @@ struct ram_dspace *ram_dspace_get(struct ram_dspace_list *rdslist, int ID);
  */
 struct ram_dspace *ram_dspace_get_badge(struct ram_dspace_list *rdslist, seL4_Word badge);
 
+/*! @brief Finds a ram dataspace in a ram dataspace list by a read-only dataspace badge.
+    @param rdslist The source list of ram dataspaces. (No ownership)
+    @param badge The read-only dataspace badge to locate the ram dataspace in the list.
+    @return The (weak) reference to target ram dataspace if found, NULL otherwise.
+ */
+struct ram_dspace *ram_dspace_get_badge_read_only(struct ram_dspace_list *rdslist,
+                                                  seL4_Word badge);
+
+/*! @brief Get the read-only capability of a ram dataspace, minting it if this is the first time
+           it is asked for. A read-only capability can only be datamapped, and only ever gets
+           mapped read-only, so it is safe to hand out to untrusted readers.
+    @param dataspace The ram dataspace.
+    @return The read-only capability (No ownership), 0 if out of cslots.
+ */
+seL4_CPtr ram_dspace_get_read_only_cap(struct ram_dspace *dataspace);
+
 /*! @brief Returns the size in bytes of the given dataspace. 
     @param dataspace The dataspace to retrieve size for.
     @return Size of the given dataspace in bytes on success, 0 otherwise.
 */
 uint32_t ram_dspace_get_size(struct ram_dspace *dataspace);
 
+/*! @brief Returns the number of bytes of process server heap used to keep track of the given
+           dataspace, including its page table and large frame table, but not its frames.
+    @param dataspace The dataspace to retrieve bookkeeping size for.
+    @return Bookkeeping size of the given dataspace in bytes.
+*/
+uint32_t ram_dspace_get_bookkeeping_size(struct ram_dspace *dataspace);
+
 /*! @brief Expands the given dataspace.
     @param dataspace The dataspace to expand for.
     @param size The new dataspace size.
@@ -145,6 +260,18 @@ uint32_t ram_dspace_get_size(struct ram_dspace *dataspace);
 */
 int ram_dspace_expand(struct ram_dspace *dataspace, uint32_t size);
 
+/*! @brief Resizes the given dataspace, expanding or contracting it.
+
+    Contracting a dataspace releases the frames past the new end back to the process server, which
+    also unmaps them from any windows they were mapped into. Contraction is only supported for
+    anonymous dataspaces that are not content-initialised.
+
+    @param dataspace The dataspace to resize.
+    @param size The new dataspace size. Must be non-zero.
+    @return ESUCCESS on success, refos_error otherwise.
+*/
+int ram_dspace_resize(struct ram_dspace *dataspace, uint32_t size);
+
 /*! @brief Sets the dataspace to start at the given physical address.
 
     Sets the dataspace to start at the given physical address. The following pages of the
@@ -197,6 +324,22 @@ int ram_dspace_content_init(struct ram_dspace *dataspace, cspacepath_t initEP, u
 */
 int ram_dspace_need_content_init(struct ram_dspace *dataspace, uint32_t offset);
 
+/*! @brief Returns the length of the run of pages needing content initialisation at given offset.
+
+    Counts the consecutive pages starting at the given offset which still need content
+    initialisation, so that a whole run of pages may be requested from the content initialiser in
+    a single notification. The run stops at the end of the dataspace, at a page which has already
+    been provided, or at a page which already has a waiter blocked on it (and hence has already
+    been requested).
+
+    @param dataspace The target dataspace.
+    @param offset The offset into the dataspace the run starts at.
+    @param maxPages The maximum length of run to return.
+    @return Number of pages in the run (0 if the page at offset does not need content init), or
+            -refos_error if content init is not enabled for the given dataspace.
+*/
+int ram_dspace_content_init_run(struct ram_dspace *dataspace, uint32_t offset, uint32_t maxPages);
+
 /*! @brief Add a new content-init blocked waiter.
 
     Adds a new content-init waiter at the given offset to this dataspace. When the content
@@ -19,6 +19,39 @@
 
 #define W_INITIAL_SIZE 4
 
+/*! @brief Internal helper function to add a window to the list of windows on its dataspace. */
+static void
+window_dspace_link(struct w_window *window)
+{
+    struct ram_dspace *dspace = window->ramDataspace;
+    assert(dspace && !window->dspaceNext && !window->dspacePrev);
+    window->dspaceNext = dspace->windows;
+    if (dspace->windows) {
+        dspace->windows->dspacePrev = window;
+    }
+    dspace->windows = window;
+}
+
+/*! @brief Internal helper function to remove a window from the list of windows on its dataspace.
+*/
+static void
+window_dspace_unlink(struct w_window *window)
+{
+    struct ram_dspace *dspace = window->ramDataspace;
+    assert(dspace);
+    if (window->dspacePrev) {
+        window->dspacePrev->dspaceNext = window->dspaceNext;
+    } else {
+        assert(dspace->windows == window);
+        dspace->windows = window->dspaceNext;
+    }
+    if (window->dspaceNext) {
+        window->dspaceNext->dspacePrev = window->dspacePrev;
+    }
+    window->dspaceNext = NULL;
+    window->dspacePrev = NULL;
+}
+
 /*! @brief Internal helper function to switch a window between modes.
 
     It will first release all the previous stored mode related objects, and if the window wasn't
@@ -47,9 +80,11 @@ window_switch_mode(struct w_window* window, enum w_window_mode mode)
 
     /* Unreference the associated dataspace. */
     if (window->ramDataspace) {
+        window_dspace_unlink(window);
         ram_dspace_unref(window->ramDataspace->parentList, window->ramDataspace->ID);
         window->ramDataspace = NULL;
         window->ramDataspaceOffset = (vaddr_t) 0;
+        window->ramDataspaceReadOnly = false;
     }
 
     if (window->mode != W_MODE_EMPTY) {
@@ -63,6 +98,8 @@ window_switch_mode(struct w_window* window, enum w_window_mode mode)
             }
         }
     }
+    window->faultAroundNextOffset = (vaddr_t) 0;
+    window->faultAroundNPages = 0;
     window->mode = mode;
 }
 
@@ -219,7 +256,8 @@ w_set_pager_endpoint(struct w_window *window, cspacepath_t endpoint, uint32_t pi
 }
 
 void
-w_set_anon_dspace(struct w_window *window, struct ram_dspace *dspace, vaddr_t offset)
+w_set_anon_dspace(struct w_window *window, struct ram_dspace *dspace, vaddr_t offset,
+                  bool readOnly)
 {
     assert(window && window->magic == W_MAGIC);
     if (!dspace) {
@@ -230,21 +268,60 @@ w_set_anon_dspace(struct w_window *window, struct ram_dspace *dspace, vaddr_t of
     window_switch_mode(window, W_MODE_ANONYMOUS);
     window->ramDataspace = dspace;
     window->ramDataspaceOffset = offset;
+    window->ramDataspaceReadOnly = readOnly;
+    window_dspace_link(window);
     ram_dspace_ref(dspace->parentList, dspace->ID);
 }
 
 void
 w_purge_dspace(struct w_list *wlist, struct ram_dspace *dspace)
 {
-    assert(wlist);
-    for (int i = 1; i < W_MAX_WINDOWS; i++) {
-        struct w_window *window = w_get_window(wlist, i);
-
-        if (window && window->ramDataspace) {
-            if (window->ramDataspace == dspace || (window->ramDataspace->parentList == 
-                    dspace->parentList && window->ramDataspace->ID == dspace->ID)) {
-                /* Set it back to empty. Not that this will unmap the window. */
-                window_switch_mode(window, W_MODE_EMPTY);
+    assert(wlist && dspace);
+    struct w_window *next = NULL;
+    for (struct w_window *window = dspace->windows; window; window = next) {
+        assert(window->magic == W_MAGIC && window->ramDataspace == dspace);
+        next = window->dspaceNext;
+        if (window->parentList == wlist) {
+            /* Set it back to empty. Not that this will unmap the window. */
+            window_switch_mode(window, W_MODE_EMPTY);
+        }
+    }
+}
+
+void
+w_unmap_dspace_page(struct w_list *wlist, struct ram_dspace *dspace, vaddr_t offset)
+{
+    assert(wlist && dspace);
+    offset = REFOS_PAGE_ALIGN(offset);
+    for (struct w_window *window = dspace->windows; window; window = window->dspaceNext) {
+        assert(window->magic == W_MAGIC && window->ramDataspace == dspace);
+        if (window->mode != W_MODE_ANONYMOUS || window->parentList != wlist ||
+                wlist != &procServ.windowList ||
+                offset + REFOS_PAGE_SIZE <= window->ramDataspaceOffset) {
+            continue;
+        }
+        struct proc_pcb* clientPCB = pid_get_pcb(&procServ.PIDList, window->clientOwnerPID);
+        if (!clientPCB) {
+            continue;
+        }
+        struct w_associated_window *aw = w_associate_find_winID(&clientPCB->vspace.windows,
+                                                                window->wID);
+        if (!aw) {
+            continue;
+        }
+
+        /* Unmap the client pages overlapping the page. Unless the dataspace offset of the window
+           is page aligned, this is two client pages, either of which may be mapped to it. */
+        vaddr_t start = REFOS_PAGE_ALIGN(aw->offset);
+        if (offset > window->ramDataspaceOffset) {
+            start += REFOS_PAGE_ALIGN(offset - window->ramDataspaceOffset);
+        }
+        vaddr_t end = REFOS_PAGE_ALIGN(aw->offset) + (offset - window->ramDataspaceOffset) +
+                      REFOS_PAGE_SIZE;
+        for (vaddr_t vaddr = start; vaddr < end && vaddr < aw->offset + aw->size;
+                vaddr += REFOS_PAGE_SIZE) {
+            if (vs_get_frame(&clientPCB->vspace, vaddr).capPtr) {
+                vs_unmap(&clientPCB->vspace, vaddr, 1);
             }
         }
     }
@@ -272,26 +349,6 @@ w_resize_window(struct w_window *window, vaddr_t vaddr, vaddr_t size)
 
 /* -------------------------------- Window Association functions -------------------------------- */
 
-static int
-w_associate_compare(const void * a, const void * b)
-{
-    return ( ((struct w_associated_window*) a)->offset <
-             ((struct w_associated_window*) b)->offset ?
-            -1 : 1
-    );
-}
-
-/*! @brief Updates the window association list by sorting the base address of the window.
-    @param aw The window association list of a process.
- */
-static void
-w_associate_update(struct w_associated_windowlist *aw)
-{
-    assert(aw);
-    qsort(aw->associated, aw->numIndex, sizeof(struct w_associated_window), w_associate_compare);
-    aw->updated = true;
-}
-
 static void
 w_associate_reserve(struct w_associated_windowlist *aw, int num) {
     if (num < aw->associatedVectorSize) {
@@ -329,12 +386,27 @@ w_associate(struct w_associated_windowlist *aw, int winID, vaddr_t offset, vaddr
     if (aw->numIndex >= W_MAX_ASSOCIATED_WINDOWS) {
         return ENOMEM;
     }
-    w_associate_reserve(aw, aw->numIndex + 1    );
-    aw->associated[aw->numIndex].winID = winID;
-    aw->associated[aw->numIndex].offset = offset;
-    aw->associated[aw->numIndex].size = size;
+    w_associate_reserve(aw, aw->numIndex + 1);
+
+    /* Find the first window based above the new one, and insert it there to keep the list
+       sorted. */
+    int startIndex = 0;
+    int endIndex = aw->numIndex;
+    while (startIndex < endIndex) {
+        int currentIndex = (startIndex + endIndex) / 2;
+        if (aw->associated[currentIndex].offset <= offset) {
+            startIndex = currentIndex + 1;
+        } else {
+            endIndex = currentIndex;
+        }
+    }
+    memmove(&aw->associated[startIndex + 1], &aw->associated[startIndex],
+            sizeof(struct w_associated_window) * (aw->numIndex - startIndex));
+    aw->associated[startIndex].winID = winID;
+    aw->associated[startIndex].offset = offset;
+    aw->associated[startIndex].size = size;
     aw->numIndex++;
-    aw->updated = 0;
+    aw->lastFoundIndex = -1;
     return ESUCCESS;
 }
 
@@ -356,10 +428,14 @@ w_unassociate(struct w_associated_windowlist *aw, int winID)
     assert(aw);
     for (int i = 0; i < aw->numIndex; i++) {
         if (aw->associated[i].winID == winID) {
-            aw->associated[i] = aw->associated[--aw->numIndex];
+            /* Close the gap, keeping the list sorted. */
+            aw->numIndex--;
+            memmove(&aw->associated[i], &aw->associated[i + 1],
+                    sizeof(struct w_associated_window) * (aw->numIndex - i));
+            i--;
         }
     }
-    /* Removing something from a sorted list doesn't make it unsorted. */
+    aw->lastFoundIndex = -1;
 }
 
 void
@@ -372,8 +448,7 @@ w_associate_clear(struct w_associated_windowlist *aw)
         aw->associated = NULL;
     }
     aw->associatedVectorSize = 0;
-    /* An empty list is sorted. */
-    aw->updated = true;
+    aw->lastFoundIndex = -1;
     /* Reserve an initial few window spots. */
     w_associate_reserve(aw, W_INITIAL_SIZE);
 }
@@ -401,10 +476,10 @@ w_associate_find_index(struct w_associated_windowlist *aw, vaddr_t addr)
 {
     assert(aw);
 
-    /* Re-sort the list if it's out of date. */
-    if (!aw->updated) {
-        w_associate_update(aw);
-        assert(aw->updated);
+    /* Check the last window found first. */
+    if (aw->lastFoundIndex >= 0 && aw->lastFoundIndex < aw->numIndex &&
+            w_associate_window_contains(&aw->associated[aw->lastFoundIndex], addr)) {
+        return aw->lastFoundIndex;
     }
 
     /* Binary search for the associated window. */
@@ -437,7 +512,11 @@ w_associate_find_index(struct w_associated_windowlist *aw, vaddr_t addr)
         }
     }
 
-    return found ? currentIndex : (-1 - currentIndex);
+    if (!found) {
+        return -1 - currentIndex;
+    }
+    aw->lastFoundIndex = currentIndex;
+    return currentIndex;
 }
 
 struct w_associated_window *
@@ -450,12 +529,7 @@ w_associate_find(struct w_associated_windowlist *aw, vaddr_t addr)
 struct w_associated_window *
 w_associate_find_winID(struct w_associated_windowlist *aw, int winID)
 {
-    /* Re-sort the list if it's out of date. */
-    if (!aw->updated) {
-        w_associate_update(aw);
-        assert(aw->updated);
-    }
-
+    assert(aw);
     for (int i = 0; i < aw->numIndex; i++) {
         if (aw->associated[i].winID == winID) {
             return &aw->associated[i];
@@ -45,6 +45,8 @@
 #define W_PERMISSION_WRITE 0x1
 #define W_PERMISSION_READ 0x2
 #define W_FLAGS_UNCACHED 0x1
+#define W_FLAGS_LARGE_PAGES 0x2
+#define W_FLAGS_NO_LARGE_PAGES 0x4
 
 struct ram_dspace;
 struct w_list;
@@ -82,6 +84,10 @@ struct w_window {
     seL4_Word permissions;
     bool cacheable;
 
+    /*! Whether anonymous memory in this window may be mapped using large frames. Large frames are
+        only used for the large-page aligned parts of the window which fit a whole large frame. */
+    bool largePages;
+
     vspace_t *vspace; /* No ownership. */
     reservation_t reservation; /* Has ownership. */
     cspacepath_t capability;
@@ -93,6 +99,16 @@ struct w_window {
     /*! Ram dataspace. Shared ownership. Valid only if mode is W_MODE_ANONYMOUS */
     struct ram_dspace *ramDataspace;
     vaddr_t ramDataspaceOffset;
+    bool ramDataspaceReadOnly; /*!< Datamapped using a read-only dataspace cap. */
+
+    /*! Links in the dataspace's list of windows on it. Valid only if mode is W_MODE_ANONYMOUS */
+    struct w_window *dspaceNext; /* No ownership. */
+    struct w_window *dspacePrev; /* No ownership. */
+
+    /*! Fault-around state. The window offset a sequential fault is expected at next, and the
+        number of pages to map on that fault. Valid only if mode is W_MODE_ANONYMOUS */
+    vaddr_t faultAroundNextOffset;
+    uint32_t faultAroundNPages;
 };
 
 /*! @brief Window list.
@@ -119,13 +135,15 @@ struct w_associated_window {
 /*! @brief Window association list.
 
     A list of window associations, used to keep track of the list of windows a client has in its
-    vspace.
+    vspace. The list is always kept sorted by window base address, so lookups by address are a
+    binary search. The index of the last window found by address is remembered, since faults tend
+    to come in runs on the same window.
  */
 struct w_associated_windowlist {
     struct w_associated_window *associated;
     uint32_t associatedVectorSize;
     int numIndex;
-    bool updated;
+    int lastFoundIndex; /* -1 if invalid. */
 };
 
 /* --------------------------------------- Window functions ------------------------------------- */
@@ -199,20 +217,35 @@ void w_set_pager_endpoint(struct w_window *window, cspacepath_t endpoint, uint32
                   NULL means clear this window back to empty.
     @param offset Offset into the dataspace at which this window is mapped. Alignment restrictions
                   apply.
+    @param readOnly Whether the dataspace pages must be mapped read-only, whatever the window's own
+                    permissions are.
 */
-void w_set_anon_dspace(struct w_window *window, struct ram_dspace *dspace, vaddr_t offset);
+void w_set_anon_dspace(struct w_window *window, struct ram_dspace *dspace, vaddr_t offset,
+                       bool readOnly);
 
 /*! @brief Notify of the window list of the death of a dataspace.
 
     Notify of the window list of the death of a dataspace. If any windows in the list are found to
     be set to be initialised by the given dataspace, that window will be reset to W_MODE_EMPTY, and
-    the dataspace dereferenced. Potentially does VSpace unmapping operations.
+    the dataspace dereferenced. Potentially does VSpace unmapping operations. Only the windows on
+    the dataspace's own list of windows are looked at.
 
     @param wlist The window list to purge from.
     @param dspace The internal RAM dataspace to purge all references to. (No ownership)
 */
 void w_purge_dspace(struct w_list *wlist, struct ram_dspace *dspace);
 
+/*! @brief Unmap a page of a dataspace from every window in the list it is mapped into.
+
+    Used to take back the shared zero frame wherever it stands in for a dataspace page, once the
+    page gets a frame of its own. Clients touching the page again fault it back in.
+
+    @param wlist The window list to unmap from.
+    @param dspace The internal RAM dataspace the page belongs to. (No ownership)
+    @param offset The offset into the dataspace of the page.
+*/
+void w_unmap_dspace_page(struct w_list *wlist, struct ram_dspace *dspace, vaddr_t offset);
+
 /*! @brief Resize a window. Note that this does not perform any window associate updates or checks,
            nor any vspace operations, simply updates the field in the global window list entry,
            and re-reserves the owned reservation.
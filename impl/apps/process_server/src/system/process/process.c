@@ -76,6 +76,7 @@ exit1:
         vs_delete_window(vs, windowID);
     }
 exit0:
+    procserv_frame_unmap_cached(frame.cptr);
     vka_free_object(&procServ.vka, &frame);
     return error;
 }
@@ -194,6 +195,8 @@ proc_config_new(struct proc_pcb *p, uint32_t pid, uint8_t priority, char *imageN
     p->pid = pid;
     p->paramBuffer = NULL;
     p->notificationBuffer = NULL;
+    p->paramBufferLink.pcb = p;
+    p->notificationBufferLink.pcb = p;
 
     /* Allocate a vspace. */
     dvprintf("Initialising vspace for %s...\n", imageName);
@@ -380,17 +383,11 @@ proc_release(struct proc_pcb *p)
 
     /* Unreference the parameter buffer. */
     dvprintf("    unreffing parameter buffer...\n");
-    if (p->paramBuffer) {
-        ram_dspace_unref(p->paramBuffer->parentList, p->paramBuffer->ID);
-        p->paramBuffer = NULL;
-    }
+    proc_set_parambuffer(p, NULL);
 
     /* Release notification buffer. */
     dvprintf("    releasing notification buffer...\n");
-    if (p->notificationBuffer) {
-        rb_delete(p->notificationBuffer);
-        p->notificationBuffer = NULL;
-    }
+    proc_set_notificationbuffer(p, NULL);
 
     /* Release fault reply cap. */
     dvprintf("    releasing caller EP...\n");
@@ -432,6 +429,35 @@ proc_queue_release(struct proc_pcb *p)
 
 /* ------------------------------- Proc interface helper functions ------------------------------ */
 
+/*! @brief Helper function to add a process to one of a dataspace's lists of buffer users. */
+static void
+proc_dspace_link_add(struct proc_dspace_link **head, struct proc_dspace_link *link)
+{
+    assert(link->pcb && !link->next && !link->prev);
+    link->next = (*head);
+    if (*head) {
+        (*head)->prev = link;
+    }
+    (*head) = link;
+}
+
+/*! @brief Helper function to remove a process from one of a dataspace's lists of buffer users. */
+static void
+proc_dspace_link_remove(struct proc_dspace_link **head, struct proc_dspace_link *link)
+{
+    if (link->prev) {
+        link->prev->next = link->next;
+    } else {
+        assert((*head) == link);
+        (*head) = link->next;
+    }
+    if (link->next) {
+        link->next->prev = link->prev;
+    }
+    link->next = NULL;
+    link->prev = NULL;
+}
+
 void
 proc_set_parambuffer(struct proc_pcb *p, struct ram_dspace *paramBuffer)
 {
@@ -441,12 +467,14 @@ proc_set_parambuffer(struct proc_pcb *p, struct ram_dspace *paramBuffer)
         return;
     } else if (p->paramBuffer != NULL) {
         /* We need to undeference the previous parameter buffer. */
+        proc_dspace_link_remove(&p->paramBuffer->paramBufferUsers, &p->paramBufferLink);
         ram_dspace_unref(p->paramBuffer->parentList, p->paramBuffer->ID);
         p->paramBuffer = NULL;
     }
     if (paramBuffer != NULL) {
         /* Now reference the new parameter buffer. */
         ram_dspace_ref(paramBuffer->parentList, paramBuffer->ID);
+        proc_dspace_link_add(&paramBuffer->paramBufferUsers, &p->paramBufferLink);
     }
     p->paramBuffer = paramBuffer;
 }
@@ -456,6 +484,8 @@ proc_set_notificationbuffer(struct proc_pcb *p, struct ram_dspace *notifBuffer)
 {
     /* Release old notification buffer. */
     if (p->notificationBuffer) {
+        proc_dspace_link_remove(&p->notificationBuffer->dataspace->notificationBufferUsers,
+                                &p->notificationBufferLink);
         rb_delete(p->notificationBuffer);
         p->notificationBuffer = NULL;
     }
@@ -467,34 +497,31 @@ proc_set_notificationbuffer(struct proc_pcb *p, struct ram_dspace *notifBuffer)
         ROS_ERROR("Could not create notification buffer");
         return ENOMEM;
     }
+    proc_dspace_link_add(&notifBuffer->notificationBufferUsers, &p->notificationBufferLink);
     return ESUCCESS;
 }
 
 void
-proc_dspace_delete_callback(struct proc_pcb *p, void *cookie)
+proc_purge_dspace(struct ram_dspace *dspace)
 {
-    assert(p && p->magic == REFOS_PCB_MAGIC);
-    struct ram_dspace *dspace = (struct ram_dspace *) cookie;
     assert(dspace && dspace->magic == RAM_DATASPACE_MAGIC);
 
-    if (p->paramBuffer) {
-        if (p->paramBuffer == dspace || (p->paramBuffer->parentList == dspace->parentList &&
-                p->paramBuffer->ID == dspace->ID)) {
-            /* The process's parameter buffer just got deleted. Unset the process's parambuffer. */
-            proc_set_parambuffer(p, NULL);
-            assert(p->paramBuffer == NULL);
-        }
+    /* Unset the parameter buffer of every process using the dataspace as one. */
+    while (dspace->paramBufferUsers) {
+        struct proc_pcb *p = dspace->paramBufferUsers->pcb;
+        assert(p && p->magic == REFOS_PCB_MAGIC && p->paramBuffer == dspace);
+        proc_set_parambuffer(p, NULL);
+        assert(p->paramBuffer == NULL);
     }
 
-    if (p->notificationBuffer) {
-        if (p->notificationBuffer->dataspace == dspace ||
-                (p->notificationBuffer->dataspace->parentList == dspace->parentList &&
-                 p->notificationBuffer->dataspace->ID == dspace->ID) ) {
-            rb_delete(p->notificationBuffer);
-            p->notificationBuffer = NULL;
-        }
+    /* Release the notification buffer of every process using the dataspace as one. */
+    while (dspace->notificationBufferUsers) {
+        struct proc_pcb *p = dspace->notificationBufferUsers->pcb;
+        assert(p && p->magic == REFOS_PCB_MAGIC && p->notificationBuffer);
+        assert(p->notificationBuffer->dataspace == dspace);
+        proc_set_notificationbuffer(p, NULL);
+        assert(p->notificationBuffer == NULL);
     }
-    
 }
 
 struct proc_tcb *
@@ -521,6 +548,7 @@ proc_save_caller(struct proc_pcb *p)
         vka_cspace_free(&procServ.vka, p->faultReply.capPtr);
         p->faultReply.capPtr = 0;
     }
+    p->faultAddr = 0;
 
     /* Allocate the cslot for reply cap to be saved to. */
     int error = vka_cspace_alloc_path(&procServ.vka, &p->faultReply);
@@ -641,6 +669,7 @@ proc_fault_reply(struct proc_pcb *p)
     vka_cnode_delete(&p->faultReply);
     vka_cspace_free(&procServ.vka, p->faultReply.capPtr);
     p->faultReply.capPtr = 0;
+    p->faultAddr = 0;
 }
 
 static void
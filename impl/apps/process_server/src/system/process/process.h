@@ -37,6 +37,14 @@
 #define PROCESS_PERMISSION_DEVICE_IRQ 0x0002
 #define PROCESS_PERMISSION_DEVICE_IOPORT 0x0004
 
+/*! @brief Link in a dataspace's list of processes using it as a parameter or notification buffer.
+ */
+struct proc_dspace_link {
+    struct proc_dspace_link *next; /* No ownership. */
+    struct proc_dspace_link *prev; /* No ownership. */
+    struct proc_pcb *pcb; /* No ownership. */
+};
+
 /*! @brief Process control block structure.
 
     It stores process related information. It is able to own up to PROCESS_MAX_THREADS threads
@@ -55,9 +63,12 @@ struct proc_pcb {
     struct proc_watch_list clientWatchList;
     struct ram_dspace *paramBuffer; /* Shared ownership. */
     struct rb_buffer *notificationBuffer; /* Has ownership. */
+    struct proc_dspace_link paramBufferLink;
+    struct proc_dspace_link notificationBufferLink;
     uint32_t systemCapabilitiesMask;
 
     cspacepath_t faultReply;
+    vaddr_t faultAddr; /* Address of the fault delegated to a pager, if faultReply is for one. */
     int32_t exitStatus;
 
     uint32_t parentPID; /* No ownership. */
@@ -157,13 +168,12 @@ int proc_set_notificationbuffer(struct proc_pcb *p, struct ram_dspace *notifBuff
 /*! @brief Purge all references to a dataspace.
 
     Purge all references to a dataspace (called on dataspace deletion). This will unset any
-    parameter or notification buffers that have been set to that dataspace. This is to be used with
-    the pid_iterate() function in <process/pid.h>.
+    parameter or notification buffers that have been set to that dataspace. Only the processes on
+    the dataspace's own lists of buffer users are looked at.
 
-    @param p The process check and unset and dataspace from.
-    @param cookie The dataspace ID to purge all references to.
+    @param dspace The dataspace to purge all references to. (No ownership)
 */
-void proc_dspace_delete_callback(struct proc_pcb *p, void *cookie);
+void proc_purge_dspace(struct ram_dspace *dspace);
 
 /*! @brief Get the thread TCB of process at the given threadID.
     @param p The process to get TCB from.
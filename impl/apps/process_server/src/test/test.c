@@ -144,9 +144,18 @@ test_chash(void)
     test_assert(chash_get(&h, 123) == NULL);
     int f = chash_find_free(&h, 100, 200);
     test_assert(f == 123);
+    chash_set(&h, 123, (chash_item_t) 0x3F2);
+    test_assert(chash_find_free(&h, 100, 200) == -1);
+    for (int i = 0; i < 1024; i += 2) {
+        chash_remove(&h, i);
+    }
     for (int i = 0; i < 1024; i++) {
+        test_assert(chash_get(&h, i) == ((i % 2) ? (chash_item_t) 0x3F1 : NULL));
+    }
+    for (int i = 1; i < 1024; i += 2) {
         chash_remove(&h, i);
     }
+    test_assert(h.count == 0);
     chash_release(&h);
     return test_success();
 }
@@ -163,8 +172,23 @@ test_cpool(void)
         test_assert(cpool_check(&p, v) == false);
     }
     cpool_free(&p, 1);
+    test_assert(cpool_check(&p, 1) == true);
     int v = cpool_alloc(&p);
     test_assert(v == 1);
+
+    /* Freeing the high end should reclaim the max obj ID. */
+    for (int i = p.mx - 1; i >= 100; i--) {
+        cpool_free(&p, i);
+        test_assert(cpool_check(&p, i) == true);
+    }
+    test_assert(p.mx == 100);
+    test_assert(cpool_alloc(&p) == 100);
+
+    /* Double free should not hand out the same obj twice. */
+    cpool_free(&p, 50);
+    cpool_free(&p, 50);
+    test_assert(cpool_alloc(&p) == 50);
+    test_assert(cpool_alloc(&p) == 101);
     cpool_release(&p);
     return test_success();
 }
@@ -273,6 +297,26 @@ test_nameserv_lib(void)
     test_assert(n == 10);
     test_assert(anonCap == 0x12345);
 
+    /* Test many names, more than there are hash buckets. */
+    char name[32];
+    for (int i = 0; i < REFOS_NAMESERV_HASH_SIZE * 2; i++) {
+        snprintf(name, 32, "many_test_%d", i);
+        error = nameserv_add(&ns, name, 0x12345);
+        test_assert(error == ESUCCESS);
+    }
+    for (int i = 0; i < REFOS_NAMESERV_HASH_SIZE * 2; i++) {
+        snprintf(name, 32, "/many_test_%d/foo.txt", i);
+        anonCap = 0;
+        n = nameserv_resolve(&ns, name, &anonCap);
+        test_assert(n == (int) (strlen(name) - strlen("/foo.txt")));
+        test_assert(anonCap == 0x12345);
+    }
+    nameserv_delete(&ns, "many_test_7");
+    n = nameserv_resolve(&ns, "many_test_7/foo.txt", NULL);
+    test_assert(n == 0);
+    n = nameserv_resolve(&ns, "many_test_/foo.txt", NULL);
+    test_assert(n == 0);
+
     nameserv_release(&ns);
     return test_success();
 }
@@ -301,6 +345,12 @@ test_run_all(void)
     test_window_associations();
     test_ram_dspace_list();
     test_ram_dspace_read_write();
+    test_frame_map_cache();
+    test_frame_pool();
+    test_ram_dspace_zero_frame();
+    test_ram_dspace_large_page();
+    test_ram_dspace_page_table();
+    test_ram_dspace_window_rmap();
     test_proc_client_watch();
     test_ram_dspace_content_init();
     test_nameserv_lib();
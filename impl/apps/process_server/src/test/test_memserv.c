@@ -79,13 +79,14 @@ test_window_associations(void)
     w_associate(&aw, 5, 500, 10);
     
 #if REFOS_TEST_VERBOSE_PRINT
-    tvprintf("------- Unsorted window list \n");
-    w_associate_print(&aw);
-    
     tvprintf("------- Sorted window list \n");
-    w_associate_find(&aw, (vaddr_t) 0);
     w_associate_print(&aw);
 #endif
+
+    /* The list should be kept sorted as windows are associated. */
+    for (int i = 0; i < 5; i++) {
+        test_assert(aw.associated[i].winID == i + 1);
+    }
     
     /* Associate some windows, and test window conflict checking with icky window
        boundary vaddr cases. */
@@ -127,6 +128,17 @@ test_window_associations(void)
         test_assert(foundWinID == expectedFindRangeResult[i]);
     }
 
+    /* Unassociating a window should keep the list sorted, and drop the last found window. */
+    test_assert(w_associate_find(&aw, 305) && aw.lastFoundIndex == 2);
+    w_unassociate(&aw, 3);
+    test_assert(aw.numIndex == 4);
+    test_assert(w_associate_find(&aw, 305) == NULL);
+    for (int i = 1; i < aw.numIndex; i++) {
+        test_assert(aw.associated[i - 1].offset < aw.associated[i].offset);
+    }
+    foundWin = w_associate_find(&aw, 405);
+    test_assert(foundWin && foundWin->winID == 4);
+
     /* Test that clearing window association list actually clears. */
     w_associate_clear(&aw);
     for (int i = 0; i < numTestWin; i++) {
@@ -342,6 +354,280 @@ test_ram_dspace_read_write(void)
     return test_success();
 }
 
+int
+test_frame_map_cache(void)
+{
+    test_start("frame map cache");
+    struct procserv_frame_map_cache *fc = &procServ.frameMapCache;
+    const int npages = CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE + 4;
+    struct ram_dspace_list rlist;
+    ram_dspace_init(&rlist);
+
+    struct ram_dspace *testDSpace = ram_dspace_create(&rlist, npages * REFOS_PAGE_SIZE);
+    test_assert(testDSpace != NULL);
+
+    /* Touch more pages than the cache holds, so the first few get evicted. */
+    for (int i = 0; i < npages; i++) {
+        uint32_t val = 0xC0FFEE00 + i;
+        int error = ram_dspace_write((char*) &val, sizeof(uint32_t), testDSpace,
+                                     i * REFOS_PAGE_SIZE);
+        test_assert(error == ESUCCESS);
+    }
+
+    /* Reading the most recently written page back should hit the cache, and evicted pages should
+       still read back correctly after being remapped. */
+    uint32_t hits = fc->hits;
+    uint32_t val = 0;
+    int error = ram_dspace_read((char*) &val, sizeof(uint32_t), testDSpace,
+                                (npages - 1) * REFOS_PAGE_SIZE);
+    test_assert(error == ESUCCESS);
+    test_assert(val == 0xC0FFEE00 + npages - 1);
+    test_assert(fc->hits == hits + 1);
+    for (int i = 0; i < npages; i++) {
+        error = ram_dspace_read((char*) &val, sizeof(uint32_t), testDSpace, i * REFOS_PAGE_SIZE);
+        test_assert(error == ESUCCESS);
+        test_assert(val == 0xC0FFEE00 + i);
+    }
+
+    /* Deleting the dataspace should drop all of its frames from the cache. */
+    seL4_CPtr lastFrame = ram_dspace_check_page(testDSpace, (npages - 1) * REFOS_PAGE_SIZE);
+    test_assert(lastFrame);
+    ram_dspace_deinit(&rlist);
+    for (int i = 0; i < CONFIG_PROCSERV_FRAME_MAP_CACHE_SIZE; i++) {
+        test_assert(fc->entry[i].frame != lastFrame || !fc->entry[i].vaddr);
+    }
+
+    return test_success();
+}
+
+int
+test_frame_pool(void)
+{
+    test_start("frame pool");
+    struct procserv_frame_pool *fp = &procServ.framePool;
+    procserv_frame_pool_refill(CONFIG_PROCSERV_FRAME_POOL_SIZE);
+    test_assert(fp->count == CONFIG_PROCSERV_FRAME_POOL_SIZE);
+
+    /* Allocating should take ready frames from the pool while there are any. */
+    vka_object_t frames[CONFIG_PROCSERV_FRAME_POOL_SIZE + 1];
+    uint32_t hits = fp->hits;
+    uint32_t misses = fp->misses;
+    for (int i = 0; i < CONFIG_PROCSERV_FRAME_POOL_SIZE + 1; i++) {
+        int error = procserv_frame_pool_alloc(&frames[i]);
+        test_assert(error == ESUCCESS && frames[i].cptr);
+    }
+    test_assert(fp->count == 0);
+    test_assert(fp->hits == hits + CONFIG_PROCSERV_FRAME_POOL_SIZE);
+    test_assert(fp->misses == misses + 1);
+
+    /* Pool frames should read as zeros. */
+    uint32_t val = 0xFFFFFFFF;
+    int error = procserv_frame_read(frames[0].cptr, (char*) &val, sizeof(uint32_t), 0);
+    test_assert(error == ESUCCESS && val == 0);
+    for (int i = 0; i < CONFIG_PROCSERV_FRAME_POOL_SIZE + 1; i++) {
+        procserv_frame_unmap_cached(frames[i].cptr);
+        vka_free_object(&procServ.vka, &frames[i]);
+    }
+
+    /* Refilling should be bounded by the given batch size. */
+    test_assert(procserv_frame_pool_refill(1) == 1 && fp->count == 1);
+    procserv_frame_pool_refill(CONFIG_PROCSERV_FRAME_POOL_SIZE);
+    test_assert(fp->count == CONFIG_PROCSERV_FRAME_POOL_SIZE);
+    return test_success();
+}
+
+int
+test_ram_dspace_zero_frame(void)
+{
+    test_start("ram dataspace zero frame");
+    const int npages = 4;
+    struct ram_dspace_list rlist;
+    ram_dspace_init(&rlist);
+
+    struct ram_dspace *testDSpace = ram_dspace_create(&rlist, npages * REFOS_PAGE_SIZE);
+    test_assert(testDSpace != NULL);
+    test_assert(procServ.zeroFrameRO.capPtr);
+
+    /* Untouched pages should read as zeros, and get the zero frame, without being allocated. */
+    uint32_t val = 0xFFFFFFFF;
+    int error = ram_dspace_read((char*) &val, sizeof(uint32_t), testDSpace, REFOS_PAGE_SIZE);
+    test_assert(error == ESUCCESS);
+    test_assert(val == 0);
+    test_assert(ram_dspace_check_page(testDSpace, REFOS_PAGE_SIZE) == 0);
+    test_assert(!ram_dspace_is_zero_mapped(testDSpace, REFOS_PAGE_SIZE));
+    for (int i = 0; i < npages; i++) {
+        seL4_CPtr frame = ram_dspace_get_page_read(testDSpace, i * REFOS_PAGE_SIZE);
+        test_assert(frame == procServ.zeroFrameRO.capPtr);
+        test_assert(ram_dspace_check_page(testDSpace, i * REFOS_PAGE_SIZE) == 0);
+        test_assert(ram_dspace_is_zero_mapped(testDSpace, i * REFOS_PAGE_SIZE));
+    }
+
+    /* Writing to a page should give it its own frame. */
+    val = 0xC0FFEE;
+    error = ram_dspace_write((char*) &val, sizeof(uint32_t), testDSpace, 2 * REFOS_PAGE_SIZE);
+    test_assert(error == ESUCCESS);
+    seL4_CPtr frame = ram_dspace_check_page(testDSpace, 2 * REFOS_PAGE_SIZE);
+    test_assert(frame && frame != procServ.zeroFrameRO.capPtr);
+    test_assert(!ram_dspace_is_zero_mapped(testDSpace, 2 * REFOS_PAGE_SIZE));
+    test_assert(ram_dspace_get_page_read(testDSpace, 2 * REFOS_PAGE_SIZE) == frame);
+    test_assert(ram_dspace_is_zero_mapped(testDSpace, 3 * REFOS_PAGE_SIZE));
+
+    /* Expanding the dataspace should leave the new pages untouched. */
+    error = ram_dspace_expand(testDSpace, 40 * REFOS_PAGE_SIZE);
+    test_assert(error == ESUCCESS);
+    test_assert(!ram_dspace_is_zero_mapped(testDSpace, 39 * REFOS_PAGE_SIZE));
+    test_assert(ram_dspace_is_zero_mapped(testDSpace, 3 * REFOS_PAGE_SIZE));
+
+    ram_dspace_deinit(&rlist);
+    return test_success();
+}
+
+int
+test_ram_dspace_large_page(void)
+{
+    test_start("ram dataspace large page");
+    struct ram_dspace_list rlist;
+    ram_dspace_init(&rlist);
+
+    struct ram_dspace *testDSpace = ram_dspace_create(&rlist,
+            2 * RAM_DATASPACE_LARGE_PAGE_SIZE + REFOS_PAGE_SIZE);
+    test_assert(testDSpace != NULL);
+
+    /* Only aligned large pages which lie entirely within the dataspace get a large frame. */
+    test_assert(ram_dspace_get_large_page(testDSpace, REFOS_PAGE_SIZE) == 0);
+    test_assert(ram_dspace_get_large_page(testDSpace, 2 * RAM_DATASPACE_LARGE_PAGE_SIZE) == 0);
+    test_assert(ram_dspace_check_large_page(testDSpace, 0) == 0);
+
+    /* A large page with a 4k frame in it can't be backed by a large frame. */
+    uint32_t val = 0xC0FFEE;
+    int error = ram_dspace_write((char*) &val, sizeof(uint32_t), testDSpace,
+                                 RAM_DATASPACE_LARGE_PAGE_SIZE + REFOS_PAGE_SIZE);
+    test_assert(error == ESUCCESS);
+    test_assert(ram_dspace_get_large_page(testDSpace, RAM_DATASPACE_LARGE_PAGE_SIZE) == 0);
+
+    seL4_CPtr large = ram_dspace_get_large_page(testDSpace, 0);
+    test_assert(large != 0);
+
+    /* Reads and writes should go straight to the large frame. */
+    test_assert(ram_dspace_get_large_page(testDSpace, 0) == large);
+    test_assert(ram_dspace_check_large_page(testDSpace, 3 * REFOS_PAGE_SIZE) == large);
+    test_assert(ram_dspace_check_page(testDSpace, 3 * REFOS_PAGE_SIZE) == 0);
+    val = 0xBEEF;
+    error = ram_dspace_write((char*) &val, sizeof(uint32_t), testDSpace,
+                             3 * REFOS_PAGE_SIZE + 8);
+    test_assert(error == ESUCCESS);
+    test_assert(ram_dspace_check_page(testDSpace, 3 * REFOS_PAGE_SIZE) == 0);
+
+    /* Getting a 4k frame should split up the large frame, keeping its content. */
+    uint32_t splits = procServ.faultStats.largePageSplits;
+    seL4_CPtr frame = ram_dspace_get_page(testDSpace, REFOS_PAGE_SIZE);
+    test_assert(frame != 0);
+    test_assert(procServ.faultStats.largePageSplits == splits + 1);
+    test_assert(ram_dspace_check_large_page(testDSpace, 0) == 0);
+    test_assert(ram_dspace_check_page(testDSpace, 3 * REFOS_PAGE_SIZE) != 0);
+    val = 0;
+    error = ram_dspace_read((char*) &val, sizeof(uint32_t), testDSpace,
+                            3 * REFOS_PAGE_SIZE + 8);
+    test_assert(error == ESUCCESS);
+    test_assert(val == 0xBEEF);
+
+    ram_dspace_deinit(&rlist);
+    return test_success();
+}
+
+int
+test_ram_dspace_page_table(void)
+{
+    test_start("ram dataspace sparse page table");
+    struct ram_dspace_list rlist;
+    ram_dspace_init(&rlist);
+
+    /* A huge untouched dataspace should cost no more bookkeeping than a tiny one. */
+    struct ram_dspace *smallDSpace = ram_dspace_create(&rlist, REFOS_PAGE_SIZE);
+    struct ram_dspace *testDSpace = ram_dspace_create(&rlist, 0x40000000);
+    test_assert(smallDSpace != NULL && testDSpace != NULL);
+    uint32_t emptySize = ram_dspace_get_bookkeeping_size(testDSpace);
+    test_assert(emptySize == ram_dspace_get_bookkeeping_size(smallDSpace));
+
+    /* Touching pages far apart should only populate the page table around them. */
+    const uint32_t offsets[] = {0, 0x3FFFF000, 0x12345000};
+    for (int i = 0; i < 3; i++) {
+        uint32_t val = 0xC0FFEE00 + i;
+        int error = ram_dspace_write((char*) &val, sizeof(uint32_t), testDSpace, offsets[i]);
+        test_assert(error == ESUCCESS);
+    }
+    uint32_t usedSize = ram_dspace_get_bookkeeping_size(testDSpace);
+    test_assert(usedSize > emptySize);
+    test_assert(usedSize - emptySize < 3 * (2 * sizeof(struct ram_dspace_node) +
+            sizeof(struct ram_dspace_leaf)));
+    for (int i = 0; i < 3; i++) {
+        uint32_t val = 0;
+        int error = ram_dspace_read((char*) &val, sizeof(uint32_t), testDSpace, offsets[i]);
+        test_assert(error == ESUCCESS);
+        test_assert(val == 0xC0FFEE00 + i);
+        test_assert(ram_dspace_check_page(testDSpace, offsets[i]) != 0);
+        test_assert(ram_dspace_check_page(testDSpace, offsets[i] + REFOS_PAGE_SIZE) == 0);
+    }
+
+    /* Shrinking the dataspace should give back the page table past the new end. */
+    int error = ram_dspace_resize(testDSpace, 0x20000000);
+    test_assert(error == ESUCCESS);
+    test_assert(ram_dspace_get_bookkeeping_size(testDSpace) < usedSize);
+    test_assert(ram_dspace_check_page(testDSpace, offsets[2]) != 0);
+    error = ram_dspace_expand(testDSpace, 0x40000000);
+    test_assert(error == ESUCCESS);
+    test_assert(ram_dspace_check_page(testDSpace, offsets[1]) == 0);
+
+    ram_dspace_deinit(&rlist);
+    return test_success();
+}
+
+int
+test_ram_dspace_window_rmap(void)
+{
+    test_start("ram dataspace window reverse map");
+    struct w_list wlist;
+    struct ram_dspace_list rlist;
+    w_init(&wlist);
+    ram_dspace_init(&rlist);
+
+    struct ram_dspace *testDSpace = ram_dspace_create(&rlist, 4 * REFOS_PAGE_SIZE);
+    test_assert(testDSpace != NULL);
+    test_assert(testDSpace->windows == NULL);
+
+    /* Windows set to the dataspace should show up on its list of windows. */
+    struct w_window *w[3];
+    for (int i = 0; i < 3; i++) {
+        reservation_t tempr;
+        memset(&tempr, 0, sizeof(reservation_t));
+        w[i] = w_create_window(&wlist, 4 * REFOS_PAGE_SIZE, -1, 0, NULL, tempr, true);
+        test_assert(w[i]);
+        w_set_anon_dspace(w[i], testDSpace, 0, false);
+    }
+    test_assert(testDSpace->ref == 4);
+    test_assert(testDSpace->windows == w[2] && w[2]->dspaceNext == w[1]);
+    test_assert(w[1]->dspaceNext == w[0] && w[0]->dspaceNext == NULL);
+
+    /* Emptying a window should take it off the list. */
+    w_set_anon_dspace(w[1], NULL, 0, false);
+    test_assert(testDSpace->ref == 3);
+    test_assert(w[1]->dspaceNext == NULL && w[1]->dspacePrev == NULL);
+    test_assert(testDSpace->windows == w[2] && w[2]->dspaceNext == w[0]);
+    test_assert(w[0]->dspacePrev == w[2]);
+
+    /* Purging the dataspace should empty exactly the windows on it. */
+    w_purge_dspace(&wlist, testDSpace);
+    test_assert(testDSpace->windows == NULL);
+    test_assert(testDSpace->ref == 1);
+    for (int i = 0; i < 3; i++) {
+        test_assert(w[i]->mode == W_MODE_EMPTY && w[i]->ramDataspace == NULL);
+    }
+
+    ram_dspace_deinit(&rlist);
+    w_deinit(&wlist);
+    return test_success();
+}
+
 int
 test_ram_dspace_content_init(void)
 {
@@ -368,6 +654,10 @@ test_ram_dspace_content_init(void)
     error = ram_dspace_content_init(dspace, dummyEP, 0x54);
     test_assert(error == ESUCCESS);
 
+    /* Test content-init run length. */
+    test_assert(ram_dspace_content_init_run(dspace, 0, npages + 4) == npages);
+    test_assert(ram_dspace_content_init_run(dspace, 0x2000, 3) == 3);
+
     /* Test content-init bit. */
     error = ram_dspace_need_content_init(dspace, npages * REFOS_PAGE_SIZE + 0x35);
     test_assert(error == -EINVALIDPARAM);
@@ -377,6 +667,9 @@ test_ram_dspace_content_init(void)
         ram_dspace_set_content_init_provided(dspace,i * REFOS_PAGE_SIZE);
         val = ram_dspace_need_content_init(dspace, i * REFOS_PAGE_SIZE);
         test_assert(val == false);
+        test_assert(ram_dspace_content_init_run(dspace, 0, npages) == 0);
+        test_assert(ram_dspace_content_init_run(dspace, (i + 1) * REFOS_PAGE_SIZE, npages) ==
+                    npages - i - 1);
     }
 
     /* Test waiter. */
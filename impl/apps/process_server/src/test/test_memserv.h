@@ -20,6 +20,14 @@ int test_ram_dspace_list(void);
 
 int test_ram_dspace_read_write(void);
 
+int test_frame_map_cache(void);
+int test_frame_pool(void);
+
+int test_ram_dspace_zero_frame(void);
+int test_ram_dspace_large_page(void);
+int test_ram_dspace_page_table(void);
+int test_ram_dspace_window_rmap(void);
+
 int test_ram_dspace_content_init(void);
 
 int test_ringbuffer(void);
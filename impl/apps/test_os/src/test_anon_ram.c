@@ -10,6 +10,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <refos-util/cspace.h>
+#include <refos-util/walloc.h>
 #include "test_anon_ram.h"
 
 
@@ -47,10 +49,69 @@ test_anon_dspace()
     return test_success();
 }
 
+static int
+test_anon_dspace_read_only()
+{
+    test_start("anon dataspace read-only cap");
+
+    /* Open an anonymous dataspace, map it writable and fill it in. */
+    data_mapping_t anon = data_open_map(REFOS_PROCSERV_EP, "anon", 0x0, 0, 0x2000, -1);
+    test_assert(anon.err == ESUCCESS);
+    strcpy(anon.vaddr, "read-only hello");
+    strcpy(anon.vaddr + REFOS_PAGE_SIZE, "second page");
+
+    /* Get a read-only cap to it. Only the full dataspace cap may be used for this. */
+    refos_err_t error = EINVALID;
+    seL4_CPtr roDspace = proc_get_dspace_read_only(anon.dataspace, &error);
+    test_assert(error == ESUCCESS && roDspace);
+    error = EINVALID;
+    seL4_CPtr roDspace2 = proc_get_dspace_read_only(roDspace, &error);
+    test_assert(error == EINVALIDPARAM && !roDspace2);
+
+    /* The read-only cap may not be used to modify the dataspace. */
+    test_assert(data_expand(REFOS_PROCSERV_EP, roDspace, 0x3000) != ESUCCESS);
+    test_assert(data_get_size(REFOS_PROCSERV_EP, anon.dataspace) == 0x2000);
+
+    /* Datamap it into a second window through the read-only cap, and read it back. */
+    seL4_CPtr roWindow = 0;
+    char *roVaddr = (char*) walloc(2, &roWindow);
+    test_assert(roVaddr && roWindow);
+    error = data_datamap(REFOS_PROCSERV_EP, roDspace, roWindow, 0);
+    test_assert(error == ESUCCESS);
+    test_assert(strcmp(roVaddr, "read-only hello") == 0);
+    test_assert(strcmp(roVaddr + REFOS_PAGE_SIZE, "second page") == 0);
+
+    /* Both windows share the same frames, so writes through the writable one show up. */
+    strcpy(anon.vaddr, "updated hello");
+    test_assert(strcmp(roVaddr, "updated hello") == 0);
+
+    /* The window is marked read-only: asking for its dataspace hands back the read-only cap,
+       which again may not be used to modify the dataspace. A write through roVaddr would be a
+       segmentation fault which blocks this thread, so it is not exercised here. */
+    error = EINVALID;
+    seL4_CPtr windowDspace = proc_get_mem_window_dspace(roWindow, &error);
+    test_assert(error == ESUCCESS && windowDspace);
+    test_assert(data_expand(REFOS_PROCSERV_EP, windowDspace, 0x3000) != ESUCCESS);
+    error = EINVALID;
+    roDspace2 = proc_get_dspace_read_only(windowDspace, &error);
+    test_assert(error == EINVALIDPARAM && !roDspace2);
+    csfree_delete(windowDspace);
+
+    /* Clean up. */
+    error = data_dataunmap(REFOS_PROCSERV_EP, roWindow);
+    test_assert(error == ESUCCESS);
+    walloc_free((seL4_Word) roVaddr, 2);
+    csfree_delete(roDspace);
+    error = data_mapping_release(anon);
+    test_assert(error == ESUCCESS);
+    return test_success();
+}
+
 void
 test_anon_dataspace(void)
 {
     test_anon_dspace();
+    test_anon_dspace_read_only();
 }
 
 #endif /* CONFIG_REFOS_RUN_TESTS */
@@ -244,6 +244,54 @@ test_process_server_window_resize(void)
     return test_success();
 }
 
+static int
+test_process_server_window_dspace_resize(void)
+{
+    test_start("process server memwindow + dataspace resize");
+    seL4_Word testBase = 0x20000000;
+    int error;
+
+    seL4_CPtr window = proc_create_mem_window(testBase, 0x1000);
+    test_assert(window && ROS_ERRNO() == ESUCCESS);
+
+    /* Resizing a window with no anon dataspace mapped should fail. */
+    error = proc_resize_mem_window_dspace(window, 0x2000);
+    test_assert(error == EINVALIDPARAM);
+
+    seL4_CPtr dspace = data_open(REFOS_PROCSERV_EP, "anon", 0, 0, 0x1000, &error);
+    test_assert(dspace && error == ESUCCESS);
+    error = data_datamap(REFOS_PROCSERV_EP, dspace, window, 0);
+    test_assert(error == ESUCCESS);
+
+    /* Grow both the window and dataspace, and touch the new pages. */
+    error = proc_resize_mem_window_dspace(window, 0x3000);
+    test_assert(error == ESUCCESS);
+    test_assert(data_get_size(REFOS_PROCSERV_EP, dspace) == 0x3000);
+    char *mem = (char *) testBase;
+    mem[0x2FFF] = 'R';
+    test_assert(mem[0x2FFF] == 'R');
+
+    /* Shrink both again. */
+    error = proc_resize_mem_window_dspace(window, 0x1000);
+    test_assert(error == ESUCCESS);
+    test_assert(data_get_size(REFOS_PROCSERV_EP, dspace) == 0x1000);
+
+    /* Zero size and invalid windows are not allowed. */
+    error = proc_resize_mem_window_dspace(window, 0);
+    test_assert(error == EINVALIDPARAM);
+    error = proc_resize_mem_window_dspace(0x0, 0x2000);
+    test_assert(error == EINVALIDWINDOW);
+
+    error = proc_delete_mem_window(window);
+    test_assert(error == ESUCCESS);
+    error = data_close(REFOS_PROCSERV_EP, dspace);
+    test_assert(error == ESUCCESS);
+    csfree_delete(dspace);
+    csfree_delete(window);
+
+    return test_success();
+}
+
 static int
 test_process_server_param_buffer(void)
 {
@@ -305,7 +353,7 @@ test_process_server_nameserv(void)
     test_assert(mp.serverAnon == 0);
 
     /* We now unregister ourselves. */
-    error = nsv_unregister(REFOS_NAMESERV_EP, testServerName);
+    error = nsv_unregister_server(REFOS_NAMESERV_EP, testServerName);
     test_assert(error == ESUCCESS);
 
     /* We should not be able to find this server again. */
@@ -318,6 +366,84 @@ test_process_server_nameserv(void)
     return test_success();
 }
 
+static int
+test_process_server_nameserv_cache(void)
+{
+    test_start("process server resolve cache");
+    int error;
+    nsv_mountpoint_t mp;
+    char *testServerName = "os_test_cache_server";
+    char *testServerPrefix = "/os_test_cache_server/";
+    char otherServerName[32];
+    char otherServerPath[48];
+
+    seL4_CPtr aep = proc_new_async_endpoint();
+    test_assert(aep && ROS_ERRNO() == ESUCCESS);
+    error = nsv_register(REFOS_NAMESERV_EP, testServerName, aep);
+    test_assert(error == ESUCCESS);
+
+    /* The first resolve asks the name server, and the next one under the same prefix hits the
+       cache. */
+    mp = nsv_resolve("/os_test_cache_server/a.txt");
+    test_assert(mp.success == true && mp.cached == false);
+    nsv_mountpoint_release(&mp);
+    mp = nsv_resolve("/os_test_cache_server/b.txt");
+    test_assert(ROS_ERRNO() == ESUCCESS);
+    test_assert(mp.success == true && mp.cached == true);
+    test_assert(strcmp(mp.dspaceName, "b.txt") == 0);
+    test_assert(strcmp(mp.nameservPathPrefix, testServerPrefix) == 0);
+
+    /* The cached anon cap should still be the one we registered. */
+    seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 1);
+    seL4_SetMR(0, 0xcac4ed);
+    seL4_NBSend(mp.serverAnon, tag);
+    seL4_Word badge;
+    seL4_Recv(aep, &badge);
+    test_assert(seL4_GetMR(0) == 0xcac4ed);
+    nsv_mountpoint_release(&mp);
+
+    /* Invalidating the prefix makes the next resolve ask the name server again. */
+    nsv_cache_invalidate(testServerPrefix);
+    mp = nsv_resolve("/os_test_cache_server/c.txt");
+    test_assert(mp.success == true && mp.cached == false);
+    nsv_mountpoint_release(&mp);
+
+    /* Resolving under enough other prefixes expires the least recently used entry. */
+    for (int i = 0; i < NAMESERV_CACHE_SIZE; i++) {
+        snprintf(otherServerName, sizeof(otherServerName), "os_test_cache_other%d", i);
+        snprintf(otherServerPath, sizeof(otherServerPath), "/%s/d.txt", otherServerName);
+        error = nsv_register(REFOS_NAMESERV_EP, otherServerName, aep);
+        test_assert(error == ESUCCESS);
+        mp = nsv_resolve(otherServerPath);
+        test_assert(mp.success == true && mp.cached == false);
+        nsv_mountpoint_release(&mp);
+    }
+    mp = nsv_resolve("/os_test_cache_server/d.txt");
+    test_assert(mp.success == true && mp.cached == false);
+    nsv_mountpoint_release(&mp);
+    for (int i = 0; i < NAMESERV_CACHE_SIZE; i++) {
+        snprintf(otherServerName, sizeof(otherServerName), "os_test_cache_other%d", i);
+        error = nsv_unregister_server(REFOS_NAMESERV_EP, otherServerName);
+        test_assert(error == ESUCCESS);
+    }
+
+    /* Once the server unregisters, its cached resolution must not be used any more. */
+    mp = nsv_resolve("/os_test_cache_server/e.txt");
+    test_assert(mp.success == true);
+    nsv_mountpoint_release(&mp);
+    mp = nsv_resolve("/os_test_cache_server/f.txt");
+    test_assert(mp.success == true && mp.cached == true);
+    nsv_mountpoint_release(&mp);
+    error = nsv_unregister_server(REFOS_NAMESERV_EP, testServerName);
+    test_assert(error == ESUCCESS);
+    mp = nsv_resolve("/os_test_cache_server/f.txt");
+    test_assert(ROS_ERRNO() == ESERVERNOTFOUND);
+    test_assert(mp.success == false && mp.cached == false);
+
+    proc_del_async_endpoint(aep);
+    return test_success();
+}
+
 static int
 test_start_userland_test(void)
 {
@@ -341,8 +467,10 @@ test_process_server(void)
     test_process_server_endpoints();
     test_process_server_window();
     test_process_server_window_resize();
+    test_process_server_window_dspace_resize();
     test_process_server_param_buffer();
     test_process_server_nameserv();
+    test_process_server_nameserv_cache();
 }
 
 /* -------------------------------- RefOSUtil tests -------------------------------------- */
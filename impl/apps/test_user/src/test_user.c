@@ -19,6 +19,7 @@
 #include <refos-io/stdio.h>
 #include <refos-util/init.h>
 #include <refos/sync.h>
+#include <refos/time_page.h>
 
 /* Debug printing. */
 #include <refos-util/dprintf.h>
@@ -348,6 +349,141 @@ test_filetable_write(void)
     return test_success();
 }
 
+#define TEST_FILETABLE_RAMFS_FILESIZE 0x20000
+
+static int
+test_filetable_ramfs(void)
+{
+    test_start("filetable ramfs");
+
+    /* Grow a file well past a single page, in uneven chunks. */
+    static char buffer[TEST_FILETABLE_RAMFS_FILESIZE];
+    for (int i = 0; i < TEST_FILETABLE_RAMFS_FILESIZE; i++) {
+        buffer[i] = (char)((i * 7) % 253);
+    }
+    FILE * testFile = fopen("fileserv/test_file_ramfs", "w");
+    test_assert(testFile);
+    int total = 0;
+    while (total < TEST_FILETABLE_RAMFS_FILESIZE) {
+        int len = TEST_FILETABLE_RAMFS_FILESIZE - total;
+        len = len < 5000 ? len : 5000;
+        int nw = write(fileno(testFile), buffer + total, len);
+        test_assert(nw == len);
+        total += nw;
+    }
+    fclose(testFile);
+
+    /* Read it back and check the contents survived the extent being moved. */
+    static char readBuffer[TEST_FILETABLE_RAMFS_FILESIZE];
+    testFile = fopen("fileserv/test_file_ramfs", "r");
+    test_assert(testFile);
+    total = 0;
+    while (total < TEST_FILETABLE_RAMFS_FILESIZE) {
+        int nr = read(fileno(testFile), readBuffer + total, TEST_FILETABLE_RAMFS_FILESIZE - total);
+        test_assert(nr > 0);
+        total += nr;
+    }
+    test_assert(memcmp(readBuffer, buffer, TEST_FILETABLE_RAMFS_FILESIZE) == 0);
+    fclose(testFile);
+
+    /* Re-opening for writing truncates the file. */
+    testFile = fopen("fileserv/test_file_ramfs", "w");
+    test_assert(testFile);
+    test_assert(write(fileno(testFile), "abc", 3) == 3);
+    fclose(testFile);
+    testFile = fopen("fileserv/test_file_ramfs", "r");
+    test_assert(testFile);
+    int nr = read(fileno(testFile), readBuffer, TEST_FILETABLE_RAMFS_FILESIZE);
+    test_assert(nr == 3);
+    test_assert(readBuffer[0] == 'a' && readBuffer[1] == 'b' && readBuffer[2] == 'c');
+    fclose(testFile);
+
+    /* Unlink the file, giving its pages back. */
+    test_assert(unlink("fileserv/test_file_ramfs") == 0);
+    return test_success();
+}
+
+#define TEST_FILETABLE_BENCH_FILESIZE 0x8000
+#define TEST_FILETABLE_BENCH_ITERATIONS 16
+#define TEST_FILETABLE_BENCH_SMALL_CHUNK 32
+
+static uint64_t
+test_filetable_bench_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/*! @brief Read back the whole benchmark file in chunks of the given size, and return the elapsed
+           time in nanoseconds. Returns 0 on failure. */
+static uint64_t
+test_filetable_bench_read(int fd, char *buffer, int chunkSize)
+{
+    uint64_t start = test_filetable_bench_time_ns();
+    for (int i = 0; i < TEST_FILETABLE_BENCH_ITERATIONS; i++) {
+        if (lseek(fd, 0, SEEK_SET) != 0) {
+            return 0;
+        }
+        int total = 0;
+        while (total < TEST_FILETABLE_BENCH_FILESIZE) {
+            int len = TEST_FILETABLE_BENCH_FILESIZE - total;
+            int nr = read(fd, buffer + total, len < chunkSize ? len : chunkSize);
+            if (nr <= 0) {
+                return 0;
+            }
+            total += nr;
+        }
+    }
+    uint64_t end = test_filetable_bench_time_ns();
+    return (end > start) ? (end - start) : 1;
+}
+
+static int
+test_filetable_throughput(void)
+{
+    test_start("filetable throughput");
+
+    static char writeBuffer[TEST_FILETABLE_BENCH_FILESIZE];
+    static char readBuffer[TEST_FILETABLE_BENCH_FILESIZE];
+    for (int i = 0; i < TEST_FILETABLE_BENCH_FILESIZE; i++) {
+        writeBuffer[i] = (char)((i * 13) % 251);
+    }
+
+    FILE * testFile = fopen("fileserv/test_file_bench", "w+");
+    test_assert(testFile);
+    int fd = fileno(testFile);
+
+    /* Bulk write the whole file in one go, through the shared parameter buffer. */
+    uint64_t start = test_filetable_bench_time_ns();
+    int nw = write(fd, writeBuffer, TEST_FILETABLE_BENCH_FILESIZE);
+    uint64_t writeTime = test_filetable_bench_time_ns() - start;
+    test_assert(nw == TEST_FILETABLE_BENCH_FILESIZE);
+
+    /* Bulk read it back, and check the contents. */
+    uint64_t bulkTime = test_filetable_bench_read(fd, readBuffer, TEST_FILETABLE_BENCH_FILESIZE);
+    test_assert(bulkTime > 0);
+    test_assert(memcmp(readBuffer, writeBuffer, TEST_FILETABLE_BENCH_FILESIZE) == 0);
+
+    /* Read it back in small chunks, which go over IPC. */
+    memset(readBuffer, 0, TEST_FILETABLE_BENCH_FILESIZE);
+    uint64_t smallTime = test_filetable_bench_read(fd, readBuffer,
+                                                   TEST_FILETABLE_BENCH_SMALL_CHUNK);
+    test_assert(smallTime > 0);
+    test_assert(memcmp(readBuffer, writeBuffer, TEST_FILETABLE_BENCH_FILESIZE) == 0);
+    fclose(testFile);
+
+    uint64_t nbytes = (uint64_t) TEST_FILETABLE_BENCH_FILESIZE * TEST_FILETABLE_BENCH_ITERATIONS;
+    printf("USER_TEST | filetable write %d bytes in %llu us.\n", TEST_FILETABLE_BENCH_FILESIZE,
+           (unsigned long long) (writeTime / 1000));
+    printf("USER_TEST | filetable bulk read %llu KiB/s, %d-byte chunk read %llu KiB/s.\n",
+           (unsigned long long) ((nbytes * 1000000000ULL / bulkTime) / 1024),
+           TEST_FILETABLE_BENCH_SMALL_CHUNK,
+           (unsigned long long) ((nbytes * 1000000000ULL / smallTime) / 1024));
+
+    return test_success();
+}
+
 static int
 test_gettime(void)
 {
@@ -362,6 +498,41 @@ test_gettime(void)
     return test_success();
 }
 
+static int
+test_time_page(void)
+{
+    test_start("time page");
+
+    /* The writer leaves the sequence number even, and readers get back what it wrote. */
+    struct refos_time_page tp;
+    memset(&tp, 0, sizeof(struct refos_time_page));
+    refos_time_page_write(&tp, 123456789ULL, 0, 0);
+    test_assert(tp.seq == 2);
+    test_assert(refos_time_page_read(&tp) == 123456789ULL);
+
+    /* With a calibrated counter, the reader extrapolates past the last update. */
+    uint64_t counter;
+    if (refos_read_cycle_counter(&counter)) {
+        refos_time_page_write(&tp, 1000, counter, 1ULL << REFOS_TIME_PAGE_SCALE_SHIFT);
+        test_assert(tp.seq == 4);
+        test_assert(refos_time_page_read(&tp) >= 1000);
+    }
+
+    /* clock_gettime reads the time page when there is one, and the timer over IPC otherwise.
+       Either way, it should never go backwards. */
+    struct timespec last = {0, 0};
+    for (int i = 0; i < 150; i++) {
+        struct timespec ts;
+        test_assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+        test_assert(ts.tv_nsec >= 0 && ts.tv_nsec < 1000000000L);
+        test_assert(ts.tv_sec > last.tv_sec ||
+                    (ts.tv_sec == last.tv_sec && ts.tv_nsec >= last.tv_nsec));
+        last = ts;
+    }
+    tvprintf("clock_gettime %u.%09u s.\n", (uint32_t) last.tv_sec, (uint32_t) last.tv_nsec);
+    return test_success();
+}
+
 #endif /* CONFIG_REFOS_RUN_TESTS */
 
 int
@@ -393,7 +564,10 @@ main()
     test_cvector();
     test_filetable_read();
     test_filetable_write();
+    test_filetable_ramfs();
+    test_filetable_throughput();
     test_gettime();
+    test_time_page();
 
     test_print_log();
 #endif
@@ -18,6 +18,7 @@
 #include <platsupport/plat/timer.h>
 #include <refos-util/dprintf.h>
 #include <refos-util/device_io.h>
+#include <refos/cycle_counter.h>
 
 /*! @file
     @brief timer server timer device manager.
@@ -27,12 +28,13 @@
 
     When a client wants to sleep for some amount of seconds, we use seL4_CNode_SaveCaller in order
     to save its reply cap and reply to it when on the timer IRQ when its sleep period has expired.
-    The timer module sets up frequent periodic timer IRQs in order to do this.
+    Waiters are kept in a binary min-heap ordered by wake-up time, so only expired waiters are
+    looked at on each IRQ.
 
-    This approach is relatively inefficient as it results in a lot of IRQs and wasted time
-    processing them. A better approach would be to set up one-shot IRQs at the exact time of the
-    next waking client, allowing less IRQ overhead and much better sleep accuracy. This may be
-    implemented in the near future, but for now spamming IRQs is a simple approach which works.
+    When there is a separate tick device which supports relative timeouts, it is programmed in
+    one-shot mode to fire at the wake-up time of the earliest waiter, so there are no IRQs at all
+    while nobody is sleeping. Otherwise (eg. on PC99, where the PIT is also the clock) we fall back
+    to frequent periodic tick IRQs.
 */
 
 /* ---------------------- Platform specific timer device definitions ---------------------------- */
@@ -47,6 +49,7 @@
     #define TICK_TIMER_IRQ EPIT2_INTERRUPT
     #define TICK_TIMER_PERIOD (2000000)
     #define TICK_TIMER_SCALE_NS 1
+    #define TICK_TIMER_ONESHOT_MAX TIMER_PERIODIC_MAX
 
 #elif defined(PLAT_AM335x)
 
@@ -57,6 +60,7 @@
     #define TIMER_PERIODIC_MAX 178956970666  // ((((1UL << 32) / 24UL) * 1000UL) - 1) 
     #define TICK_TIMER_PERIOD (2000000)
     #define TICK_TIMER_SCALE_NS 1
+    #define TICK_TIMER_ONESHOT_MAX TIMER_PERIODIC_MAX
 
 #elif defined(PLAT_PC99)
 
@@ -66,6 +70,7 @@
 
     #define TICK_TIMER_PERIOD (2000000)
     #define TICK_TIMER_SCALE_NS 1
+    #define TICK_TIMER_ONESHOT_MAX TIMER_PERIODIC_MAX
 
     #include <platsupport/plat/rtc.h>
 
@@ -73,7 +78,11 @@
     #error "Unsupported platform."
 #endif
 
-/* ------------------------------------ Timer functions ----------------------------------------- */
+/* Shortest one-shot timeout to program, so we never ask for a timeout that has already passed. */
+#define TICK_TIMER_ONESHOT_MIN (10000)
+
+/* Minimum interval between shared time page cycle counter re-calibrations. */
+#define TIME_PAGE_CALIBRATE_PERIOD (1000000000ULL)
 
 /* Forward declarations. We avoid including the whole state.h here due to errno.h definition
    conflicts. */
@@ -81,8 +90,121 @@ typedef void (*timeserv_irq_callback_fn_t)(void *cookie, uint32_t irq);
 int timeserv_handle_irq(uint32_t irq, timeserv_irq_callback_fn_t callback, void *cookie);
 void reply_data_write(void *rpc_userptr, int rpc___ret__);
 
-/*! @brief Look at sleeper list and reply to any sleppers that have had their time requirements
-           met.
+/* --------------------------------- Waiter heap functions -------------------------------------- */
+
+static inline struct device_timer_waiter *
+device_timer_heap_get(struct device_timer_state *s, int i)
+{
+    struct device_timer_waiter *waiter = (struct device_timer_waiter*)
+            cvector_get(&s->waiterHeap, i);
+    assert(waiter && waiter->magic == TIMESERV_DEVICE_TIMER_WAITER_MAGIC);
+    return waiter;
+}
+
+static inline void
+device_timer_heap_swap(struct device_timer_state *s, int i, int j)
+{
+    cvector_item_t tmp = cvector_get(&s->waiterHeap, i);
+    cvector_set(&s->waiterHeap, i, cvector_get(&s->waiterHeap, j));
+    cvector_set(&s->waiterHeap, j, tmp);
+}
+
+/*! @brief Add a waiter to the waiter heap, sifting it up to keep heap order. */
+static void
+device_timer_heap_push(struct device_timer_state *s, struct device_timer_waiter *waiter)
+{
+    cvector_add(&s->waiterHeap, (cvector_item_t) waiter);
+    int i = cvector_count(&s->waiterHeap) - 1;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (device_timer_heap_get(s, parent)->time <= waiter->time) {
+            break;
+        }
+        device_timer_heap_swap(s, i, parent);
+        i = parent;
+    }
+}
+
+/*! @brief Remove the earliest waiter from the waiter heap, sifting down to keep heap order. */
+static void
+device_timer_heap_pop(struct device_timer_state *s)
+{
+    int count = cvector_count(&s->waiterHeap);
+    assert(count > 0);
+    device_timer_heap_swap(s, 0, count - 1);
+    cvector_delete(&s->waiterHeap, --count);
+
+    int i = 0;
+    while (true) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < count && device_timer_heap_get(s, left)->time <
+                device_timer_heap_get(s, smallest)->time) {
+            smallest = left;
+        }
+        if (right < count && device_timer_heap_get(s, right)->time <
+                device_timer_heap_get(s, smallest)->time) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        device_timer_heap_swap(s, i, smallest);
+        i = smallest;
+    }
+}
+
+/* ------------------------------------ Timer functions ----------------------------------------- */
+
+/*! @brief Program the one-shot tick device to fire at the earliest waiter's wake-up time.
+
+    Does nothing if the tick device is periodic, there are no waiters (and no shared time page to
+    keep fresh), or the tick device is already programmed to fire at or before the earliest
+    waiter's wake-up time. Timeouts are clamped to
+    what the device supports; if the device fires early the next one-shot is simply programmed then.
+
+    @param s The timer global state structure.
+*/
+static void
+device_timer_program_tick(struct device_timer_state *s)
+{
+    if (!s->tickOneShot) {
+        return;
+    }
+    uint64_t time = device_timer_get_time(s);
+    uint64_t deadline = 0;
+    if (cvector_count(&s->waiterHeap) > 0) {
+        deadline = device_timer_heap_get(s, 0)->time;
+    }
+    if (s->timePage && !s->counterMult) {
+        /* Keep the shared time page fresh until clients can extrapolate off the counter. */
+        if (!deadline || deadline > time + TICK_TIMER_PERIOD) {
+            deadline = time + TICK_TIMER_PERIOD;
+        }
+    }
+    if (!deadline || (s->tickDeadline && s->tickDeadline <= deadline)) {
+        return;
+    }
+
+    uint64_t timeout = (deadline > time) ? (deadline - time) : 0;
+    if (timeout < TICK_TIMER_ONESHOT_MIN) {
+        timeout = TICK_TIMER_ONESHOT_MIN;
+    }
+    if (timeout > TICK_TIMER_ONESHOT_MAX) {
+        timeout = TICK_TIMER_ONESHOT_MAX;
+    }
+
+    int error = timer_oneshot_relative(s->tickDev, timeout);
+    if (error) {
+        ROS_WARNING("Could not program one-shot tick timer.");
+        return;
+    }
+    s->tickDeadline = time + timeout;
+}
+
+/*! @brief Pop and reply to any sleepers that have had their time requirements met, then program
+           the next one-shot tick.
     @param s The timer global state structure.
 */
 static void
@@ -90,18 +212,16 @@ device_timer_update_sleepers(struct device_timer_state *s)
 {
     uint64_t time = device_timer_get_time(s);
 
-    /* Loop through and find any fired waiters to reply to. */
-    int count = cvector_count(&s->waiterList);
-    for (int i = 0; i < count; i++) {
-        struct device_timer_waiter *waiter = (struct device_timer_waiter*)
-                cvector_get(&s->waiterList, i);
-        assert(waiter && waiter->magic == TIMESERV_DEVICE_TIMER_WAITER_MAGIC);
+    /* Pop off fired waiters and reply to them, earliest first. */
+    while (cvector_count(&s->waiterHeap) > 0) {
+        struct device_timer_waiter *waiter = device_timer_heap_get(s, 0);
         assert(waiter->reply && waiter->client);
 
         if (waiter->time > time) {
-            /* Not yet. */
-            continue;
+            /* Not yet, and neither are any of the others. */
+            break;
         }
+        device_timer_heap_pop(s);
 
         /* Reply to the waiter. */
         waiter->client->rpcClient.skip_reply = false;
@@ -113,12 +233,9 @@ device_timer_update_sleepers(struct device_timer_state *s)
         csfree_delete(waiter->reply);
         waiter->magic = 0x0;
         free(waiter);
-
-        /* Remove the item from the waiter list. */
-        cvector_delete(&s->waiterList, i);
-        count = cvector_count(&s->waiterList);
-        i--;
     }
+
+    device_timer_program_tick(s);
 }
 
 /*! @brief Callback function to handle GPT timer IRQs.
@@ -138,13 +255,15 @@ device_timer_handle_irq(void *cookie, uint32_t irq)
     assert(s->timerIRQPeriod > 0);
     s->cumulativeTime += s->timerIRQPeriod;
     timer_handle_irq(s->timerDev, irq);
+    device_timer_publish_time(s);
     device_timer_update_sleepers(s);
 }
 
 /*! @brief Callback function to handle waiter timer IRQs.
     
-    Waiter-list IRQs happen very frequently, as opposed to the GPT overflow IRQs. This is used to
-    wake up sleeping clients.
+    Waiter-list IRQs happen either at the wake-up time of the earliest waiter (one-shot mode), or
+    very frequently (periodic mode), as opposed to the GPT overflow IRQs. This is used to wake up
+    sleeping clients.
 
     @param cookie The global timer state (struct device_timer_state *).
     @param irq The fired IRQ number.
@@ -155,6 +274,8 @@ device_tick_handle_irq(void *cookie, uint32_t irq)
     struct device_timer_state *s = (struct device_timer_state *) cookie;
     assert(s && s->magic == TIMESERV_DEVICE_TIMER_MAGIC);
     timer_handle_irq(s->tickDev, irq);
+    s->tickDeadline = 0;
+    device_timer_publish_time(s);
     device_timer_update_sleepers(s);
 }
 
@@ -196,6 +317,7 @@ device_timer_init(struct device_timer_state *s, dev_io_ops_t *io)
     s->magic = TIMESERV_DEVICE_TIMER_MAGIC;
     s->io = io;
     s->timerDev = NULL;
+    s->timePage = NULL;
 
 #if defined(PLAT_IMX31) || defined (PLAT_IMX6)
 
@@ -310,11 +432,14 @@ device_timer_init(struct device_timer_state *s, dev_io_ops_t *io)
     #endif
     s->timerIRQPeriod = TIMER_PERIODIC_MAX;
 
-    /* Set the tick timer for realy fast periodic ticks. Rather crude way of implementing sleep()
-       functionality but works. In the future this should be improved
-       (see module description above).
+    /* Use the tick timer in one-shot mode if it's a separate device which supports it; it will be
+       programmed once there's someone to wake up. Otherwise fall back to setting the tick timer
+       for really fast periodic ticks (see module description above).
     */
-    if (s->tickDev != NULL) {
+    s->tickOneShot = (s->tickDev != NULL && s->tickDev != s->timerDev &&
+                      s->tickDev->properties.relative_timeouts);
+    s->tickDeadline = 0;
+    if (s->tickDev != NULL && !s->tickOneShot) {
         error = timer_periodic(s->tickDev, TICK_TIMER_PERIOD);
         if (error) {
             ROS_WARNING("Could not set periodic tick timer.");
@@ -325,8 +450,8 @@ device_timer_init(struct device_timer_state *s, dev_io_ops_t *io)
         }
     }
 
-    /* Initialise the sleep timer waiter list. */
-    cvector_init(&s->waiterList);
+    /* Initialise the sleep timer waiter heap. */
+    cvector_init(&s->waiterHeap);
 
     s->initialised = true;
 }
@@ -379,8 +504,9 @@ device_timer_save_caller_as_waiter(struct device_timer_state *s, struct srv_clie
         goto exit2;
     }
 
-    /* Add to waiter list. (Takes ownership) */
-    cvector_add(&s->waiterList, (cvector_item_t) waiter);
+    /* Add to waiter heap (Takes ownership), and make sure the tick fires in time for it. */
+    device_timer_heap_push(s, waiter);
+    device_timer_program_tick(s);
 
     return ESUCCESS;
 
@@ -393,6 +519,52 @@ exit1:
     return error;
 }
 
+int
+device_timer_set_time_page(struct device_timer_state *s, struct refos_time_page *timePage)
+{
+    assert(s && s->magic == TIMESERV_DEVICE_TIMER_MAGIC);
+    assert(timePage);
+    uint64_t counter;
+    if (!refos_read_cycle_counter(&counter)) {
+        return EUNIMPLEMENTED;
+    }
+    s->calibCounter = 0;
+    s->counterMult = 0;
+
+    s->timePage = timePage;
+    s->timePage->magic = REFOS_TIME_PAGE_MAGIC;
+    device_timer_publish_time(s);
+    device_timer_program_tick(s);
+    return ESUCCESS;
+}
+
+void
+device_timer_publish_time(struct device_timer_state *s)
+{
+    assert(s && s->magic == TIMESERV_DEVICE_TIMER_MAGIC);
+    if (!s->timePage) {
+        return;
+    }
+    uint64_t time = device_timer_get_time(s);
+    uint64_t counter = 0;
+
+    if (refos_read_cycle_counter(&counter)) {
+        /* Calibrate the counter against the timer device over a long enough interval. */
+        if (!s->calibCounter) {
+            s->calibTime = time;
+            s->calibCounter = counter;
+        } else if (time - s->calibTime >= TIME_PAGE_CALIBRATE_PERIOD &&
+                   counter > s->calibCounter) {
+            s->counterMult = ((time - s->calibTime) << REFOS_TIME_PAGE_SCALE_SHIFT) /
+                             (counter - s->calibCounter);
+            s->calibTime = time;
+            s->calibCounter = counter;
+        }
+    }
+
+    refos_time_page_write(s->timePage, time, counter, s->counterMult);
+}
+
 void
 device_timer_purge_client(struct device_timer_state *client)
 {
@@ -15,6 +15,7 @@
 #include <refos-util/device_io.h>
 #include <platsupport/timer.h>
 #include <platsupport/plat/timer.h>
+#include <refos/time_page.h>
 
 /*! @file
     @brief timer server timer device manager. */
@@ -43,9 +44,21 @@ struct device_timer_state {
         Note that this may point to the exact same device as timerDev. */
     pstimer_t *tickDev; /* No ownership. Weak ref to static. */
 
-    cvector_t waiterList; /* struct device_timer_waiter */
+    /*! Binary min-heap of waiters, ordered by wake-up time. */
+    cvector_t waiterHeap; /* struct device_timer_waiter */
     uint64_t cumulativeTime; /*!< Current cumulative time. */
     uint64_t timerIRQPeriod;
+
+    /*! Whether tickDev is programmed one-shot to the next waiter's wake-up time, rather than
+        ticking periodically. */
+    bool tickOneShot;
+    uint64_t tickDeadline; /*!< Currently programmed one-shot wake-up time, 0 if none. */
+
+    /*! Shared time page published to clients, and its cycle counter calibration state. */
+    struct refos_time_page *timePage; /* No ownership. */
+    uint64_t calibTime;
+    uint64_t calibCounter;
+    uint64_t counterMult;
 };
 
 /*! @brief Initialies the timer device management module.
@@ -71,6 +84,25 @@ uint64_t device_timer_get_time(struct device_timer_state *s);
 int device_timer_save_caller_as_waiter(struct device_timer_state *s, struct srv_client *c,
         uint64_t waitTime);
 
+/*! @brief Start publishing the current time on the given shared time page.
+
+    The time page is updated on every timer IRQ, and clients extrapolate the time past the last
+    update off the user-readable cycle counter. Until the counter has been calibrated, the tick is
+    kept firing at least every tick period so the published time stays fresh. Without a counter
+    the time page is not published at all, as keeping it fresh would cost an IRQ every tick
+    period even when idle; clients then read the time over IPC instead.
+
+    @param s The global timer device state structure (No ownership).
+    @param timePage The mapped shared time page. (No ownership)
+    @return ESUCCESS if success, EUNIMPLEMENTED if there is no user-readable cycle counter.
+*/
+int device_timer_set_time_page(struct device_timer_state *s, struct refos_time_page *timePage);
+
+/*! @brief Update the shared time page with the current time, if one has been set.
+    @param s The global timer device state structure (No ownership).
+*/
+void device_timer_publish_time(struct device_timer_state *s);
+
 /*! @brief Purge all weak references to client form waiting list. Used when client dies.
     @param client The dying client to be purged.
 */
@@ -17,9 +17,14 @@
 */
 
 seL4_CPtr
-data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode , int rpc_size ,
-                  int* rpc_errno)
+data_open_internal_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
+                           int rpc_size , uint32_t* rpc_dspaceSize , int* rpc_errno)
 {
+    /* Device dataspaces have no size. */
+    if (rpc_dspaceSize) {
+        (*rpc_dspaceSize) = 0;
+    }
+
     if (!rpc_name) {
         SET_ERRNO_PTR(rpc_errno, EFILENOTFOUND);
         return 0;
@@ -30,6 +35,12 @@ data_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_m
         return timer_open_handler(rpc_userptr, rpc_name, rpc_flags, rpc_mode, rpc_size, rpc_errno);
     }
 
+    /* Handle shared time page open requests. */
+    if (strcmp(rpc_name, REFOS_TIME_PAGE_DSPACE_NAME) == 0) {
+        return timer_open_time_page_handler(rpc_userptr, rpc_name, rpc_flags, rpc_mode, rpc_size,
+                                            rpc_errno);
+    }
+
     SET_ERRNO_PTR(rpc_errno, EFILENOTFOUND);
     return 0;
 }
@@ -53,6 +64,12 @@ data_close_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd)
     return EFILENOTFOUND;
 }
 
+refos_err_t
+data_unlink_handler(void *rpc_userptr , char* rpc_name)
+{
+    return EUNIMPLEMENTED;
+}
+
 int
 data_read_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
                   rpc_buffer_t rpc_buf , uint32_t rpc_count)
@@ -170,6 +187,20 @@ data_provide_data_from_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dsp
     return EUNIMPLEMENTED;
 }
 
+int
+data_read_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
+                              uint32_t rpc_count)
+{
+    return -EUNIMPLEMENTED;
+}
+
+int
+data_write_parambuffer_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
+                               uint32_t rpc_count)
+{
+    return -EUNIMPLEMENTED;
+}
+
 int
 check_dispatch_data(srv_msg_t *m, void **userptr)
 {
@@ -31,6 +31,19 @@ timer_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_
     return timeServ.timerBadgeEP;
 }
 
+seL4_CPtr
+timer_open_time_page_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
+                             int rpc_size , int* rpc_errno)
+{
+    /* Return the read-only cap to the shared time page RAM dataspace, if we have one. */
+    if (!timeServ.timePageReadOnly) {
+        SET_ERRNO_PTR(rpc_errno, EFILENOTFOUND);
+        return 0;
+    }
+    SET_ERRNO_PTR(rpc_errno, ESUCCESS);
+    return timeServ.timePageReadOnly;
+}
+
 int
 timer_write_handler(void *rpc_userptr , seL4_CPtr rpc_dspace_fd , uint32_t rpc_offset ,
                          rpc_buffer_t rpc_buf , uint32_t rpc_count)
@@ -12,10 +12,20 @@
 /*! @file
     @brief Timer dataspace interface functions. */
 
-/*! @brief Similar to data_open_handler, for timer dataspaces. */
+/*! @brief Similar to data_open_internal_handler, for timer dataspaces. */
 seL4_CPtr timer_open_handler(void *rpc_userptr , char* rpc_name , int rpc_flags , int rpc_mode ,
                               int rpc_size , int* rpc_errno);
 
+/*! @brief Similar to data_open_internal_handler, for the shared time page.
+
+    Returns a read-only cap to the anonymous RAM dataspace holding the shared time page (see
+    <refos/time_page.h>), which the client may then datamap into its own address space to read the
+    time without IPC. There is no time page on architectures without a user-readable cycle
+    counter.
+*/
+seL4_CPtr timer_open_time_page_handler(void *rpc_userptr , char* rpc_name , int rpc_flags ,
+                                       int rpc_mode , int rpc_size , int* rpc_errno);
+
 /*! @brief Similar to data_write_handler, for timer dataspaces.
 
     Writing a uint64_t to the timer dspace will be interpreted as sleeping for that many nanoseconds
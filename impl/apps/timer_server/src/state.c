@@ -77,4 +77,36 @@ timeserv_init(void)
 
     /* Set up timer device. */
     device_timer_init(&timeServ.devTimer, &timeServ.devIO);
+
+    /* Set up the shared time page, which clients datamap to read the time without IPC. */
+    dprintf("    Initialising timeserv shared time page...\n");
+    timeServ.timePage = data_open_map(REFOS_PROCSERV_EP, "anon", 0, 0, REFOS_PAGE_SIZE, -1);
+    if (timeServ.timePage.err != ESUCCESS) {
+        ROS_WARNING("Could not create shared time page. Clients will fall back to IPC.");
+        return;
+    }
+    /* Clients only ever get a read-only cap, so they can't write to or close the time page. */
+    refos_err_t error = EINVALID;
+    timeServ.timePageReadOnly = proc_get_dspace_read_only(timeServ.timePage.dataspace, &error);
+    if (error != ESUCCESS || !timeServ.timePageReadOnly) {
+        ROS_WARNING("Could not get read-only time page cap. Clients will fall back to IPC.");
+        goto exit1;
+    }
+
+    error = device_timer_set_time_page(&timeServ.devTimer,
+                                       (struct refos_time_page *) timeServ.timePage.vaddr);
+    if (error != ESUCCESS) {
+        dprintf("    No user-readable cycle counter. Clients will fall back to IPC.\n");
+        goto exit2;
+    }
+    return;
+
+    /* Exit stack. */
+exit2:
+    csfree_delete(timeServ.timePageReadOnly);
+    timeServ.timePageReadOnly = 0;
+exit1:
+    data_mapping_release(timeServ.timePage);
+    memset(&timeServ.timePage, 0, sizeof(data_mapping_t));
+    timeServ.timePage.err = EINVALID;
 }
\ No newline at end of file
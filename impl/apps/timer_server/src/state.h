@@ -53,6 +53,8 @@ struct timeserv_state {
     dev_io_ops_t devIO;
     struct device_timer_state devTimer;
     seL4_CPtr timerBadgeEP;
+    data_mapping_t timePage;
+    seL4_CPtr timePageReadOnly; /*!< Read-only cap to the time page dataspace, given to clients. */
 };
 
 extern struct timeserv_state timeServ;
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host stress test & micro-benchmark for cbpool. This is not part of the library build; build &
+   run it on the host with:
+
+       cc -O2 -std=gnu99 -Iinclude src/cbpool.c bench/cbpool_bench.c -o cbpool_bench && ./cbpool_bench
+
+   from the libdatastruct directory. Every allocation is checked against a naive bit-by-bit
+   first-fit reference over a shadow bitmap, under several fragmentation patterns. The pool size
+   matches the refosio_mmap page status bitmap (2GB of 4K pages). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <data_struct/cbpool.h>
+
+#define CBPOOL_BENCH_SIZE (1 << 19)
+
+static uint8_t shadow[CBPOOL_BENCH_SIZE];
+static uint32_t seed = 0x12345678;
+
+static uint32_t
+cbpool_bench_rand(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static double
+cbpool_bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+cbpool_bench_reference_alloc(uint32_t size)
+{
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < CBPOOL_BENCH_SIZE; i++) {
+        run = shadow[i] ? 0 : run + 1;
+        if (run == size) {
+            return i + 1 - size;
+        }
+    }
+    return CBPOOL_INVALID;
+}
+
+static uint32_t
+cbpool_bench_alloc(cbpool_t *p, uint32_t size, bool verify)
+{
+    uint32_t expected = verify ? cbpool_bench_reference_alloc(size) : 0;
+    uint32_t obj = cbpool_alloc(p, size);
+    if (verify) {
+        assert(obj == expected);
+    }
+    if (obj != CBPOOL_INVALID) {
+        memset(shadow + obj, 1, size);
+    }
+    return obj;
+}
+
+static void
+cbpool_bench_free(cbpool_t *p, uint32_t obj, uint32_t size)
+{
+    cbpool_free(p, obj, size);
+    memset(shadow + obj, 0, size);
+}
+
+static void
+cbpool_bench_verify(cbpool_t *p)
+{
+    for (uint32_t i = 0; i < CBPOOL_BENCH_SIZE; i++) {
+        assert(cbpool_check_single(p, i) == shadow[i]);
+    }
+}
+
+/* Fill the pool, then free every other block of the given size, leaving holes that only
+   allocations of up to that size fit into. */
+static void
+cbpool_bench_checkerboard(cbpool_t *p, uint32_t blockSize)
+{
+    memset(shadow, 0, sizeof(shadow));
+    cbpool_free(p, 0, CBPOOL_BENCH_SIZE);
+    for (uint32_t i = 0; i + blockSize <= CBPOOL_BENCH_SIZE; i += blockSize) {
+        cbpool_bench_alloc(p, blockSize, false);
+    }
+    for (uint32_t i = 0; i + blockSize <= CBPOOL_BENCH_SIZE; i += 2 * blockSize) {
+        cbpool_bench_free(p, i, blockSize);
+    }
+    cbpool_bench_verify(p);
+}
+
+int
+main(int argc, char **argv)
+{
+    cbpool_t p;
+    cbpool_init(&p, CBPOOL_BENCH_SIZE);
+    printf("cbpool stress test, %d objects\n", CBPOOL_BENCH_SIZE);
+
+    /* Random mixed-size churn, verified against the reference. */
+    static uint32_t objs[4096], sizes[4096];
+    uint32_t nobjs = 0;
+    double start = cbpool_bench_now();
+    for (int i = 0; i < 20000; i++) {
+        if (nobjs < 4096 && (cbpool_bench_rand() % 3 || nobjs == 0)) {
+            uint32_t size = 1 + cbpool_bench_rand() % ((cbpool_bench_rand() % 4) ? 16 : 600);
+            uint32_t obj = cbpool_bench_alloc(&p, size, true);
+            if (obj != CBPOOL_INVALID) {
+                objs[nobjs] = obj;
+                sizes[nobjs++] = size;
+            }
+        } else {
+            uint32_t k = cbpool_bench_rand() % nobjs;
+            cbpool_bench_free(&p, objs[k], sizes[k]);
+            objs[k] = objs[--nobjs];
+            sizes[k] = sizes[nobjs];
+        }
+    }
+    cbpool_bench_verify(&p);
+    printf("  random churn (verified)        %8.3f s\n", cbpool_bench_now() - start);
+
+    /* Small allocations into a checkerboard of single holes. */
+    cbpool_bench_checkerboard(&p, 1);
+    start = cbpool_bench_now();
+    for (int i = 0; i < 64; i++) {
+        uint32_t obj = cbpool_bench_alloc(&p, 1, true);
+        cbpool_bench_free(&p, obj, 1);
+    }
+    printf("  1 into 1-holes (verified)      %8.3f s\n", cbpool_bench_now() - start);
+
+    /* A multi-page allocation that doesn't fit anywhere in a fragmented pool. */
+    cbpool_bench_checkerboard(&p, 16);
+    start = cbpool_bench_now();
+    for (int i = 0; i < 1000; i++) {
+        assert(cbpool_bench_alloc(&p, 17, false) == CBPOOL_INVALID);
+    }
+    printf("  17 into 16-holes, fail         %8.2f us/op\n",
+           (cbpool_bench_now() - start) * 1e6 / 1000);
+
+    /* Nearly full pool with the only hole at the very end. */
+    memset(shadow, 0, sizeof(shadow));
+    cbpool_free(&p, 0, CBPOOL_BENCH_SIZE);
+    cbpool_bench_alloc(&p, CBPOOL_BENCH_SIZE - 256, true);
+    start = cbpool_bench_now();
+    for (int i = 0; i < 1000; i++) {
+        uint32_t obj = cbpool_bench_alloc(&p, 200, false);
+        assert(obj == CBPOOL_BENCH_SIZE - 256);
+        cbpool_bench_free(&p, obj, 200);
+    }
+    printf("  200 into nearly full pool      %8.2f us/op\n",
+           (cbpool_bench_now() - start) * 1e6 / 1000);
+    assert(cbpool_bench_alloc(&p, 257, true) == CBPOOL_INVALID);
+    assert(cbpool_bench_alloc(&p, 256, true) == CBPOOL_BENCH_SIZE - 256);
+    assert(cbpool_bench_alloc(&p, 1, true) == CBPOOL_INVALID);
+    cbpool_bench_verify(&p);
+
+    cbpool_release(&p);
+    printf("  all checks passed\n");
+    (void) argc;
+    (void) argv;
+    return 0;
+}
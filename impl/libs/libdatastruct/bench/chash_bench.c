@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host micro-benchmark for chash. This is not part of the library build; build & run it on the
+   host with:
+
+       cc -O2 -std=gnu99 -Iinclude src/chash.c bench/chash_bench.c -o chash_bench && ./chash_bench
+
+   from the libdatastruct directory. Every operation is also checked against a plain reference
+   array, so this doubles as a quick host-side sanity test after changing chash. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <time.h>
+#include <data_struct/chash.h>
+
+#define CHASH_BENCH_NKEYS (1 << 16)
+#define CHASH_BENCH_NOPS (1 << 22)
+
+static double
+chash_bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+chash_bench_report(const char *name, uint32_t nops, double start)
+{
+    double elapsed = chash_bench_now() - start;
+    printf("  %-28s %10u ops  %8.2f ns/op\n", name, nops, (elapsed * 1e9) / nops);
+}
+
+int
+main(int argc, char **argv)
+{
+    static chash_item_t ref[CHASH_BENCH_NKEYS];
+    uint32_t seed = 0x12345678;
+    chash_t h;
+
+    printf("chash micro-benchmark, %d keys\n", CHASH_BENCH_NKEYS);
+    chash_init(&h, 16);
+
+    /* Sequential insertion, growing the table from its minimum size. */
+    double start = chash_bench_now();
+    for (uint32_t i = 0; i < CHASH_BENCH_NKEYS; i++) {
+        ref[i] = (chash_item_t) (uintptr_t) (i + 1);
+        int error = chash_set(&h, i, ref[i]);
+        assert(!error);
+    }
+    chash_bench_report("set (sequential, growing)", CHASH_BENCH_NKEYS, start);
+
+    /* Random hits. */
+    start = chash_bench_now();
+    for (uint32_t i = 0; i < CHASH_BENCH_NOPS; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t k = seed % CHASH_BENCH_NKEYS;
+        chash_item_t item = chash_get(&h, k);
+        assert(item == ref[k]);
+        (void) item;
+    }
+    chash_bench_report("get (hit)", CHASH_BENCH_NOPS, start);
+
+    /* Misses. */
+    start = chash_bench_now();
+    for (uint32_t i = 0; i < CHASH_BENCH_NOPS; i++) {
+        chash_item_t item = chash_get(&h, CHASH_BENCH_NKEYS + i);
+        assert(item == NULL);
+        (void) item;
+    }
+    chash_bench_report("get (miss)", CHASH_BENCH_NOPS, start);
+
+    /* Random remove / re-insert churn. */
+    start = chash_bench_now();
+    for (uint32_t i = 0; i < CHASH_BENCH_NOPS; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t k = seed % CHASH_BENCH_NKEYS;
+        if (ref[k]) {
+            chash_remove(&h, k);
+            ref[k] = NULL;
+        } else {
+            ref[k] = (chash_item_t) (uintptr_t) (k + 1);
+            chash_set(&h, k, ref[k]);
+        }
+    }
+    chash_bench_report("remove / set churn", CHASH_BENCH_NOPS, start);
+    for (uint32_t k = 0; k < CHASH_BENCH_NKEYS; k++) {
+        assert(chash_get(&h, k) == ref[k]);
+    }
+
+    /* ID allocation pattern: find a free key, then take it. */
+    chash_release(&h);
+    chash_init(&h, 16);
+    start = chash_bench_now();
+    for (uint32_t i = 0; i < CHASH_BENCH_NKEYS; i++) {
+        int k = chash_find_free(&h, 1, CHASH_BENCH_NKEYS + 1);
+        assert(k == i + 1);
+        chash_set(&h, k, (chash_item_t) 1);
+    }
+    chash_bench_report("find_free + set", CHASH_BENCH_NKEYS, start);
+    chash_remove(&h, 1234);
+    assert(chash_find_free(&h, 1, CHASH_BENCH_NKEYS + 1) == 1234);
+    assert(chash_find_free(&h, 2000, 3000) == -1);
+
+    chash_release(&h);
+    (void) argc;
+    (void) argv;
+    return 0;
+}
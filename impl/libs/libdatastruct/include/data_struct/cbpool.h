@@ -12,10 +12,15 @@
 
 #define CBPOOL_INVALID ((uint32_t) (-1))
 
+// Bit i of summary is set when bitmap tile i is completely allocated, so that cbpool_alloc() may
+// skip over full tiles 32 at a time (or 1024 at a time for a full summary tile). Static buffers
+// given to cbpool_init_static() must have room for both the bitmap and the summary.
 typedef struct cbpool_s {
     uint32_t size;
     uint32_t size_ntiles;
     uint32_t *bitmap;
+    uint32_t summary_ntiles;
+    uint32_t *summary;
 } cbpool_t;
 
 void cbpool_init(cbpool_t *p, uint32_t size);
@@ -17,16 +17,26 @@
     #define kfree free
 #endif
 
+#define CHASH_MIN_SIZE 8
+
 typedef void* chash_item_t;
 
+// Entries are stored inline in an open addressing table, using linear probing.
 typedef struct chash_entry_s {
     uint32_t key;
+    uint32_t used;
     chash_item_t item;
 } chash_entry_t;
 
 typedef struct chash_s {
-    cvector_t* table;
-    size_t tableSize;
+    chash_entry_t* table;
+    size_t tableSize; // Always a power of two.
+    size_t count;
+
+    // Every key in [freeHintStart, freeHint) is known to be set. Lets chash_find_free() carry on
+    // from where it last left off rather than rescanning the whole range on every call.
+    uint32_t freeHintStart;
+    uint32_t freeHint;
 } chash_t;
 
 void chash_init(chash_t *t, size_t sz);
@@ -41,4 +51,7 @@ void chash_remove(chash_t *t, uint32_t key);
 
 int chash_find_free(chash_t *t, uint32_t rangeStart, uint32_t rangeEnd);
 
+// Hash len bytes of a string into a 32-bit key (FNV-1a), for tables keyed on names.
+uint32_t chash_hash_bytes(const char *data, size_t len);
+
 #endif /* _CHASH_H_ */
@@ -10,11 +10,18 @@
 #include <stdbool.h>
 #include <data_struct/cvector.h>
 
+#define CPOOL_BITMAP_INIT_WORDS 4
+
+// Objects in [start, mx) are tracked by an allocation bitmap, which grows along with mx. The free
+// list may hold stale entries (objects since reallocated or reclaimed into mx); these are
+// skipped over lazily by cpool_alloc().
 typedef struct cpool_s {
     uint32_t start;
     uint32_t end;
     uint32_t mx;
     cvector_t freelist;
+    uint32_t *bitmap;
+    uint32_t bitmapWords;
 } cpool_t;
 
 void cpool_init(cpool_t *p, uint32_t start, uint32_t end);
@@ -11,25 +11,33 @@
 #include <assert.h>
 #include <errno.h>
 
+#define CBPOOL_TILE_FULL ((uint32_t) 0xFFFFFFFF)
+
+static void cbpool_init_tiles(cbpool_t *p, uint32_t size) {
+    p->size = size;
+    p->size_ntiles = (size / 32) + 1;
+    p->summary_ntiles = (p->size_ntiles / 32) + 1;
+}
+
 void cbpool_init_static(cbpool_t *p, uint32_t size, char *buffer, int bufferSize) {
     assert(p);
     memset(p, 0, sizeof(cbpool_t));
-    p->size = size;
-    p->size_ntiles = (size / 32) + 1;
-    assert(p->size_ntiles  * sizeof(uint32_t) <= bufferSize);
+    cbpool_init_tiles(p, size);
+    assert((p->size_ntiles + p->summary_ntiles) * sizeof(uint32_t) <= bufferSize);
     p->bitmap = (uint32_t*) buffer;
     assert(p->bitmap);
-    memset(p->bitmap, 0, p->size_ntiles * sizeof(uint32_t));
+    p->summary = p->bitmap + p->size_ntiles;
+    memset(p->bitmap, 0, (p->size_ntiles + p->summary_ntiles) * sizeof(uint32_t));
 }
 
 void cbpool_init(cbpool_t *p, uint32_t size) {
     assert(p);
     memset(p, 0, sizeof(cbpool_t));
-    p->size = size;
-    p->size_ntiles = (size / 32) + 1;
-    p->bitmap = kmalloc(p->size_ntiles * sizeof(uint32_t));
+    cbpool_init_tiles(p, size);
+    p->bitmap = kmalloc((p->size_ntiles + p->summary_ntiles) * sizeof(uint32_t));
     assert(p->bitmap);
-    memset(p->bitmap, 0, p->size_ntiles * sizeof(uint32_t));
+    p->summary = p->bitmap + p->size_ntiles;
+    memset(p->bitmap, 0, (p->size_ntiles + p->summary_ntiles) * sizeof(uint32_t));
 }
 
 void cbpool_release(cbpool_t *p) {
@@ -39,41 +47,95 @@ void cbpool_release(cbpool_t *p) {
     }
 }
 
-uint32_t cbpool_alloc_internal(cbpool_t *p, uint32_t size, int st, int ed, int inc, bool lt) {
+static inline void cbpool_update_summary(cbpool_t *p, uint32_t idx) {
+    if (p->bitmap[idx] == CBPOOL_TILE_FULL) {
+        p->summary[idx / 32] |= (1u << (idx % 32));
+    } else {
+        p->summary[idx / 32] &= ~(1u << (idx % 32));
+    }
+}
+
+// Returns the index of the first tile at or after idx which is not completely allocated.
+static uint32_t cbpool_next_free_tile(cbpool_t *p, uint32_t idx) {
+    while (idx < p->size_ntiles) {
+        uint32_t notFull = ~p->summary[idx / 32] >> (idx % 32);
+        if (notFull) {
+            return idx + __builtin_ctz(notFull);
+        }
+        idx = (idx / 32 + 1) * 32;
+    }
+    return p->size_ntiles;
+}
+
+// Sets or clears bits [obj, obj + size) a whole tile at a time.
+static void cbpool_set_range(cbpool_t *p, uint32_t obj, uint32_t size, bool val) {
+    while (size > 0) {
+        uint32_t idx = obj / 32;
+        uint32_t shift = obj % 32;
+        uint32_t n = 32 - shift;
+        if (n > size) n = size;
+        uint32_t mask = (n == 32) ? CBPOOL_TILE_FULL : (((1u << n) - 1) << shift);
+        assert(idx < p->size_ntiles);
+        if (val) {
+            p->bitmap[idx] |= mask;
+        } else {
+            p->bitmap[idx] &= ~mask;
+        }
+        cbpool_update_summary(p, idx);
+        obj += n;
+        size -= n;
+    }
+}
+
+uint32_t cbpool_alloc(cbpool_t *p, uint32_t size) {
+    assert(p && p->bitmap);
     if (!size) {
         return CBPOOL_INVALID;
     }
-    uint32_t freesz = 0;
-    for (int i = st; (lt ? (i < ed) : (i >= ed)); i+=inc) {
-        if (!cbpool_check_single(p, i)) {
-            freesz++;
-            if (freesz >= size) {
-                uint32_t sta = i - (freesz - 1);
-                for (uint32_t j = sta; j <= i; j++) {
-                    cbpool_set_single(p, j, true);
+
+    // First fit. Walk through the free runs of each non-full tile, carrying a run over into the
+    // next tile when it reaches the top bit.
+    uint32_t runStart = 0, runLen = 0;
+    for (uint32_t idx = cbpool_next_free_tile(p, 0); idx < p->size_ntiles;
+            idx = cbpool_next_free_tile(p, idx + 1)) {
+        uint32_t freeBits = ~p->bitmap[idx];
+        while (freeBits) {
+            uint32_t s = __builtin_ctz(freeBits);
+            uint32_t rest = freeBits >> s;
+            uint32_t len = (rest == CBPOOL_TILE_FULL) ? 32 : __builtin_ctz(~rest);
+            uint32_t start = idx * 32 + s;
+
+            if (runLen && runStart + runLen == start) {
+                runLen += len;
+            } else {
+                runStart = start;
+                runLen = len;
+            }
+            if (runLen >= size) {
+                if (runStart + size > p->size) {
+                    // Any later run starts later still.
+                    return CBPOOL_INVALID;
                 }
-                return sta;
+                cbpool_set_range(p, runStart, size, true);
+                return runStart;
             }
-        } else {
-            freesz = 0;
+
+            if (s + len >= 32) {
+                break;
+            }
+            freeBits &= ~(((1u << len) - 1) << s);
         }
     }
     return CBPOOL_INVALID;
 }
 
-uint32_t cbpool_alloc(cbpool_t *p, uint32_t size) {
-    return cbpool_alloc_internal(p, size, 0, p->size, 1, true);
-}
-
 void cbpool_free(cbpool_t *p, uint32_t obj, uint32_t size) {
-    if (!size) {
+    if (!size || obj >= p->size) {
         return;
     }
     uint32_t end = obj + size;
-    if (end >= p->size) end = (p->size - 1);
-    for (int i = obj; i < end; i++) {
-        cbpool_set_single(p, i, false);
-    }
+    if (end > p->size) end = p->size;
+    cbpool_set_range(p, obj, end - obj, false);
 }
 
 bool cbpool_check_single(cbpool_t *p, uint32_t obj) {
@@ -96,5 +158,5 @@ void cbpool_set_single(cbpool_t *p, uint32_t obj, bool val) {
     } else {
         p->bitmap[idx] &= ~(1 << (obj % 32));
     }
+    cbpool_update_summary(p, idx);
 }
-
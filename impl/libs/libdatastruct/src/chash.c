@@ -8,42 +8,47 @@
 #include <data_struct/chash.h>
 #include <assert.h>
 #include <errno.h>
-#include <stdio.h> 
+#include <string.h>
+#include <stdio.h>
 
-// An algorithm proposed by Donald E. Knuth in The Art Of Computer Programming Volume 3, under the
-// topic of sorting and search chapter 6.4. 
-// Src: http://www.partow.net/programming/hashfunctions/
-static unsigned int
-__DEKHash(char* str, unsigned int len)
+// Integer mixing function, the 32-bit finaliser from Austin Appleby's MurmurHash3.
+// Src: https://github.com/aappleby/smhasher
+static inline uint32_t
+chash_hash(uint32_t key, size_t tableSize)
 {
-   unsigned int hash = len;
-   unsigned int i    = 0;
-
-   for(i = 0; i < len; str++, i++)
-   {
-      hash = ((hash << 5) ^ (hash >> 27)) ^ (*str);
-   }
-   return hash;
+    key ^= key >> 16;
+    key *= 0x85EBCA6B;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35;
+    key ^= key >> 16;
+    return key & (tableSize - 1);
 }
 
-static inline uint32_t
-chash_hash(uint32_t key, uint32_t md)
+static chash_entry_t*
+chash_alloc_table(size_t tableSize)
 {
-    char *s = ((char*)(&key));
-    size_t slen = sizeof(key);
-    return __DEKHash(s, slen) % md;
+    chash_entry_t* table = kmalloc(sizeof(chash_entry_t) * tableSize);
+    if (!table) {
+        return NULL;
+    }
+    memset(table, 0, sizeof(chash_entry_t) * tableSize);
+    return table;
 }
 
 void
 chash_init(chash_t *t, size_t sz)
 {
     assert(t);
-    t->table = malloc(sizeof(cvector_t) * sz);
-    assert(t->table);
-    t->tableSize = sz;
-    for (int i = 0; i < t->tableSize; i++) {
-        cvector_init(&t->table[i]);
+    size_t tableSize = CHASH_MIN_SIZE;
+    while (tableSize < sz) {
+        tableSize <<= 1;
     }
+    t->table = chash_alloc_table(tableSize);
+    assert(t->table);
+    t->tableSize = tableSize;
+    t->count = 0;
+    t->freeHintStart = 0;
+    t->freeHint = 0;
 }
 
 void
@@ -53,46 +58,67 @@ chash_release(chash_t *t)
         return;
     }
     if (t->table) {
-        for (int i = 0; i < t->tableSize; i++) {
-            int c = cvector_count(&t->table[i]);
-            for (int j = 0; j < c; j++) {
-                chash_entry_t* entry = (chash_entry_t*) cvector_get(&t->table[i], j);
-                if (entry) {
-                    kfree(entry);
-                }
-            }
-            cvector_free(&t->table[i]);
-        }
-        free(t->table);
+        kfree(t->table);
     }
     t->table = NULL;
     t->tableSize = 0;
+    t->count = 0;
+    t->freeHintStart = 0;
+    t->freeHint = 0;
 }
 
 static chash_entry_t*
-chash_get_entry(chash_t *t, uint32_t h, uint32_t key, int *index)
+chash_get_entry(chash_t *t, uint32_t key)
 {
-    size_t c = cvector_count(&t->table[h]);
-    for (int i = 0; i < c; i++) {
-        chash_entry_t* entry = (chash_entry_t*) cvector_get(&t->table[h], i);
-        assert(entry);
+    size_t mask = t->tableSize - 1;
+    for (uint32_t h = chash_hash(key, t->tableSize); ; h = (h + 1) & mask) {
+        chash_entry_t* entry = &t->table[h];
+        if (!entry->used) {
+            return NULL;
+        }
         if (entry->key == key) {
-            if (index != NULL) {
-                *index = i;
-            }
             return entry;
         }
     }
-    return NULL;
+}
+
+static void
+chash_insert_entry(chash_entry_t* table, size_t tableSize, uint32_t key, chash_item_t obj)
+{
+    size_t mask = tableSize - 1;
+    uint32_t h = chash_hash(key, tableSize);
+    while (table[h].used) {
+        h = (h + 1) & mask;
+    }
+    table[h].key = key;
+    table[h].used = 1;
+    table[h].item = obj;
+}
+
+static int
+chash_grow(chash_t *t)
+{
+    size_t newSize = t->tableSize << 1;
+    chash_entry_t* newTable = chash_alloc_table(newSize);
+    if (!newTable) {
+        return -ENOMEM;
+    }
+    for (size_t i = 0; i < t->tableSize; i++) {
+        if (t->table[i].used) {
+            chash_insert_entry(newTable, newSize, t->table[i].key, t->table[i].item);
+        }
+    }
+    kfree(t->table);
+    t->table = newTable;
+    t->tableSize = newSize;
+    return 0;
 }
 
 chash_item_t
 chash_get(chash_t *t, uint32_t key)
 {
     // This function does _NOT_ give ownership over to caller.
-    uint32_t h = chash_hash(key, t->tableSize);
-    assert (h >= 0 && h < t->tableSize);
-    chash_entry_t* entry = chash_get_entry(t, h, key, NULL);
+    chash_entry_t* entry = chash_get_entry(t, key);
     if (entry) {
         // Found existing entry.
         return entry->item;
@@ -100,50 +126,81 @@ chash_get(chash_t *t, uint32_t key)
     return NULL;
 }
 
-int 
+int
 chash_set(chash_t *t, uint32_t key, chash_item_t obj)
 {
-    uint32_t h = chash_hash(key, t->tableSize);
-    assert (h >= 0 && h < t->tableSize);
-
-    chash_entry_t* entry = chash_get_entry(t, h, key, NULL);
+    chash_entry_t* entry = chash_get_entry(t, key);
     if (entry) {
         // Found existing entry. Set existing entry to new obj.
         entry->item = obj;
         return 0;
     }
 
-    // No previous entry found. Create a new entry.
-    entry = kmalloc(sizeof(chash_entry_t));
-    if (!entry) {
-        return -ENOMEM;
+    // No previous entry found. Keep the load factor under 3/4 so probe runs stay short.
+    if ((t->count + 1) * 4 > t->tableSize * 3) {
+        int error = chash_grow(t);
+        if (error) {
+            return error;
+        }
     }
-    entry->key = key;
-    entry->item = obj;
-    cvector_add(&t->table[h], (cvector_item_t)entry);
+    chash_insert_entry(t->table, t->tableSize, key, obj);
+    t->count++;
     return 0;
 }
 
 void
 chash_remove(chash_t *t, uint32_t key)
 {
-    uint32_t h = chash_hash(key, t->tableSize);
-    assert (h >= 0 && h < t->tableSize);
-    int index;
-    chash_entry_t* entry = chash_get_entry(t, h, key, &index);
-    if (entry) {
-        kfree(entry);
-        cvector_delete(&t->table[h], index);
+    chash_entry_t* entry = chash_get_entry(t, key);
+    if (!entry) {
+        return;
+    }
+
+    // Backward shift deletion; move any following entries in the same probe run back into the
+    // hole, so lookups never need tombstones.
+    size_t mask = t->tableSize - 1;
+    uint32_t i = entry - t->table;
+    for (uint32_t j = (i + 1) & mask; t->table[j].used; j = (j + 1) & mask) {
+        uint32_t h = chash_hash(t->table[j].key, t->tableSize);
+        // Entry at j may move to i only if its home slot h does not lie cyclically in (i, j].
+        if ((i <= j) ? (i < h && h <= j) : (i < h || h <= j)) {
+            continue;
+        }
+        t->table[i] = t->table[j];
+        i = j;
+    }
+    memset(&t->table[i], 0, sizeof(chash_entry_t));
+    t->count--;
+
+    if (key >= t->freeHintStart && key < t->freeHint) {
+        t->freeHint = key;
     }
 }
 
 int
 chash_find_free(chash_t *t, uint32_t rangeStart, uint32_t rangeEnd)
 {
-    for(int i = rangeStart; i < rangeEnd; i++) {
-        uint32_t h = chash_hash(i, t->tableSize);
-        chash_entry_t* entry = chash_get_entry(t, h, i, NULL);
-        if (!entry) return i;
+    uint32_t i = rangeStart;
+    if (t->freeHintStart == rangeStart && t->freeHint > rangeStart) {
+        i = t->freeHint;
+    }
+    for (; i < rangeEnd; i++) {
+        if (!chash_get_entry(t, i)) {
+            break;
+        }
+    }
+    t->freeHintStart = rangeStart;
+    t->freeHint = i;
+    return (i < rangeEnd) ? (int) i : -1;
+}
+
+uint32_t
+chash_hash_bytes(const char *data, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t) data[i];
+        h *= 16777619u;
     }
-    return -1;
+    return h;
 }
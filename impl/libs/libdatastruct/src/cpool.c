@@ -8,6 +8,46 @@
 #include <data_struct/cpool.h>
 #include <assert.h>
 #include <errno.h>
+#include <string.h>
+
+static inline bool
+cpool_bit_get(cpool_t *p, uint32_t obj)
+{
+    uint32_t i = obj - p->start;
+    return (p->bitmap[i / 32] >> (i % 32)) & 0x1;
+}
+
+static inline void
+cpool_bit_set(cpool_t *p, uint32_t obj, bool allocated)
+{
+    uint32_t i = obj - p->start;
+    if (allocated) {
+        p->bitmap[i / 32] |= (1 << (i % 32));
+    } else {
+        p->bitmap[i / 32] &= ~(1 << (i % 32));
+    }
+}
+
+static int
+cpool_bitmap_reserve(cpool_t *p, uint32_t obj)
+{
+    uint32_t words = ((obj - p->start) / 32) + 1;
+    if (words <= p->bitmapWords) {
+        return 0;
+    }
+    uint32_t newWords = p->bitmapWords ? p->bitmapWords : CPOOL_BITMAP_INIT_WORDS;
+    while (newWords < words) {
+        newWords *= 2;
+    }
+    uint32_t *newBitmap = krealloc(p->bitmap, newWords * sizeof(uint32_t));
+    if (!newBitmap) {
+        return -ENOMEM;
+    }
+    memset(newBitmap + p->bitmapWords, 0, (newWords - p->bitmapWords) * sizeof(uint32_t));
+    p->bitmap = newBitmap;
+    p->bitmapWords = newWords;
+    return 0;
+}
 
 void
 cpool_init(cpool_t *p, uint32_t start, uint32_t end)
@@ -16,6 +56,8 @@ cpool_init(cpool_t *p, uint32_t start, uint32_t end)
     p->start = start;
     p->end = end;
     p->mx = start;
+    p->bitmap = NULL;
+    p->bitmapWords = 0;
     cvector_init(&p->freelist);
 }
 
@@ -25,6 +67,9 @@ cpool_release(cpool_t *p) {
         return;
     }
     cvector_free(&p->freelist);
+    if (p->bitmap) {
+        kfree(p->bitmap);
+    }
     cpool_init(p, 0, 0);
 }
 
@@ -33,17 +78,24 @@ cpool_alloc(cpool_t *p)
 {
     assert(p);
 
-    // First try to allocate from the free list.
+    // First try to allocate from the free list, skipping over stale entries.
     size_t fSz = cvector_count(&p->freelist);
-    if (fSz > 0) {
+    while (fSz > 0) {
         // Allocate the last item available on the free list.
-        cvector_item_t obj = cvector_get(&p->freelist, fSz - 1);
-        cvector_delete(&p->freelist, fSz - 1);
-        return (uint32_t) obj;
+        uint32_t obj = (uint32_t) cvector_get(&p->freelist, fSz - 1);
+        cvector_delete(&p->freelist, --fSz);
+        if (obj < p->mx && !cpool_bit_get(p, obj)) {
+            cpool_bit_set(p, obj, true);
+            return obj;
+        }
     }
 
     // Free list exhausted, allocate by increasing max obj ID..
     if (p->mx <= p->end) {
+        if (cpool_bitmap_reserve(p, p->mx)) {
+            return 0;
+        }
+        cpool_bit_set(p, p->mx, true);
         return (uint32_t) p->mx++;
     }
 
@@ -55,15 +107,16 @@ void
 cpool_free(cpool_t *p, uint32_t obj)
 {
     assert(p);
-    if (obj < p->start || obj > p->end || obj >= p->mx) {
+    if (obj < p->start || obj > p->end || obj >= p->mx || !cpool_bit_get(p, obj)) {
         return;
     }
-    if (obj == p->mx) {
-        // Decrease max obj ID.
-        // Note that this implementation doesn't decrease mx for all cases;
-        // decreasing mx properly would require a periodic sort of the freelist,
-        // and a O(n) loop from the end. Doesn't save _that_ much memory.
-        p->mx = (obj - 1);
+    cpool_bit_set(p, obj, false);
+    if (obj == p->mx - 1) {
+        // Decrease max obj ID, reclaiming any free objects at the high end. Their free list
+        // entries become stale and are skipped by cpool_alloc().
+        while (p->mx > p->start && !cpool_bit_get(p, p->mx - 1)) {
+            p->mx--;
+        }
         return;
     }
     // Add to free list.
@@ -75,16 +128,9 @@ bool cpool_check(cpool_t *p, uint32_t obj) {
         // Not free if out of range.
         return false;
     }
-    if (obj > p->mx) {
+    if (obj >= p->mx) {
         // Free if in the not-allocated-yet range.
         return true;
     }
-    size_t sz = cvector_count(&p->freelist);
-    for (int i = 0; i < sz; i++) {
-        uint32_t x = (uint32_t)cvector_get(&p->freelist, i);
-        if (x == obj) {
-            return true;
-        }
-    }
-    return false;
+    return !cpool_bit_get(p, obj);
 }
@@ -31,6 +31,39 @@
 #define DSPACE_FLAG_DEVICE_PADDR 0x10000000
 #define DSPACE_FLAG_UNCACHED     0x20000000
 
+/*! @brief Opens a new dataspace at the dataspace server. Helper function for
+           data_open_internal(), which also returns the size of the opened dataspace.
+    @param session The client connection session to the dataspace server.  (No ownership)
+    @param name The name of the dataspace to open.
+    @param flags The read / write / create flags.
+    @param mode The mode to create new file with, in the case that a new one is created.
+    @param size The size of dataspace to open. Note that some data servers may ignore this.
+    @param dspaceSize Optional output size of the opened dataspace. (No ownership)
+    @param errnoRetVal Output errno variable, in the case that an error occurs. (No ownership)
+    @return Capability to the new dataspace. (Transfers ownership)
+*/
+static inline seL4_CPtr
+data_open_size(seL4_CPtr session, char* name, int flags, int mode, int size, uint32_t *dspaceSize,
+               int *errnoRetVal)
+{
+    uint32_t tempSize = 0;
+    seL4_CPtr dspace = data_open_internal(session, name, flags, mode, size, &tempSize,
+                                          errnoRetVal);
+    if (dspaceSize) {
+        (*dspaceSize) = tempSize;
+    }
+    return dspace;
+}
+
+/*! @brief Opens a new dataspace at the dataspace server. Helper function for
+           data_open_internal(). See data_open_size().
+*/
+static inline seL4_CPtr
+data_open(seL4_CPtr session, char* name, int flags, int mode, int size, int *errnoRetVal)
+{
+    return data_open_size(session, name, flags, mode, size, NULL, errnoRetVal);
+}
+
 /*! @brief Structure containing state for a mapped dataspace. */
 typedef struct data_mapping {
     seL4_CPtr session; /* No ownership. */
@@ -172,7 +205,7 @@ data_provide_data(seL4_CPtr session, seL4_CPtr dspace_fd, uint32_t offset, char
     if (!paramBuffer || paramBuffer->err != ESUCCESS) {
         return ENOPARAMBUFFER;
     }
-    if (contentSize >= paramBuffer->size) {
+    if (contentSize > paramBuffer->size) {
         return ENOMEM;
     }
     memcpy(paramBuffer->vaddr, content, contentSize);
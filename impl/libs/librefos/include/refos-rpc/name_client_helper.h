@@ -28,6 +28,7 @@
 
 #define NAMESERV_RESOLVED -1
 #define NAMESERV_PATH_MAXLEN 512
+#define NAMESERV_CACHE_SIZE 8
 
 /*! @brief Struct containing a mountpoint, which is a completely resolved namespace path. */
 typedef struct nsv_mountpoint {
@@ -37,6 +38,8 @@ typedef struct nsv_mountpoint {
 
     seL4_CPtr nameservRoot; /* No ownership. */
     char nameservPathPrefix[NAMESERV_PATH_MAXLEN];
+
+    bool cached; /* Whether the resolve started from a cached name server. */
 } nsv_mountpoint_t;
 
 /*! @brief Helper function for nsv_resolve_segment_internal() which resolves a single segment.
@@ -69,6 +72,8 @@ nsv_resolve_segment(seL4_CPtr nameserv, char* path, int* resolvedBytes)
     
     This function will completely resolve the given path down to the server that actually
     contains the dataspace. It will search through the namespace hierachy until the leaf node.
+    Resolved mount prefixes are remembered in a small per-process cache, so later paths under the
+    same prefix skip straight to the server without asking the name servers again.
 
     @param path String containing the path to resolve.
     @return A mountpoint info structure containing the results of the resolve; look in the
@@ -82,4 +87,20 @@ nsv_mountpoint_t nsv_resolve(char* path);
 */
 void nsv_mountpoint_release(nsv_mountpoint_t *m);
 
+/*! @brief Drop cached name resolutions. Call this when a server may have gone away (eg. it has
+           died or a connection to it failed), so the next resolve asks the name servers again.
+    @param prefix The mount prefix to drop, as in nsv_mountpoint_t.nameservPathPrefix. NULL to
+                  drop every cached resolution.
+*/
+void nsv_cache_invalidate(const char *prefix);
+
+/*! @brief Unregister a server name, and drop the cached name resolutions of this process so it
+           stops resolving paths to the unregistered server. Other processes drop theirs once
+           connecting to the server fails, or when they are notified of its death.
+    @param nameserv The name server to unregister from.
+    @param name The name to unregister.
+    @return ESUCCESS on success, refos_error error code otherwise.
+*/
+refos_err_t nsv_unregister_server(seL4_CPtr nameserv, char *name);
+
 #endif /* _RPC_INTERFACE_NAME_CLIENT_HELPER_H_ */
@@ -26,6 +26,8 @@
 #define PROC_WINDOW_PERMISSION_READWRITE \
         (PROC_WINDOW_PERMISSION_WRITE | PROC_WINDOW_PERMISSION_READ)
 #define PROC_WINDOW_FLAGS_UNCACHED 0x1
+#define PROC_WINDOW_FLAGS_LARGE_PAGES 0x2
+#define PROC_WINDOW_FLAGS_NO_LARGE_PAGES 0x4
 
 seL4_CPtr rpc_copyout_cptr(seL4_CPtr v);
 
@@ -23,6 +23,8 @@
 
 enum proc_notify_types {
     PROCSERV_NOTIFY_FAULT_DELEGATION,
+    /* arg[0] = dataspace ID, arg[1] = page-aligned dataspace offset, arg[2] = number of pages
+       requested starting at that offset (0 means a single page). */
     PROCSERV_NOTIFY_CONTENT_INIT,
     PROCSERV_NOTIFY_DEATH
 };
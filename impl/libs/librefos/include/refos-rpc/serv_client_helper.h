@@ -57,6 +57,30 @@ serv_connection_t serv_connect(char *serverPath);
 */
 serv_connection_t serv_connect_no_pbuffer(char *serverPath);
 
+/*! @brief Connect to the server at an already resolved mount point. Helper function for
+           serv_connect_direct(). Does not set up a parameter buffer.
+
+    Useful for clients that resolve a path themselves, to decide whether they already have a
+    connection to the server at that mount point before connecting again.
+
+    @param mountPoint The resolved mount point of the server to connect to. (Takes ownership)
+    @return Struct containing the open server connection and param buffer info. Check the error
+            member of the struct in order to check for failure. (Gives ownership)
+*/
+serv_connection_t serv_connect_resolved(nsv_mountpoint_t *mountPoint);
+
+/*! @brief Set up a parameter buffer on an already open server connection.
+
+    Creates and maps an anonymous parameter buffer dataspace, and sets it as the parameter buffer
+    of the given session on the server. This allows a connection opened with
+    serv_connect_no_pbuffer() to lazily set up a parameter buffer only once it is actually needed.
+    Does nothing if the connection already has a parameter buffer.
+
+    @param sc The open server connection to set up parameter buffer for. (No ownership)
+    @return ESUCCESS on success, refos_err_t error otherwise.
+*/
+refos_err_t serv_connection_setup_param_buffer(serv_connection_t *sc);
+
 /*! @brief Disconnect from the server, unmap and delete parameter buffer, and release the memory
            associated.
     @param sc The server connection state structure to disconnect. Does NOT free the structure
@@ -33,19 +33,25 @@
 #define REFOS_NAMESERV_MAGIC 0x5FA09B37
 #define REFOS_NAMESERV_ENTRY_MAGIC 0x5FA09B37
 #define REFOS_NAMESERV_RESOLVED -1
+#define REFOS_NAMESERV_HASH_SIZE 64 /* Must be a power of two. */
 
 /*! @brief A single entry in the name server registration list. Internal structure, don't touch. */
 typedef struct nameserv_entry {
     char* name; /* Has ownership. */
+    uint32_t nameLen;
+    uint32_t hash;
     seL4_CPtr anonEP; /* Has ownership. */
     uint32_t magic;
+    struct nameserv_entry *next; /* Next entry in the same hash bucket. */
 } nameserv_entry_t;
 
-/*! @brief Name server registration list. Encapsulates the state of a name server implementation. */
+/*! @brief Name server registration list. Encapsulates the state of a name server implementation.
+           Entries are kept in a chained hash table keyed by name, so resolving a segment does not
+           need to scan every registered server. */
 typedef struct nameserv_state {
     uint32_t magic;
     void (*free_capability) (seL4_CPtr cap);
-    cvector_t entries; /* nameserv_entry_t */
+    nameserv_entry_t *buckets[REFOS_NAMESERV_HASH_SIZE]; /* nameserv_entry_t */
 } nameserv_state_t;
 
 /*! @brief Initialise nameserver list.
@@ -43,6 +43,10 @@ struct srv_client {
     uint32_t paramBufferStart;
     seL4_CPtr paramBuffer;
     seL4_CPtr paramBufferSize;
+
+    /* Server-side mapping of the param buffer, set up lazily by client_map_param_buffer(). */
+    seL4_CPtr paramBufferWindow;
+    char *paramBufferVaddr;
 };
 
 struct srv_client_table {
@@ -87,4 +91,21 @@ void client_queue_delete(struct srv_client_table *ct, int id);
 /*! @brief Queue client up for deletion based on deathID. */
 int client_queue_delete_deathID(struct srv_client_table *ct, int deathID);
 
+/*! @brief Map the client's parameter buffer into our own vspace.
+
+    Maps the parameter buffer dataspace previously set by the client through
+    serv_set_param_buffer() into a window in the server's vspace, so bulk data can be copied in and
+    out of it directly. The mapping is done once, on first use, and is kept until the parameter
+    buffer is unset or the client is deleted. Only process server anonymous dataspaces are
+    supported as parameter buffers.
+
+    @param c The client to map the parameter buffer of.
+    @return The vaddr of the mapped parameter buffer, or NULL if the client has no parameter buffer
+            or mapping failed. (No ownership transfer)
+*/
+char* client_map_param_buffer(struct srv_client *c);
+
+/*! @brief Unmap the client's parameter buffer from our vspace, if it has been mapped. */
+void client_unmap_param_buffer(struct srv_client *c);
+
 #endif /* _REFOS_NAMESERV_SERV_CLIENT_CONNECTION_IMPL_LIBRARY_H_ */
\ No newline at end of file
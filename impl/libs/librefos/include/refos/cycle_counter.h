@@ -0,0 +1,39 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief RefOS user-readable cycle counter.
+
+    Reads the CPU cycle counter directly from user level, without any IPC or help from the timer
+    server. Only some architectures expose such a counter to user level; elsewhere the read fails
+    and callers should fall back to the timer server or go without.
+*/
+
+#ifndef _REFOS_CYCLE_COUNTER_H_
+#define _REFOS_CYCLE_COUNTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*! @brief Read the user-readable cycle counter, if this architecture has one.
+    @param counter Output counter value. (No ownership)
+    @return true if the architecture has a counter, false otherwise.
+*/
+static inline bool
+refos_read_cycle_counter(uint64_t *counter)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    *counter = ((uint64_t) hi << 32) | lo;
+    return true;
+#else
+    (void) counter;
+    return false;
+#endif
+}
+
+#endif /* _REFOS_CYCLE_COUNTER_H_ */
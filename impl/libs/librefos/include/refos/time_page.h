@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*! @file
+    @brief RefOS shared time page.
+
+    The timer server publishes the current time on a shared page, which clients datamap read-only
+    once and then read the time off directly, without any IPC. The page is protected by a sequence
+    lock: the timer server (the only writer) makes the sequence number odd while updating, and
+    readers retry if the sequence number was odd or changed while they were reading.
+
+    The timer server also publishes the cycle counter value at the time of the update along with a
+    calibrated scale, so readers may extrapolate the time past the last update. Until the counter
+    has been calibrated, the time read is the time of the last update, which the timer server keeps
+    within a tick period of the real time. The time page is only published on architectures with a
+    user-readable cycle counter; elsewhere, clients read the time from the timer over IPC.
+*/
+
+#ifndef _REFOS_TIME_PAGE_H_
+#define _REFOS_TIME_PAGE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cycle_counter.h"
+
+#define REFOS_TIME_PAGE_MAGIC 0x71AE9A6E
+#define REFOS_TIME_PAGE_DSPACE_NAME "timepage"
+
+/*! Fixed point shift of counterMult; ns = (counter delta * counterMult) >> shift. */
+#define REFOS_TIME_PAGE_SCALE_SHIFT 24
+
+/*! @brief Shared time page layout. */
+struct refos_time_page {
+    uint32_t magic;
+    volatile uint32_t seq;
+
+    uint64_t time; /*!< Time in nanoseconds at the last update. */
+    uint64_t counterSnapshot; /*!< Cycle counter value at the last update. */
+    uint64_t counterMult; /*!< Nanoseconds per counter tick, fixed point. 0 if no counter. */
+};
+
+/*! @brief Read the current time off a shared time page.
+    @param tp The mapped time page. (No ownership)
+    @return The current time in nanoseconds.
+*/
+static inline uint64_t
+refos_time_page_read(const struct refos_time_page *tp)
+{
+    uint32_t seq;
+    uint64_t time, snapshot, mult;
+    do {
+        seq = tp->seq;
+        __sync_synchronize();
+        time = tp->time;
+        snapshot = tp->counterSnapshot;
+        mult = tp->counterMult;
+        __sync_synchronize();
+    } while ((seq & 1) || seq != tp->seq);
+
+    uint64_t counter;
+    if (mult && refos_read_cycle_counter(&counter) && counter > snapshot) {
+        time += ((counter - snapshot) * mult) >> REFOS_TIME_PAGE_SCALE_SHIFT;
+    }
+    return time;
+}
+
+/*! @brief Update a shared time page. Only the owner (timer server) should call this.
+    @param tp The mapped time page. (No ownership)
+    @param time The current time in nanoseconds.
+    @param counterSnapshot The cycle counter value at the given time.
+    @param counterMult The fixed point counter scale, 0 if no counter.
+*/
+static inline void
+refos_time_page_write(struct refos_time_page *tp, uint64_t time, uint64_t counterSnapshot,
+                      uint64_t counterMult)
+{
+    tp->seq++;
+    __sync_synchronize();
+    tp->time = time;
+    tp->counterSnapshot = counterSnapshot;
+    tp->counterMult = counterMult;
+    __sync_synchronize();
+    tp->seq++;
+}
+
+#endif /* _REFOS_TIME_PAGE_H_ */
@@ -14,8 +14,136 @@
 #include <refos-rpc/name_client_helper.h>
 #include <refos-rpc/proc_client.h>
 #include <refos-rpc/proc_client_helper.h>
+#include <refos-util/cspace.h>
 #include <refos-util/dprintf.h>
 
+/*! @brief A cached name resolution, mapping a mount prefix to the anon cap of its server. */
+struct nsv_cache_entry {
+    bool valid;
+    char prefix[NAMESERV_PATH_MAXLEN];
+    int prefixLen;
+    seL4_CPtr serverAnon; /* Has ownership. */
+    uint32_t lastUsed;
+};
+
+static struct nsv_cache_entry nsvCache[NAMESERV_CACHE_SIZE];
+static uint32_t nsvCacheClock = 0;
+
+/*! @brief Copy an anon cap into a newly allocated cslot.
+    @return The copied cap on success (Ownership given), 0 if the cap could not be copied (eg. the
+            server has died and the cap has been deleted).
+*/
+static seL4_CPtr
+nsv_cache_copy_cap(seL4_CPtr cap)
+{
+    seL4_CPtr copy = csalloc();
+    if (!copy) {
+        return 0;
+    }
+    int error = seL4_CNode_Copy (
+        REFOS_CSPACE, copy, REFOS_CDEPTH,
+        REFOS_CSPACE, cap, REFOS_CDEPTH,
+        seL4_AllRights
+    );
+    if (error != seL4_NoError) {
+        csfree(copy);
+        return 0;
+    }
+    return copy;
+}
+
+static void
+nsv_cache_release_entry(struct nsv_cache_entry *e)
+{
+    if (!e->valid) {
+        return;
+    }
+    proc_del_endpoint(e->serverAnon);
+    memset(e, 0, sizeof(struct nsv_cache_entry));
+}
+
+/*! @brief Find the cached resolution with the longest prefix of the given path.
+    @return The matching cache entry if found, NULL otherwise.
+*/
+static struct nsv_cache_entry *
+nsv_cache_lookup(const char *path)
+{
+    struct nsv_cache_entry *match = NULL;
+    for (int i = 0; i < NAMESERV_CACHE_SIZE; i++) {
+        struct nsv_cache_entry *e = &nsvCache[i];
+        if (!e->valid || (match && match->prefixLen >= e->prefixLen)) {
+            continue;
+        }
+        if (!strncmp(path, e->prefix, e->prefixLen)) {
+            match = e;
+        }
+    }
+    if (match) {
+        match->lastUsed = ++nsvCacheClock;
+    }
+    return match;
+}
+
+/*! @brief Remember the server resolved for the given mount prefix, replacing any previous entry
+           for the prefix, or else the least recently used entry.
+    @param prefix The mount prefix.
+    @param prefixLen The length of the mount prefix.
+    @param serverAnon The anon cap of the resolved server. (No ownership)
+*/
+static void
+nsv_cache_insert(const char *prefix, int prefixLen, seL4_CPtr serverAnon)
+{
+    if (prefixLen <= 0 || prefixLen >= NAMESERV_PATH_MAXLEN) {
+        return;
+    }
+    struct nsv_cache_entry *victim = NULL;
+    for (int i = 0; i < NAMESERV_CACHE_SIZE; i++) {
+        struct nsv_cache_entry *e = &nsvCache[i];
+        if (e->valid && e->prefixLen == prefixLen && !strncmp(e->prefix, prefix, prefixLen)) {
+            victim = e;
+            break;
+        }
+        if (!victim || (victim->valid && (!e->valid || e->lastUsed < victim->lastUsed))) {
+            victim = e;
+        }
+    }
+    assert(victim);
+
+    seL4_CPtr copy = nsv_cache_copy_cap(serverAnon);
+    if (!copy) {
+        return;
+    }
+    nsv_cache_release_entry(victim);
+    victim->valid = true;
+    strncpy(victim->prefix, prefix, prefixLen);
+    victim->prefix[prefixLen] = '\0';
+    victim->prefixLen = prefixLen;
+    victim->serverAnon = copy;
+    victim->lastUsed = ++nsvCacheClock;
+}
+
+void
+nsv_cache_invalidate(const char *prefix)
+{
+    for (int i = 0; i < NAMESERV_CACHE_SIZE; i++) {
+        struct nsv_cache_entry *e = &nsvCache[i];
+        if (e->valid && (!prefix || !strcmp(e->prefix, prefix))) {
+            nsv_cache_release_entry(e);
+        }
+    }
+}
+
+refos_err_t
+nsv_unregister_server(seL4_CPtr nameserv, char *name)
+{
+    refos_err_t error = nsv_unregister(nameserv, name);
+    if (error == ESUCCESS) {
+        /* The name may be cached under any prefix, so drop everything; unregistering is rare. */
+        nsv_cache_invalidate(NULL);
+    }
+    return error;
+}
+
 static bool
 nsv_check_path_resolved(char* path)
 {
@@ -64,6 +192,20 @@ nsv_resolve(char* path)
     char *cpath = path;
     seL4_CPtr nameServer = REFOS_NAMESERV_EP;
 
+    /* Skip the prefix we have already resolved before, if any. */
+    struct nsv_cache_entry *cached = nsv_cache_lookup(path);
+    if (cached) {
+        seL4_CPtr cachedServer = nsv_cache_copy_cap(cached->serverAnon);
+        if (cachedServer) {
+            nameServer = cachedServer;
+            cpath = path + cached->prefixLen;
+            ret.cached = true;
+        } else {
+            /* The cached cap has gone away along with its server. */
+            nsv_cache_release_entry(cached);
+        }
+    }
+
     while (1) {
         int resolvedBytes = 0;
         seL4_CPtr nextNameServer = 0;
@@ -81,6 +223,9 @@ nsv_resolve(char* path)
             ret.nameservRoot = REFOS_NAMESERV_EP;
             strcpy(ret.dspaceName, cpath);
             strncpy(ret.nameservPathPrefix, path, cpath - path);
+            if (nameServer != REFOS_NAMESERV_EP && (!cached || cpath - path > cached->prefixLen)) {
+                nsv_cache_insert(path, cpath - path, nameServer);
+            }
             REFOS_SET_ERRNO(ESUCCESS);
             return ret;
         }
@@ -94,6 +239,11 @@ nsv_resolve(char* path)
 
         /* Was resolve invalid? */
         if (resolvedBytes == 0) {
+            if (ret.cached) {
+                /* The cached name server may be stale; try again from the root. */
+                nsv_cache_release_entry(cached);
+                return nsv_resolve(path);
+            }
             ret.success = false;
             REFOS_SET_ERRNO(ESERVERNOTFOUND);
             return ret;
@@ -23,22 +23,51 @@ serv_special_connectless_server(seL4_CPtr anon) {
     return (anon == REFOS_NAMESERV_EP || anon == REFOS_PROCSERV_EP);
 }
 
+refos_err_t
+serv_connection_setup_param_buffer(serv_connection_t *sc)
+{
+    assert(sc && sc->serverSession);
+    if (sc->paramBuffer.err == ESUCCESS && sc->paramBuffer.vaddr != NULL) {
+        /* Parameter buffer has already been set up. */
+        return ESUCCESS;
+    }
+
+    /* Create and map the parameter buffer dataspace on our side. */
+    sc->paramBuffer = data_open_map(REFOS_PROCSERV_EP, "anon", 0, 0,
+                                    PROCESS_PARAM_DEFAULTSIZE, -1);
+    if (sc->paramBuffer.err != ESUCCESS) {
+        _svprintf("    WARNING: Failed to create param buffer dspace.\n");
+        refos_err_t error = sc->paramBuffer.err;
+        sc->paramBuffer.err = -1;
+        return error;
+    }
+    assert(sc->paramBuffer.window && sc->paramBuffer.dataspace);
+    assert(sc->paramBuffer.vaddr != NULL);
+
+    /* Set this parameter buffer on server. */
+    refos_err_t error = serv_set_param_buffer(sc->serverSession, sc->paramBuffer.dataspace,
+                                              PROCESS_PARAM_DEFAULTSIZE);
+    if (error) {
+        _svprintf("    Failed to set remote server parameter buffer.");
+        data_mapping_release(sc->paramBuffer);
+        memset(&sc->paramBuffer, 0, sizeof(data_mapping_t));
+        sc->paramBuffer.err = -1;
+        return error;
+    }
+
+    return ESUCCESS;
+}
+
 static serv_connection_t
-serv_connect_internal(char *serverPath, bool paramBuffer)
+serv_connect_resolved_internal(nsv_mountpoint_t *mountPoint, bool paramBuffer)
 {
-    _svprintf("Connecting to server [%s]...\n", serverPath);
     serv_connection_t sc;
     memset(&sc, 0, sizeof(serv_connection_t));
     sc.error = EINVALID;
 
-    /* Resolve server path to find the server's anon cap. */
-    _svprintf("    Querying nameserv to find anon cap for [%s]....\n", serverPath);
-    sc.serverMountPoint = nsv_resolve(serverPath);
-    if (!sc.serverMountPoint.success || ROS_ERRNO() != ESUCCESS) {
-        _svprintf("    WARNING: Server not found.\n");
-        sc.error = ESERVERNOTFOUND;
-        goto exit1;
-    }
+    /* Take ownership of the resolved mount point. */
+    sc.serverMountPoint = *mountPoint;
+    memset(mountPoint, 0, sizeof(nsv_mountpoint_t));
 
     _svprintf("    Result path prefix [%s] anon 0x%x dspace [%s]....\n",
         sc.serverMountPoint.nameservPathPrefix, sc.serverMountPoint.serverAnon,
@@ -53,7 +82,7 @@ serv_connect_internal(char *serverPath, bool paramBuffer)
     } else {
         /* Make connection request to server using the anon cap. */
         _svprintf("    Make connection request to server [%s] using the anon cap 0x%x...\n",
-                serverPath, sc.serverMountPoint.serverAnon);
+                sc.serverMountPoint.nameservPathPrefix, sc.serverMountPoint.serverAnon);
         sc.serverSession = serv_connect_direct(sc.serverMountPoint.serverAnon, REFOS_LIVENESS,
                                                &sc.error);
     }
@@ -72,36 +101,21 @@ serv_connect_internal(char *serverPath, bool paramBuffer)
 
     /* Set up the parameter buffer between client (ie. us) and server. */
     if (paramBuffer) {
-        sc.paramBuffer = data_open_map(REFOS_PROCSERV_EP, "anon", 0, 0,
-                                       PROCESS_PARAM_DEFAULTSIZE, -1);
-        if (sc.paramBuffer.err != ESUCCESS) {
-            _svprintf("    WARNING: Failed to create param buffer dspace.\n");
-            sc.error = sc.paramBuffer.err;
-            goto exit3;
-        }
-        assert(sc.paramBuffer.window && sc.paramBuffer.dataspace);
-        assert(sc.paramBuffer.vaddr != NULL);
-
-        /* Set this parameter buffer on server. */
-        error = serv_set_param_buffer(sc.serverSession, sc.paramBuffer.dataspace,
-                                      PROCESS_PARAM_DEFAULTSIZE);
+        error = serv_connection_setup_param_buffer(&sc);
         if (error) {
-            _svprintf("    Failed to set remote server parameter buffer.");
             sc.error = error;
-            goto exit4;
+            goto exit3;
         }
     } else {
         sc.paramBuffer.err = -1;
     }
 
-    _svprintf("Successfully connected to server [%s]!\n", serverPath);
+    _svprintf("Successfully connected to server [%s]!\n",
+              sc.serverMountPoint.nameservPathPrefix);
     sc.error = ESUCCESS;
     return sc;
 
     /* Exit stack. */
-exit4:
-    assert(sc.paramBuffer.err == ESUCCESS);
-    data_mapping_release(sc.paramBuffer);
 exit3:
     assert(sc.serverSession);
     if (!sc.connectionLess) {
@@ -110,12 +124,53 @@ exit3:
         csfree(sc.serverSession);
     }
 exit2:
+    if (sc.serverMountPoint.cached) {
+        /* The server may have died since we cached its resolution. */
+        nsv_cache_invalidate(sc.serverMountPoint.nameservPathPrefix);
+    }
     nsv_mountpoint_release(&sc.serverMountPoint);
-exit1:
     assert(sc.error != ESUCCESS);
     return sc;
 }
 
+static serv_connection_t
+serv_connect_internal(char *serverPath, bool paramBuffer)
+{
+    _svprintf("Connecting to server [%s]...\n", serverPath);
+
+    /* Resolve server path to find the server's anon cap. */
+    _svprintf("    Querying nameserv to find anon cap for [%s]....\n", serverPath);
+    nsv_mountpoint_t mountPoint = nsv_resolve(serverPath);
+    if (!mountPoint.success || ROS_ERRNO() != ESUCCESS) {
+        _svprintf("    WARNING: Server not found.\n");
+        serv_connection_t sc;
+        memset(&sc, 0, sizeof(serv_connection_t));
+        sc.error = ESERVERNOTFOUND;
+        return sc;
+    }
+
+    bool cached = mountPoint.cached;
+    serv_connection_t sc = serv_connect_resolved_internal(&mountPoint, paramBuffer);
+    if (sc.error != ESUCCESS && cached) {
+        /* The cached resolution has been dropped by now; resolve from scratch and retry once. */
+        _svprintf("    Cached server connection failed, retrying...\n");
+        mountPoint = nsv_resolve(serverPath);
+        if (!mountPoint.success || ROS_ERRNO() != ESUCCESS) {
+            sc.error = ESERVERNOTFOUND;
+            return sc;
+        }
+        sc = serv_connect_resolved_internal(&mountPoint, paramBuffer);
+    }
+    return sc;
+}
+
+serv_connection_t
+serv_connect_resolved(nsv_mountpoint_t *mountPoint)
+{
+    assert(mountPoint && mountPoint->success);
+    return serv_connect_resolved_internal(mountPoint, false);
+}
+
 serv_connection_t
 serv_connect(char *serverPath)
 {
@@ -6,6 +6,7 @@
 
 #include <refos-util/nameserv.h>
 #include <data_struct/cvector.h>
+#include <data_struct/chash.h>
 
 /*! @file
     @brief Name server implementation library. */
@@ -38,8 +39,11 @@ nameserv_create_entry(const char* name, seL4_CPtr anonEP)
 
     /* Fill in the data. */
     strcpy(entry->name, name);
+    entry->nameLen = nameLen;
+    entry->hash = chash_hash_bytes(name, nameLen);
     entry->magic = REFOS_NAMESERV_ENTRY_MAGIC;
     entry->anonEP = anonEP;
+    entry->next = NULL;
 
     return entry;
 }
@@ -63,19 +67,22 @@ nameserv_init(nameserv_state_t *n, void (*free_cap) (seL4_CPtr cap))
     assert(n && free_cap);
     n->magic = REFOS_NAMESERV_MAGIC;
     n->free_capability = free_cap;
-    cvector_init(&n->entries);
+    memset(n->buckets, 0, sizeof(n->buckets));
 }
 
 void
 nameserv_release(nameserv_state_t *n)
 {
     assert(n && n->magic == REFOS_NAMESERV_MAGIC);
-    int nEntries = cvector_count(&n->entries);
-    for (int i = 0; i < nEntries; i++) {
-        nameserv_entry_t *nameEntry = (nameserv_entry_t *) cvector_get(&n->entries, i);
-        nameserv_release_entry(n, nameEntry);
+    for (int i = 0; i < REFOS_NAMESERV_HASH_SIZE; i++) {
+        nameserv_entry_t *nameEntry = n->buckets[i];
+        while (nameEntry) {
+            nameserv_entry_t *next = nameEntry->next;
+            nameserv_release_entry(n, nameEntry);
+            nameEntry = next;
+        }
+        n->buckets[i] = NULL;
     }
-    cvector_free(&n->entries);
     n->magic = 0;
 }
 
@@ -91,40 +98,52 @@ nameserv_add(nameserv_state_t *n, const char* name, seL4_CPtr anonEP)
     if (!nameEntry) {
         return ENOMEM;
     }
-    cvector_add(&n->entries, (cvector_item_t) nameEntry);
+    nameserv_entry_t **bucket = &n->buckets[nameEntry->hash & (REFOS_NAMESERV_HASH_SIZE - 1)];
+    nameEntry->next = *bucket;
+    *bucket = nameEntry;
     return ESUCCESS;
 }
 
-static int
-nameserv_find_entry_index(nameserv_state_t *n, const char* name)
+/*! @brief Find the link pointing to the entry with the given name.
+    @param n The nameserver list.
+    @param name The name to look for. Does not need to be NULL-terminated.
+    @param nameLen The length of the name.
+    @return Pointer to the link pointing to the matching entry if found, NULL otherwise.
+*/
+static nameserv_entry_t**
+nameserv_find_entry(nameserv_state_t *n, const char* name, uint32_t nameLen)
 {
     assert(n && n->magic == REFOS_NAMESERV_MAGIC);
     if (!name) {
-        return -1;
-    }
-    int nEntries = cvector_count(&n->entries);
-    /* Loop through the list and find a matching name. */
-    for (int i = 0; i < nEntries; i++) {
-        nameserv_entry_t *nameEntry = (nameserv_entry_t *) cvector_get(&n->entries, i);
-        assert(nameEntry && nameEntry->name && nameEntry->magic == REFOS_NAMESERV_ENTRY_MAGIC);
-        if (!strcmp(nameEntry->name, name)) {
-            return i;
+        return NULL;
+    }
+    uint32_t hash = chash_hash_bytes(name, nameLen);
+    nameserv_entry_t **link = &n->buckets[hash & (REFOS_NAMESERV_HASH_SIZE - 1)];
+    for (; *link; link = &(*link)->next) {
+        nameserv_entry_t *nameEntry = *link;
+        assert(nameEntry->name && nameEntry->magic == REFOS_NAMESERV_ENTRY_MAGIC);
+        if (nameEntry->hash == hash && nameEntry->nameLen == nameLen &&
+                !strncmp(nameEntry->name, name, nameLen)) {
+            return link;
         }
     }
-    return -1;
+    return NULL;
 }
 
 void
 nameserv_delete(nameserv_state_t *n, const char* name)
 {
     assert(n && n->magic == REFOS_NAMESERV_MAGIC);
-    int idx = nameserv_find_entry_index(n, name);
-    if (idx == -1) {
+    if (!name) {
+        return;
+    }
+    nameserv_entry_t **link = nameserv_find_entry(n, name, strlen(name));
+    if (!link) {
         return;
     }
-    nameserv_entry_t *nameEntry = (nameserv_entry_t *) cvector_get(&n->entries, idx);
+    nameserv_entry_t *nameEntry = *link;
+    *link = nameEntry->next;
     nameserv_release_entry(n, nameEntry);
-    cvector_delete(&n->entries, idx);
 }
 
 int
@@ -147,40 +166,23 @@ nameserv_resolve(nameserv_state_t *n, const char* path, seL4_CPtr *outAnonCap)
         path_++;
     }
 
-    /* Allocate temporary buffer to store path segment. */
-    char *pathSegment = malloc(sizeof(char) * (pathLen + 2));
-    if (!pathSegment) {
-        printf("ERROR: nameserv_resolve could not allocate path segment. OOM.\n");
-        return 0;
-    }
-    int pathSegmentIndex = 0;
-
     /* Find the next slash-separated path segment. */
-    bool segmentFound = false;
-    const char* ci;
-    for (ci = path_; *ci != '\0'; ci++) {
-        if (*ci == '/') {
-            segmentFound = true;
-            break;
-        }
-        pathSegment[pathSegmentIndex++] = *ci;
-    }
-    pathSegment[pathSegmentIndex++] = '\0';
+    const char* ci = strchr(path_, '/');
 
     /* If are at end of path resolvation, return our own anonymous endpoint. */
-    if (!segmentFound) {
+    if (!ci) {
         return REFOS_NAMESERV_RESOLVED;
     }
 
     /* Otherwise, find the external anon endpoint. */
-    int idx = nameserv_find_entry_index(n, pathSegment);
-    if (idx == -1) {
+    nameserv_entry_t **link = nameserv_find_entry(n, path_, ci - path_);
+    if (!link) {
         /* Name not found. */
         return 0;
     }
 
     /* External EP name resolvation succeeded. */
-    nameserv_entry_t *nameEntry = (nameserv_entry_t *) cvector_get(&n->entries, idx);
+    nameserv_entry_t *nameEntry = *link;
     assert(nameEntry && nameEntry->name && nameEntry->magic == REFOS_NAMESERV_ENTRY_MAGIC);
     if (outAnonCap) {
         (*outAnonCap) = nameEntry->anonEP;
@@ -188,4 +190,4 @@ nameserv_resolve(nameserv_state_t *n, const char* path, seL4_CPtr *outAnonCap)
     int offset = ci - path;
     assert(offset >= 0 && offset < pathLen);
     return offset;
-}
\ No newline at end of file
+}
@@ -21,6 +21,7 @@
 #include <refos-rpc/proc_client_helper.h>
 #include <refos-rpc/name_client.h>
 #include <refos-rpc/name_client_helper.h>
+#include <refos-rpc/data_client.h>
 
 /* -------------------- Server Default Client Table Handler Helpers ----------------------------- */
 
@@ -81,6 +82,9 @@ srv_ctable_set_param_buffer_handler(srv_common_t *srv, struct srv_client *c,
     assert(srv && srv->magic == SRV_MAGIC);
     assert(c && m);
 
+    /* Release any previous server-side mapping of the parameter buffer. */
+    client_unmap_param_buffer(c);
+
     /* Special case: unset the parameter buffer. */
     if (!parambufferDataspace && parambufferSize == 0) {
         seL4_CNode_Revoke(REFOS_CSPACE, c->paramBuffer, REFOS_CDEPTH);
@@ -106,6 +110,19 @@ srv_ctable_set_param_buffer_handler(srv_common_t *srv, struct srv_client *c,
         ROS_ERROR("Failed to copyout the cap.");
         return ENOMEM;
     }
+
+    /* The declared size bounds every later parameter buffer access on the client's behalf, so
+       it must not run past the end of the dataspace actually backing it. */
+    uint32_t dspaceSize = data_get_size(REFOS_PROCSERV_EP, c->paramBuffer);
+    if (parambufferSize > dspaceSize) {
+        ROS_WARNING("Param buffer size 0x%x exceeds its dataspace size 0x%x.", parambufferSize,
+                    dspaceSize);
+        seL4_CNode_Delete(REFOS_CSPACE, c->paramBuffer, REFOS_CDEPTH);
+        csfree(c->paramBuffer);
+        c->paramBuffer = 0;
+        c->paramBufferSize = 0;
+        return EINVALIDPARAM;
+    }
     c->paramBufferSize = parambufferSize;
     dprintf("Set param buffer for client cID = %d...\n", c->cID);
 
@@ -319,6 +336,8 @@ srv_dispatch_notification(srv_common_t *srv, srv_common_notify_handler_callbacks
                 break;
             }
         case PROCSERV_NOTIFY_DEATH:
+            /* The dead client may have been a server we have resolved before. */
+            nsv_cache_invalidate(NULL);
             if (callbacks.handle_server_death_notification) {
                 error = callbacks.handle_server_death_notification(notification);
                 break;
@@ -11,6 +11,8 @@
 #include <refos/refos.h>
 #include <refos-util/serv_connect.h>
 #include <refos-util/cspace.h>
+#include <refos-util/walloc.h>
+#include <refos-rpc/data_client.h>
 
 /*! @file
     @brief Server client connection module implementation. */
@@ -34,6 +36,8 @@ client_oat_create(coat_t *oat, int id, uint32_t arg[COAT_ARGS])
     nclient->deathID = -1;
     nclient->paramBufferStart = 0;
     nclient->paramBuffer = 0;
+    nclient->paramBufferWindow = 0;
+    nclient->paramBufferVaddr = NULL;
 
     /* Mint a session cap. */
     nclient->session = csalloc();
@@ -85,6 +89,7 @@ client_oat_delete(coat_t *oat, cvector_item_t *obj)
         csfree(client->session);
     }
 
+    client_unmap_param_buffer(client);
     if (client->paramBuffer) {
         //seL4_CNode_Revoke(REFOS_CSPACE, client->paramBuffer, REFOS_CDEPTH); // FIXME REVOKE BUG
         seL4_CNode_Delete(REFOS_CSPACE, client->paramBuffer, REFOS_CDEPTH);
@@ -216,3 +221,54 @@ client_queue_delete_deathID(struct srv_client_table *ct, int deathID)
     }
     return -1;
 }
+
+char*
+client_map_param_buffer(struct srv_client *c)
+{
+    assert(c);
+    if (c->paramBufferVaddr) {
+        /* Already mapped. */
+        return c->paramBufferVaddr;
+    }
+    if (!c->paramBuffer || !c->paramBufferSize) {
+        return NULL;
+    }
+
+    /* Allocate a window to map the param buffer into. */
+    int npages = (c->paramBufferSize / REFOS_PAGE_SIZE) +
+                 ((c->paramBufferSize % REFOS_PAGE_SIZE) ? 1 : 0);
+    seL4_Word vaddr = walloc(npages, &c->paramBufferWindow);
+    if (!vaddr || !c->paramBufferWindow) {
+        printf("ERROR: client_map_param_buffer could not allocate window.\n");
+        c->paramBufferWindow = 0;
+        return NULL;
+    }
+
+    /* Map the param buffer dataspace into the window. */
+    int error = data_datamap(REFOS_PROCSERV_EP, c->paramBuffer, c->paramBufferWindow, 0);
+    if (error != ESUCCESS) {
+        printf("ERROR: client_map_param_buffer could not datamap param buffer.\n");
+        walloc_free(vaddr, npages);
+        c->paramBufferWindow = 0;
+        return NULL;
+    }
+
+    c->paramBufferVaddr = (char*) vaddr;
+    return c->paramBufferVaddr;
+}
+
+void
+client_unmap_param_buffer(struct srv_client *c)
+{
+    assert(c);
+    if (!c->paramBufferVaddr) {
+        return;
+    }
+    assert(c->paramBufferWindow);
+    int npages = (c->paramBufferSize / REFOS_PAGE_SIZE) +
+                 ((c->paramBufferSize % REFOS_PAGE_SIZE) ? 1 : 0);
+    data_dataunmap(REFOS_PROCSERV_EP, c->paramBufferWindow);
+    walloc_free((uint32_t) c->paramBufferVaddr, npages);
+    c->paramBufferWindow = 0;
+    c->paramBufferVaddr = NULL;
+}
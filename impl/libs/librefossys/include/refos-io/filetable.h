@@ -11,6 +11,7 @@
 #include <refos/refos.h>
 #include <refos/error.h>
 #include <data_struct/coat.h>
+#include <data_struct/cvector.h>
 
 #define FD_TABLE_MAGIC 0xA6B1063F
 #define FD_TABLE_BASE 3 /* 0, 1 and 2 are stdin, stdout and stderr. */
@@ -19,6 +20,9 @@ typedef struct fd_table_s {
     coat_t table; /* fd_table_entry_*_t, Inherited, must be first. */
     uint32_t tableSize;
     uint32_t magic;
+
+    /* Server connections shared between FDs, one per mount point. */
+    cvector_t connections; /* fd_table_connection_t */
 } fd_table_t;
 
 void filetable_init(fd_table_t *fdt, uint32_t tableSize);
@@ -27,6 +31,8 @@ void filetable_release(fd_table_t *fdt);
 
 int filetable_dspace_open(fd_table_t *fdt, char* filePath, int flags, int mode, int size);
 
+refos_err_t filetable_dspace_unlink(fd_table_t *fdt, char* filePath);
+
 int filetable_close(fd_table_t *fdt, int fd);
 
 refos_err_t filetable_lseek(fd_table_t *fdt, int fd, int *offset, int whence);
@@ -20,6 +20,7 @@
 #include <refos-rpc/serv_client_helper.h>
 
 struct sl_procinfo_s;
+struct refos_time_page;
 
 typedef struct refos_io_internal_state {
     /* STDIO read / write override functions. One example where this comps in handy is the OS
@@ -54,6 +55,7 @@ typedef struct refos_io_internal_state {
 
     /*! Timer state. */
     FILE * timerFD;
+    struct refos_time_page *timePage; /*!< Shared time page, mapped read-only. NULL if none. */
 } refos_io_internal_state_t;
 
 extern refos_io_internal_state_t refosIOState;
@@ -13,6 +13,7 @@
 
 #include <refos/refos.h>
 #include <refos/error.h>
+#include <refos/vmlayout.h>
 #include <refos-io/filetable.h>
 #include <refos-io/internal_state.h>
 #include <refos-rpc/serv_client.h>
@@ -24,19 +25,99 @@
 #define FD_TABLE_ENTRY_TYPE_DATASPACE 1
 
 #define FD_TABLE_ENTRY_DATASPACE_MAGIC 0x4E6CC517
+#define FD_TABLE_CONNECTION_MAGIC 0x2C19D0B4
 #define FD_TABLE_DATASPACE_IPC_MAXLEN 32
+#define FD_TABLE_DATASPACE_BULK_MAXLEN PROCESS_PARAM_DEFAULTSIZE
+
+/*! A server connection, shared by every FD opened on the server at the same mount point. This
+    saves connecting to, and being watched by, the server again on every open. */
+typedef struct fd_table_connection_s {
+    int magic;
+    uint32_t ref;
+    serv_connection_t connection;
+
+    /* Whether read / write through the connection's shared parameter buffer is unavailable. */
+    bool bulkUnsupported;
+} fd_table_connection_t;
 
 typedef struct fd_table_entry_dataspace_s {
     char type; /* FD_TABLE_ENTRY_TYPE. Inherited, must be first. */
     int magic;
     int fd;
 
-    serv_connection_t connection;
+    fd_table_connection_t *conn; /* Shared ownership. */
     seL4_CPtr dspace;
     int32_t dspacePos;
     uint32_t dspaceSize;
 } fd_table_entry_dataspace_t;
 
+/* ----------------------------- Filetable connection functions --------------------------------- */
+
+/*! @brief Get a shared connection to the server at the given mount point, connecting to it if we
+           don't have one already.
+    @param fdt The filetable.
+    @param mountPoint The resolved mount point of the server. (Takes ownership)
+    @return The shared connection, with a reference taken, on success. NULL otherwise.
+*/
+static fd_table_connection_t *
+filetable_connection_get(fd_table_t *fdt, nsv_mountpoint_t *mountPoint)
+{
+    int count = cvector_count(&fdt->connections);
+    for (int i = 0; i < count; i++) {
+        fd_table_connection_t *c = (fd_table_connection_t *) cvector_get(&fdt->connections, i);
+        assert(c && c->magic == FD_TABLE_CONNECTION_MAGIC);
+        if (!strcmp(c->connection.serverMountPoint.nameservPathPrefix,
+                    mountPoint->nameservPathPrefix)) {
+            nsv_mountpoint_release(mountPoint);
+            c->ref++;
+            return c;
+        }
+    }
+
+    fd_table_connection_t *c = malloc(sizeof(fd_table_connection_t));
+    if (!c) {
+        nsv_mountpoint_release(mountPoint);
+        return NULL;
+    }
+    memset(c, 0, sizeof(fd_table_connection_t));
+    c->magic = FD_TABLE_CONNECTION_MAGIC;
+    c->connection = serv_connect_resolved(mountPoint);
+    if (c->connection.error != ESUCCESS || !c->connection.serverSession) {
+        free(c);
+        return NULL;
+    }
+    if (cvector_add(&fdt->connections, (cvector_item_t) c) < 0) {
+        serv_disconnect(&c->connection);
+        free(c);
+        return NULL;
+    }
+    c->ref = 1;
+    return c;
+}
+
+/*! @brief Drop a reference to a shared connection, disconnecting from the server after the last.
+    @param fdt The filetable.
+    @param c The shared connection. (Takes ownership)
+*/
+static void
+filetable_connection_put(fd_table_t *fdt, fd_table_connection_t *c)
+{
+    assert(c && c->magic == FD_TABLE_CONNECTION_MAGIC && c->ref > 0);
+    if (--c->ref > 0) {
+        return;
+    }
+    int count = cvector_count(&fdt->connections);
+    for (int i = 0; i < count; i++) {
+        if (cvector_get(&fdt->connections, i) == (cvector_item_t) c) {
+            cvector_delete(&fdt->connections, i);
+            break;
+        }
+    }
+    serv_disconnect(&c->connection);
+    c->magic = 0x0;
+    free(c);
+}
+
 /* ----------------------------- Filetable OAT functions ---------------------------------------- */
 
 static cvector_item_t
@@ -85,8 +166,8 @@ filetable_oat_delete(coat_t *oat, cvector_item_t *obj)
             assert(e->magic == FD_TABLE_ENTRY_DATASPACE_MAGIC);
 
             /* Delete dataspace. */
-            if (e->connection.serverSession && e->dspace) {
-                refos_err_t error = data_close(e->connection.serverSession, e->dspace);
+            if (e->conn && e->dspace) {
+                refos_err_t error = data_close(e->conn->connection.serverSession, e->dspace);
                 if (error != ESUCCESS) {
                     printf("filetable_oat_delete error: couldn't close dspace.\n");
                     return;
@@ -95,10 +176,10 @@ filetable_oat_delete(coat_t *oat, cvector_item_t *obj)
                 e->dspace = 0;
             }
 
-            /* Disconnect from server. */
-            if (e->connection.serverSession) {
-                serv_disconnect(&e->connection);
-                e->connection.serverSession = 0;
+            /* Drop our reference to the server connection. The filetable inherits the OAT. */
+            if (e->conn) {
+                filetable_connection_put((fd_table_t *) oat, e->conn);
+                e->conn = NULL;
             }
 
             e->magic = 0x0;
@@ -120,6 +201,7 @@ filetable_init(fd_table_t *fdt, uint32_t tableSize)
     assert(fdt);
     fdt->magic = FD_TABLE_MAGIC;
     fdt->tableSize = tableSize;
+    cvector_init(&fdt->connections);
 
     /* Initialise FD allocation table. */
     memset(&fdt->table, 0, sizeof(coat_t));
@@ -133,6 +215,8 @@ filetable_release(fd_table_t *fdt)
 {
     assert(fdt && fdt->magic == FD_TABLE_MAGIC);
     coat_release(&fdt->table);
+    assert(cvector_count(&fdt->connections) == 0);
+    cvector_free(&fdt->connections);
     fdt->magic = 0x0;
 }
 
@@ -156,29 +240,37 @@ filetable_dspace_open(fd_table_t *fdt, char* filePath, int flags, int mode, int
         return -ENOMEM;
     }
 
-    /* Connect to the dataspace server. */
+    /* Resolve the path, and get a connection to the dataspace server at its mount point. */
     assert(e->magic == FD_TABLE_ENTRY_DATASPACE_MAGIC);
-    e->connection = serv_connect_no_pbuffer(filePath);
-    if (e->connection.error != ESUCCESS || !e->connection.serverSession) {
+    nsv_mountpoint_t mountPoint = nsv_resolve(filePath);
+    if (!mountPoint.success) {
+        error = -ESERVERNOTFOUND;
+        goto exit1;
+    }
+    char dspaceName[NAMESERV_PATH_MAXLEN];
+    strncpy(dspaceName, mountPoint.dspaceName, NAMESERV_PATH_MAXLEN);
+    dspaceName[NAMESERV_PATH_MAXLEN - 1] = '\0';
+    e->conn = filetable_connection_get(fdt, &mountPoint);
+    if (!e->conn) {
         error = -ESERVERNOTFOUND;
         goto exit1;
     }
 
-    /* Open the dataspace on the server. */
-    e->dspace = data_open(e->connection.serverSession,
-            e->connection.serverMountPoint.dspaceName, flags, mode, size, &error);
+    /* Open the dataspace on the server. The size comes back in the same reply. */
+    e->dspace = data_open_size(e->conn->connection.serverSession, dspaceName, flags, mode, size,
+                               &e->dspaceSize, &error);
     if (error || !e->dspace) {
         error = -EFILENOTFOUND;
         goto exit2;
     }
 
-    e->dspaceSize = data_get_size(e->connection.serverSession, e->dspace);
     e->dspacePos = 0;
     return e->fd;
 
     /* Exit stack. */
 exit2:
-    serv_disconnect(&e->connection);
+    filetable_connection_put(fdt, e->conn);
+    e->conn = NULL;
 exit1:
     assert(e && e->fd);
     coat_free(&fdt->table, e->fd);
@@ -186,6 +278,32 @@ exit1:
     return error;
 }
 
+refos_err_t
+filetable_dspace_unlink(fd_table_t *fdt, char* filePath)
+{
+    assert(fdt && fdt->magic == FD_TABLE_MAGIC);
+    if (!filePath) {
+        return EFILENOTFOUND;
+    }
+
+    /* Resolve the path, and get a connection to the dataspace server at its mount point. */
+    nsv_mountpoint_t mountPoint = nsv_resolve(filePath);
+    if (!mountPoint.success) {
+        return ESERVERNOTFOUND;
+    }
+    char dspaceName[NAMESERV_PATH_MAXLEN];
+    strncpy(dspaceName, mountPoint.dspaceName, NAMESERV_PATH_MAXLEN);
+    dspaceName[NAMESERV_PATH_MAXLEN - 1] = '\0';
+    fd_table_connection_t *conn = filetable_connection_get(fdt, &mountPoint);
+    if (!conn) {
+        return ESERVERNOTFOUND;
+    }
+
+    refos_err_t error = data_unlink(conn->connection.serverSession, dspaceName);
+    filetable_connection_put(fdt, conn);
+    return error;
+}
+
 int
 filetable_close(fd_table_t *fdt, int fd)
 {
@@ -252,6 +370,65 @@ filetable_lseek(fd_table_t *fdt, int fd, int *offset, int whence)
     return ESUCCESS;
 }
 
+static int
+filetable_internal_bulk_read_write(fd_table_entry_dataspace_t *fdEntry, char *buffer,
+                                   int bufferLen, bool read)
+{
+    assert(fdEntry && fdEntry->magic == FD_TABLE_ENTRY_DATASPACE_MAGIC);
+    fd_table_connection_t *conn = fdEntry->conn;
+    if (conn->bulkUnsupported || conn->connection.connectionLess) {
+        return -EUNIMPLEMENTED;
+    }
+
+    serv_connection_t *sc = &conn->connection;
+    if (sc->paramBuffer.vaddr == NULL) {
+        /* Probe the server with an empty transfer before creating a parameter buffer for it, so
+           servers without a bulk path don't cost us a dataspace per connection. */
+        int probe = read ?
+                data_read_parambuffer(sc->serverSession, fdEntry->dspace, fdEntry->dspacePos, 0) :
+                data_write_parambuffer(sc->serverSession, fdEntry->dspace, fdEntry->dspacePos, 0);
+        if (probe == -EUNIMPLEMENTED || probe == -ENOPARAMBUFFER) {
+            conn->bulkUnsupported = true;
+            return -EUNIMPLEMENTED;
+        }
+        if (probe < 0) {
+            return probe;
+        }
+    }
+
+    /* Map the shared parameter buffer, once per connection. */
+    if (serv_connection_setup_param_buffer(sc) != ESUCCESS) {
+        conn->bulkUnsupported = true;
+        return -EUNIMPLEMENTED;
+    }
+    assert(sc->paramBuffer.vaddr);
+
+    if (bufferLen > FD_TABLE_DATASPACE_BULK_MAXLEN) {
+        bufferLen = FD_TABLE_DATASPACE_BULK_MAXLEN;
+    }
+
+    int nr = -EINVALID;
+    if (read) {
+        nr = data_read_parambuffer(sc->serverSession, fdEntry->dspace, fdEntry->dspacePos,
+                                   bufferLen);
+        if (nr > 0) {
+            assert(nr <= bufferLen);
+            memcpy(buffer, sc->paramBuffer.vaddr, nr);
+        }
+    } else {
+        memcpy(sc->paramBuffer.vaddr, buffer, bufferLen);
+        nr = data_write_parambuffer(sc->serverSession, fdEntry->dspace, fdEntry->dspacePos,
+                                    bufferLen);
+    }
+
+    if (nr == -EUNIMPLEMENTED || nr == -ENOPARAMBUFFER) {
+        /* Server doesn't support the bulk path; don't bother trying again on this server. */
+        conn->bulkUnsupported = true;
+        return -EUNIMPLEMENTED;
+    }
+    return nr;
+}
+
 static int
 filetable_internal_read_write(fd_table_t *fdt, int fd, char *buffer, int bufferLen, bool read)
 {
@@ -283,23 +460,25 @@ filetable_internal_read_write(fd_table_t *fdt, int fd, char *buffer, int bufferL
     fd_table_entry_dataspace_t *fdEntry = (fd_table_entry_dataspace_t*) entry;
     assert(fdEntry->magic == FD_TABLE_ENTRY_DATASPACE_MAGIC);
 
-    /* Cap length so we don't overrun IPC buffer.
-       Currently read / write is implemented over IPC, and this is inefficient and somewhat hacky.
-       In the future, file read / write using mapped shared memory should be implemented.
-    */
+    /* Perform the actual dataspace read / write operation. Large transfers go through the shared
+       parameter buffer, which is set up on the connection the first time it is needed. */
+    assert(fdEntry->dspace);
+    int nr = -EUNIMPLEMENTED;
     if (bufferLen > FD_TABLE_DATASPACE_IPC_MAXLEN) {
-        bufferLen = FD_TABLE_DATASPACE_IPC_MAXLEN;
+        nr = filetable_internal_bulk_read_write(fdEntry, buffer, bufferLen, read);
     }
-
-    /* Perform the actual dataspace read / write operation. */
-    assert(fdEntry->dspace);
-    int nr = -EINVALID;
-    if (read) {
-        nr = data_read(fdEntry->connection.serverSession, fdEntry->dspace, fdEntry->dspacePos,
-                       buffer, bufferLen);
-    } else {
-        nr = data_write(fdEntry->connection.serverSession, fdEntry->dspace, fdEntry->dspacePos,
-                       buffer, bufferLen);
+    if (nr == -EUNIMPLEMENTED) {
+        /* Cap length so we don't overrun IPC buffer. */
+        if (bufferLen > FD_TABLE_DATASPACE_IPC_MAXLEN) {
+            bufferLen = FD_TABLE_DATASPACE_IPC_MAXLEN;
+        }
+        if (read) {
+            nr = data_read(fdEntry->conn->connection.serverSession, fdEntry->dspace,
+                           fdEntry->dspacePos, buffer, bufferLen);
+        } else {
+            nr = data_write(fdEntry->conn->connection.serverSession, fdEntry->dspace,
+                            fdEntry->dspacePos, buffer, bufferLen);
+        }
     }
     if (nr < 0) {
         ROS_SET_ERRNO(-nr);
@@ -315,8 +494,10 @@ filetable_internal_read_write(fd_table_t *fdt, int fd, char *buffer, int bufferL
         if (fdEntry->dspacePos > fdEntry->dspaceSize) {
             fdEntry->dspacePos = fdEntry->dspaceSize;
         }
-    } else {
-        fdEntry->dspaceSize = data_get_size(fdEntry->connection.serverSession, fdEntry->dspace);
+    } else if (fdEntry->dspacePos > fdEntry->dspaceSize) {
+        /* Writing past the end grows the dataspace; track the new size locally instead of asking
+           the server for it after every write. */
+        fdEntry->dspaceSize = fdEntry->dspacePos;
     }
 
     ROS_SET_ERRNO(ESUCCESS);
@@ -71,38 +71,30 @@ refosio_init_morecore(struct sl_procinfo_s *procInfo)
 }
 
 int
-refosio_morecore_expand(sl_dataspace_t *region, size_t sizeAdd)
+refosio_morecore_resize(sl_dataspace_t *region, size_t size)
 {
     assert(region && region->dataspace && region->vaddr);
-    if (sizeAdd <= 0) {
+    if (size == region->size) {
         /* Nothing to do here. */
         return ESUCCESS;
     }
     refosio_internal_save_IPC_buffer();
 
-    /* Expand the dataspace. */
-    int error = data_expand(REFOS_PROCSERV_EP, region->dataspace, region->size + sizeAdd);
-    if (error != ESUCCESS) {
-        seL4_DebugPrintf("WARNING: refosio_morecore_expand failed to expand dspace.\n");
-        seL4_DebugPrintf("Client's malloc will be broken.\n");
-        return error;
-    }
-
-    /* Resize the brk window to fit. */
+    /* Resize the brk window and its dataspace together. */
     assert(region->window);
-    error = proc_resize_mem_window(region->window, region->size + sizeAdd);
+    int error = proc_resize_mem_window_dspace(region->window, size);
     if (error != ESUCCESS) {
-        seL4_DebugPrintf("WARNING: refosio_morecore_expand failed to expand window.\n");
+        seL4_DebugPrintf("WARNING: refosio_morecore_resize failed to resize heap.\n");
         seL4_DebugPrintf("Client's malloc will be broken.\n");
         return error;
     }
     refosio_internal_restore_IPC_buffer();
 
 #ifdef CONFIG_REFOS_DEBUG_VERBOSE
-    seL4_DebugPrintf("heap region expand 0x%x --> from 0x%x to 0x%x\n", region->vaddr,
-            region->vaddr + region->size, region->vaddr + region->size + sizeAdd);
+    seL4_DebugPrintf("heap region resize 0x%x --> from 0x%x to 0x%x\n", region->vaddr,
+            region->vaddr + region->size, region->vaddr + size);
 #endif
 
-    region->size += sizeAdd;
+    region->size = size;
     return ESUCCESS;
-}
\ No newline at end of file
+}
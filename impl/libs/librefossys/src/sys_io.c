@@ -272,6 +272,31 @@ sys_open(va_list ap)
     return fd;
 }
 
+long
+sys_unlink(va_list ap)
+{
+    char *pathname = va_arg(ap, char*);
+    static char tempBufferPath[REFOS_SYSIO_MAX_PATHLEN];
+
+    /* Handle the PWD environment variable. */
+    char *pwd = getenv("PWD");
+    if (pwd && strlen(pwd) > 0) {
+        snprintf(tempBufferPath, REFOS_SYSIO_MAX_PATHLEN, "%s%s", getenv("PWD"), pathname);
+        pathname = tempBufferPath;
+    }
+
+    /* Unlink dataspace file. */
+    refos_err_t error = filetable_dspace_unlink(&refosIOState.fdTable, pathname);
+    switch (error) {
+        case ESUCCESS: return 0;
+        case EFILENOTFOUND: return -ENOENT;
+        case ESERVERNOTFOUND: return -ENOENT;
+        case EACCESSDENIED: return -EACCES;
+        case EUNIMPLEMENTED: return -EPERM;
+        default: return -EFAULT;
+    }
+}
+
 long
 _sys_lseek(int fildes, off_t offset, int whence)
 {
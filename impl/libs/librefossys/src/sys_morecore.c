@@ -20,13 +20,49 @@
 
 #define _ENOMEM 12
 
-/*! How many pages of memory to expand the heap every increment.
-    Too small and this leads to many many expensive resizing operations, too large and we allocate
-    all this uneccessary memory and never use it.
+/*! The minimum number of pages of memory to expand the heap every increment. The heap grows
+    geometrically from here, each increment being as large as the current heap, up to
+    CONFIG_REFOS_SYS_HEAP_EXPAND_MAX_NPAGES. Too small and this leads to many many expensive resizing
+    operations, too large and we allocate all this uneccessary memory and never use it.
 */
 #define REFOSIO_HEAP_EXPAND_INCREMENT_NPAGES 2
 
-int refosio_morecore_expand(sl_dataspace_t *region, size_t sizeAdd);
+#ifndef CONFIG_REFOS_SYS_HEAP_EXPAND_MAX_NPAGES
+    #define CONFIG_REFOS_SYS_HEAP_EXPAND_MAX_NPAGES 256
+#endif
+
+#ifndef CONFIG_REFOS_SYS_HEAP_TRIM_THRESHOLD_NPAGES
+    #define CONFIG_REFOS_SYS_HEAP_TRIM_THRESHOLD_NPAGES 64
+#endif
+
+int refosio_morecore_resize(sl_dataspace_t *region, size_t size);
+
+/*! @brief Give unused pages at the top of the dynamic heap back to the process server, if there
+           are enough of them.
+    @param newbrk The new program break, which lies inside the current heap region.
+*/
+static void
+refosio_heap_trim(uintptr_t newbrk)
+{
+#if CONFIG_REFOS_SYS_HEAP_TRIM_THRESHOLD_NPAGES > 0
+    sl_dataspace_t *heap = &refosIOState.procInfo->heapRegion;
+    uint32_t keepNPages = refos_round_up_npages(newbrk + 1 - heap->vaddr) +
+            REFOSIO_HEAP_EXPAND_INCREMENT_NPAGES;
+    uint32_t keepSize = MAX(keepNPages * REFOS_PAGE_SIZE, PROCESS_HEAP_INITIAL_SIZE);
+    if (heap->size < keepSize ||
+            heap->size - keepSize < CONFIG_REFOS_SYS_HEAP_TRIM_THRESHOLD_NPAGES * REFOS_PAGE_SIZE) {
+        return;
+    }
+
+    refosio_internal_save_IPC_buffer();
+    int error = refosio_morecore_resize(heap, keepSize);
+    refosio_internal_restore_IPC_buffer();
+    if (error != ESUCCESS) {
+        /* Not fatal, we simply keep the pages. */
+        seL4_DebugPrintf("WARNING: refos dynamic sbrk failed to trim heap.\n");
+    }
+#endif
+}
 
 long
 sys_brk(va_list ap)
@@ -69,7 +105,8 @@ sys_brk(va_list ap)
         return -ENOMEM;
     } else if (newbrk < refosIOState.procInfo->heapRegion.vaddr +
             refosIOState.procInfo->heapRegion.size) {
-        /* Our current heap region is large enough. */
+        /* Our current heap region is large enough. Give back any excess. */
+        refosio_heap_trim(newbrk);
         return newbrk;
     }
 
@@ -79,12 +116,17 @@ sys_brk(va_list ap)
             (refosIOState.procInfo->heapRegion.vaddr + refosIOState.procInfo->heapRegion.size);
     assert(increaseSize > 0);
     uint32_t increaseSizePages = refos_round_up_npages(increaseSize);
+
+    /* Grow geometrically, by up to the current heap size, but never less than needed. */
+    uint32_t geometricNPages = refos_round_up_npages(refosIOState.procInfo->heapRegion.size);
+    geometricNPages = MIN(geometricNPages, CONFIG_REFOS_SYS_HEAP_EXPAND_MAX_NPAGES);
+    increaseSizePages = MAX(increaseSizePages, geometricNPages);
     increaseSizePages = MAX(increaseSizePages, REFOSIO_HEAP_EXPAND_INCREMENT_NPAGES);
 
     /* Then expand the region and dataspace. */
     refosio_internal_save_IPC_buffer();
-    int error = refosio_morecore_expand(&refosIOState.procInfo->heapRegion,
-            increaseSizePages * REFOS_PAGE_SIZE);
+    int error = refosio_morecore_resize(&refosIOState.procInfo->heapRegion,
+            refosIOState.procInfo->heapRegion.size + increaseSizePages * REFOS_PAGE_SIZE);
     if (error != ESUCCESS) {
         seL4_DebugPrintf("ERROR: refos dynamic sbrk out of memory.\n");
         assert(!"ERROR: refos dynamic sbrk out of memory.");
@@ -36,10 +36,6 @@ long sys_link(va_list ap) {
 	assert(!"sys_link not implemented");
 	return 0;
 }
-long sys_unlink(va_list ap) {
-	assert(!"sys_unlink not implemented");
-	return 0;
-}
 long sys_execve(va_list ap) {
 	assert(!"sys_execve not implemented");
 	return 0;
@@ -296,10 +292,6 @@ long sys_getrusage(va_list ap) {
 	assert(!"sys_getrusage not implemented");
 	return 0;
 }
-long sys_gettimeofday(va_list ap) {
-	assert(!"sys_gettimeofday not implemented");
-	return 0;
-}
 long sys_settimeofday(va_list ap) {
 	assert(!"sys_settimeofday not implemented");
 	return 0;
@@ -1352,10 +1344,6 @@ long sys_link(va_list ap) {
     assert(!"sys_link not implemented");
     return 0;
 }
-long sys_unlink(va_list ap) {
-    assert(!"sys_unlink not implemented");
-    return 0;
-}
 long sys_execve(va_list ap) {
     assert(!"sys_execve not implemented");
     return 0;
@@ -1532,10 +1520,6 @@ long sys_getrusage(va_list ap) {
     assert(!"sys_getrusage not implemented");
     return 0;
 }
-long sys_gettimeofday(va_list ap) {
-    assert(!"sys_gettimeofday not implemented");
-    return 0;
-}
 long sys_settimeofday(va_list ap) {
     assert(!"sys_settimeofday not implemented");
     return 0;
@@ -9,11 +9,88 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <time.h>
+#include <string.h>
+#include <sys/time.h>
+#include <refos/refos.h>
+#include <refos/time_page.h>
 #include <refos-io/timer.h>
 #include <refos-io/internal_state.h>
 #include <refos-io/ipc_state.h>
 #include <refos-io/filetable.h>
 #include <refos-util/dprintf.h>
+#include <refos-util/walloc.h>
+#include <refos-util/cspace.h>
+#include <refos-rpc/data_client.h>
+#include <refos-rpc/data_client_helper.h>
+#include <refos-rpc/serv_client.h>
+#include <refos-rpc/serv_client_helper.h>
+#include <refos-rpc/name_client_helper.h>
+
+/*! @brief Map the timer server's shared time page, so the time may be read without any IPC.
+
+    The time page lives next to the timer dataspace, so its path is derived from the timer
+    dataspace path by swapping the last path component for REFOS_TIME_PAGE_DSPACE_NAME.
+
+    @param dspacePath The timer dataspace path.
+    @return The mapped time page on success, NULL otherwise.
+*/
+static struct refos_time_page *
+refos_init_time_page(char *dspacePath)
+{
+    char path[NAMESERV_PATH_MAXLEN];
+    char *lastSep = strrchr(dspacePath, '/');
+    int prefixLen = lastSep ? (lastSep - dspacePath + 1) : 0;
+    if (prefixLen + strlen(REFOS_TIME_PAGE_DSPACE_NAME) + 1 > NAMESERV_PATH_MAXLEN) {
+        return NULL;
+    }
+    memcpy(path, dspacePath, prefixLen);
+    strcpy(path + prefixLen, REFOS_TIME_PAGE_DSPACE_NAME);
+
+    serv_connection_t c = serv_connect_no_pbuffer(path);
+    if (c.error != ESUCCESS || !c.serverSession) {
+        return NULL;
+    }
+
+    int error = EINVALID;
+    struct refos_time_page *tp = NULL;
+    seL4_CPtr window = 0;
+    seL4_Word vaddr = 0;
+    seL4_CPtr dataspace = data_open(c.serverSession, c.serverMountPoint.dspaceName, 0, 0, 0,
+                                    &error);
+    if (error || !dataspace) {
+        goto exit1;
+    }
+
+    vaddr = walloc_ext(1, &window, PROC_WINDOW_PERMISSION_READ, 0);
+    if (!vaddr || !window) {
+        goto exit2;
+    }
+
+    error = data_datamap(REFOS_PROCSERV_EP, dataspace, window, 0);
+    if (error != ESUCCESS) {
+        goto exit3;
+    }
+
+    tp = (struct refos_time_page *) vaddr;
+    if (tp->magic != REFOS_TIME_PAGE_MAGIC) {
+        tp = NULL;
+        goto exit3;
+    }
+
+    /* The mapping holds its own reference to the dataspace. */
+    csfree_delete(dataspace);
+    serv_disconnect(&c);
+    return tp;
+
+    /* Exit stack. */
+exit3:
+    walloc_free(vaddr, 1);
+exit2:
+    csfree_delete(dataspace);
+exit1:
+    serv_disconnect(&c);
+    return NULL;
+}
 
 void
 refos_init_timer(char *dspacePath)
@@ -25,7 +102,32 @@ refos_init_timer(char *dspacePath)
     refosIOState.timerFD = fopen(dspacePath, "r+");
     if (!refosIOState.timerFD) {
         seL4_DebugPrintf("Could not initialise timer file.");
+        return;
     }
+
+    /* The time page is an optimisation only; fall back to reading the timer file if missing. */
+    refosIOState.timePage = refos_init_time_page(dspacePath);
+}
+
+/*! @brief Read the current time in nanoseconds, off the shared time page if we have one.
+    @param ns Output time in nanoseconds.
+    @return 0 on success, -1 otherwise.
+*/
+static int
+refos_timer_read_ns(uint64_t *ns)
+{
+    if (refosIOState.timePage) {
+        *ns = refos_time_page_read(refosIOState.timePage);
+        return 0;
+    }
+    if (!refosIOState.timerFD) {
+        return -1;
+    }
+
+    /* We directly use filetable_read interface here, to avoid buffering issues with using fread. */
+    int res = filetable_read(&refosIOState.fdTable, fileno(refosIOState.timerFD),
+            (char*) ns, sizeof(uint64_t));
+    return (res >= (int) sizeof(uint64_t)) ? 0 : -1;
 }
 
 long
@@ -70,27 +172,33 @@ sys_clock_gettime(va_list ap)
         seL4_DebugPrintf("WARNING: sys_clock_gettime CPU time feature not supported.\n");
         return -1;
     }
-    if (!refosIOState.timerFD) {
+    if (!refosIOState.timePage && !refosIOState.timerFD) {
         assert(!"sys_clock_gettime not supported");
         return -1;
     }
 
     uint64_t ns = 0;
+    int res = refos_timer_read_ns(&ns);
+    tp->tv_sec = ns / 1000000000UL;
+    tp->tv_nsec = ns % 1000000000UL;
+    return res;
+}
 
-    /* We directly use filetable_read interface here, to avoid buffering issues with using fread.
-       This is a rather crude way of implementing clock_gettime. A far better way would be to
-       datamap a dataspace as a shared buffer, then simply read off that.
-    */
-    int res = filetable_read(&refosIOState.fdTable, fileno(refosIOState.timerFD),
-            (char*) &ns, sizeof(uint64_t));
-
-    if (res >= sizeof(uint64_t)) {
-        tp->tv_sec = ns / 1000000000UL;
-        tp->tv_nsec = ns % 1000000000UL;
-    } else {
-        tp->tv_sec = 0;
-        tp->tv_nsec = 0;
+long
+sys_gettimeofday(va_list ap)
+{
+    struct timeval *tv = va_arg(ap, struct timeval *);
+    if (!tv) {
+        return 0;
+    }
+    if (!refosIOState.timePage && !refosIOState.timerFD) {
+        assert(!"sys_gettimeofday not supported");
+        return -1;
     }
 
-    return res > 0 ? 0 : -1;
+    uint64_t ns = 0;
+    int res = refos_timer_read_ns(&ns);
+    tv->tv_sec = ns / 1000000000UL;
+    tv->tv_usec = (ns % 1000000000UL) / 1000UL;
+    return res;
 }
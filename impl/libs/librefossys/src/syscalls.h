@@ -21,6 +21,7 @@ long sys_tgkill(va_list ap);
 long sys_tkill(va_list ap);
 long sys_exit_group(va_list ap);
 long sys_open(va_list ap);
+long sys_unlink(va_list ap);
 long sys_close(va_list ap);
 long sys_readv(va_list ap);
 long sys_read(va_list ap);
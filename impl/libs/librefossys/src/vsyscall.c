@@ -29,6 +29,7 @@ long (*syscall_table[])(va_list) = {
     [__NR_tkill] = sys_tkill,
     [__NR_exit_group] = sys_exit_group,
     [__NR_open] = sys_open,
+    [__NR_unlink] = sys_unlink,
     [__NR_close] = sys_close,
     [__NR_readv] = sys_readv,
     [__NR_read] = sys_read,